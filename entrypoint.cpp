@@ -8,6 +8,9 @@
 #include <iostream>
 #include "src/cpp_modules/src/main.cpp"
 #include "src/cpp_modules/src/game_simulation.cpp"
+#include "src/cpp_modules/src/simulation_comparison.cpp"
+#include "src/cpp_modules/src/weight_optimizer.cpp"
+#include "src/cpp_modules/src/position_book_builder.cpp"
 
 /*
  I = 0
@@ -25,24 +28,69 @@
 char const * testInput = "00000000000000000000000000010000000001110000000111000000111100000111100000011111000001111100010111110001111110100111111010011111101001111110100111111011011111111101111111111111111011111111101101111111|18|85|5|1|X....|";
 
 int runGames(){
-  std::vector<int> scores;
+  std::vector<SimulatedGameResult> results;
   int numGames = NUM_SIM_GAMES;
-  int playoutCount = 50;
-  int playoutLength = 2;
-  simulateGames(numGames, "X..", 29, /* maxLines= */ -1, /* shouldAdjust= */ 0, /* reactionTime= */ 0, playoutCount, playoutLength, scores);
-  int total = 0;
-  for (int i : scores){
-    printf("%d\n", i);
-    total += i;
-  }
-  printf("\n\nAverage: %d\n", total / numGames);
+  EngineConfig engineConfig = {/* playoutCount= */ 50, /* playoutLength= */ 2, DEFAULT_PRUNING_BREADTH, &DEFAULT_WEIGHT_SET};
+  unsigned long long baseSeed = 1;
+  simulateGames(numGames, "X..", 29, /* maxLines= */ -1, /* shouldAdjust= */ 0, /* reactionTime= */ 0, engineConfig, baseSeed, SIMULATION_THREADS, results);
+  printSimulationResults(results);
+  return 0;
+}
+
+int runComparison(){
+  EngineConfig configA = {/* playoutCount= */ 49, /* playoutLength= */ 2, DEFAULT_PRUNING_BREADTH, &DEFAULT_WEIGHT_SET};
+  EngineConfig configB = {/* playoutCount= */ 7, /* playoutLength= */ 1, DEFAULT_PRUNING_BREADTH, &DEFAULT_WEIGHT_SET};
+  std::vector<PairedGameResult> pairedResults;
+  ComparisonSummary summary = compareEngineConfigs(configA, configB, "X..", 18, /* maxLines= */ 230, /* baseSeed= */ 1,
+                                                   /* minPairs= */ 20, /* maxPairs= */ 500, /* earlyStopZ= */ 2.8f, SIMULATION_THREADS, pairedResults);
+  printComparisonSummary(summary);
   return 0;
 }
 
+int runWeightOptimization(){
+  EngineConfig engineConfig = {/* playoutCount= */ 7, /* playoutLength= */ 1, DEFAULT_PRUNING_BREADTH, &DEFAULT_WEIGHT_SET};
+  EvalWeightSet tunedWeights = optimizeWeights(DEFAULT_WEIGHT_SET, engineConfig, "X..", 18, /* maxLines= */ 230,
+                                               /* numGenerations= */ 30, /* populationSize= */ 12, /* gamesPerCandidate= */ 16,
+                                               /* initialStepSize= */ 0.2f, /* baseSeed= */ 1, SIMULATION_THREADS);
+  // Only MAIN_WEIGHTS is tuned; the other modes are printed as-is so the whole table can be pasted back into params.hpp
+  printWeightSet(tunedWeights);
+  return 0;
+}
+
+int runPositionBookBuild(){
+  EngineConfig engineConfig = {/* playoutCount= */ 49, /* playoutLength= */ 2, /* pruningBreadth= */ 10, &DEFAULT_WEIGHT_SET};
+  int numEntries = buildPositionBook("position_book.bin", engineConfig, "X.....", 18, /* maxLines= */ 230, /* numGames= */ 200,
+                                       /* minOccurrences= */ 2, /* baseSeed= */ 1, SIMULATION_THREADS);
+  printf("Wrote %d entries to position_book.bin\n", numEntries);
+  return 0;
+}
+
+int runDataBlobExport(){
+  // Gzip the blobs before serving them to the lite wasm build (see emscriptem.md)
+  bool didSucceed = writeDataBlobs(".");
+  printf(didSucceed ? "Wrote surface_ranks.bin and piece_sequences.bin\n" : "Unable to write the data blobs\n");
+  return didSucceed ? 0 : 1;
+}
+
+/** Runs the self-checks that compare optimized code paths against their reference implementations. @returns the exit code */
+int runTests(){
+  int numFailures = testBitParallelTucks(/* numBoards= */ 20000);
+  numFailures += testSpecializedMoveSearch(/* numSearches= */ 20000);
+  printf(numFailures == 0 ? "All tests passed\n" : "Some tests failed\n");
+  return numFailures == 0 ? 0 : 1;
+}
+
 int main(int argc, const char * argv[]) {
+  if (argc > 1 && strcmp(argv[1], "--test") == 0) {
+    return runTests();
+  }
 //   printf("%s\n", mainProcess(testInput, GET_LOCK_VALUE_LOOKUP).c_str());
   printf("%s\n", mainProcess(testInput, GET_MOVE).c_str());
 //  runGames();
+//  runComparison();
+//  runWeightOptimization();
+//  runPositionBookBuild();
+//  runDataBlobExport();
   
   // testAdjustments();
   return 0;
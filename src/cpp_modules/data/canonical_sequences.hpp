@@ -1,6 +1,8 @@
 #ifndef SEQUENCES
 #define SEQUENCES
 
+#include "../src/config.hpp"
+
 /*
  * This array contains 8000 piece sequences that follow the RNG patterns of the NES tetris randomizer.
  * Namely, the chances of the first piece are impacted by the last known piece given by the actual randomizer.
@@ -11,6 +13,7 @@
  *
  * e.g. sequences 3000 - 3999 all assume the last known piece was an L (since L has index 2 and 1000 + 2 * 1000 = 3000).
  */
+#if EMBED_DATA_TABLES // Otherwise loaded at runtime, see data_tables.hpp
 const int canonicalPieceSequences[] = {
 	0, 6, 1, 0, 3, 0, 6, 4, 5, 3, 4, 4, 0, 2, 5, 3, 4, 0, 3, 6,
 	1, 3, 4, 2, 6, 3, 1, 0, 2, 5, 4, 0, 5, 6, 1, 4, 1, 6, 2, 1,
@@ -8013,6 +8016,7 @@ const int canonicalPieceSequences[] = {
 	1, 0, 4, 1, 3, 0, 6, 2, 0, 3, 2, 1, 1, 3, 0, 2, 1, 0, 2, 6,
 	3, 1, 5, 3, 4, 3, 5, 2, 6, 2, 4, 1, 5, 4, 5, 4, 6, 2, 1, 5,
 };
+#endif
 
 /** 
  * A list of all possible piece sequences of length 1 - 4.
@@ -1,5 +1,6 @@
 #include "../src/types.hpp"
 #include <list>
+#include <stdio.h>
 
 std::string PIECE_CHAR_LIST = "IOLJTSZ";
 
@@ -213,6 +214,30 @@ const Piece PIECE_LIST[7] = {PIECE_I, PIECE_O, PIECE_L, PIECE_J, PIECE_T, PIECE_
 
 static std::list<TuckOriginSpot> TUCK_SPOTS_LIST[7] = {TUCK_SPOTS_I, TUCK_SPOTS_O, TUCK_SPOTS_L, TUCK_SPOTS_J, TUCK_SPOTS_T, TUCK_SPOTS_S, TUCK_SPOTS_Z};
 
+#define MAX_TUCK_SPOTS 8
+
+/** The same tuck spots as above (in the same order), as flat arrays for the bit-parallel tuck search. */
+struct FlatTuckSpots {
+  int numSpots[7];
+  TuckOriginSpot spots[7][MAX_TUCK_SPOTS];
+};
+
+FlatTuckSpots getFlatTuckSpots() {
+  FlatTuckSpots flatSpots = {};
+  for (int p = 0; p < 7; p++) {
+    for (TuckOriginSpot spot : TUCK_SPOTS_LIST[p]) {
+      if (flatSpots.numSpots[p] == MAX_TUCK_SPOTS) {
+        printf("Piece %d has more than MAX_TUCK_SPOTS tuck spots\n", p);
+        break;
+      }
+      flatSpots.spots[p][flatSpots.numSpots[p]++] = spot;
+    }
+  }
+  return flatSpots;
+}
+
+const FlatTuckSpots TUCK_SPOTS_FLAT = getFlatTuckSpots();
+
 std::list<TuckInput> TUCK_INPUTS {
   {'L', -1, 0},
   {'R', 1, 0},
@@ -0,0 +1,245 @@
+#ifndef BOARD_KERNELS
+#define BOARD_KERNELS
+
+#include <random>
+#include "config.hpp"
+#include "types.hpp"
+#include "utils.hpp"
+
+/**
+ * The innermost board operations (collisions, placing a piece and clearing lines, column heights, and the row scans in the eval),
+ * with a scalar implementation and a WASM SIMD128 one. The SIMD versions are used in WASM builds compiled with -msimd128, since
+ * the browser path doesn't get the native compiler's auto-vectorization. Each one works on 4 board rows (or 8 columns) at a time.
+ *
+ * Both versions are always equivalent, which checkBoardKernels() verifies.
+ */
+
+#if USE_WASM_SIMD && defined(__wasm_simd128__)
+#define BOARD_KERNELS_USE_SIMD 1
+#include <wasm_simd128.h>
+#else
+#define BOARD_KERNELS_USE_SIMD 0
+#endif
+
+/* ---------- SCALAR ---------- */
+
+int pieceRowsCollideScalar(unsigned int const board[20], unsigned int const pieceRows[4], int x, int y) {
+  for (int r = 0; r < 4; r++) {
+    if (SHIFTBY(pieceRows[r], x) & board[y + r]) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int placePieceRowsScalar(unsigned int const board[20], unsigned int const pieceRows[4], int x, int y, OUT unsigned int newRows[4]) {
+  int fullRowMask = 0;
+  for (int i = 0; i < 4; i++) {
+    newRows[i] = (board[y + i] | SHIFTBY(pieceRows[i], x)) & ~(SHIFTBY(pieceRows[i], x - 20));
+    if (pieceRows[i] != 0 && (newRows[i] & FULL_ROW) == FULL_ROW) {
+      fullRowMask |= 1 << i;
+    }
+  }
+  return fullRowMask;
+}
+
+void getSurfaceArrayScalar(unsigned int const board[20], int outSurface[10]) {
+  for (int col = 0; col < 10; col++) {
+    int colMask = 1 << (9 - col);
+    int row = 0;
+    while (row < 20 && !(board[row] & colMask)) {
+      row++;
+    }
+    outSurface[col] = 20 - row;
+  }
+}
+
+int countRowsWithBitsScalar(unsigned int const board[20], unsigned int mask) {
+  int count = 0;
+  for (int r = 0; r < 20; r++) {
+    if (board[r] & mask) {
+      count++;
+    }
+  }
+  return count;
+}
+
+int findFirstRowWithBitsScalar(unsigned int const board[20], unsigned int mask) {
+  for (int r = 0; r < 20; r++) {
+    if (board[r] & mask) {
+      return r;
+    }
+  }
+  return -1;
+}
+
+/* ---------- SIMD ---------- */
+
+#if BOARD_KERNELS_USE_SIMD
+
+/** Shifts each lane like SHIFTBY() does. */
+v128_t shiftRowsBy(v128_t rows, int amount) {
+  return amount > 0 ? wasm_u32x4_shr(rows, amount) : wasm_i32x4_shl(rows, -amount);
+}
+
+int pieceRowsCollideSimd(unsigned int const board[20], unsigned int const pieceRows[4], int x, int y) {
+  v128_t shiftedPiece = shiftRowsBy(wasm_v128_load(pieceRows), x);
+  return wasm_v128_any_true(wasm_v128_and(shiftedPiece, wasm_v128_load(board + y)));
+}
+
+int placePieceRowsSimd(unsigned int const board[20], unsigned int const pieceRows[4], int x, int y, OUT unsigned int newRows[4]) {
+  v128_t piece = wasm_v128_load(pieceRows);
+  v128_t rows = wasm_v128_andnot(wasm_v128_or(wasm_v128_load(board + y), shiftRowsBy(piece, x)), shiftRowsBy(piece, x - 20));
+  wasm_v128_store(newRows, rows);
+  v128_t fullRow = wasm_i32x4_splat(FULL_ROW);
+  v128_t isFull = wasm_i32x4_eq(wasm_v128_and(rows, fullRow), fullRow);
+  v128_t hasPiece = wasm_i32x4_ne(piece, wasm_i32x4_splat(0));
+  return wasm_i32x4_bitmask(wasm_v128_and(isFull, hasPiece));
+}
+
+void getSurfaceArraySimd(unsigned int const board[20], int outSurface[10]) {
+  // Columns 0-7 in one vector and 8-9 in another, one 16-bit lane per column. Scanning bottom to top, the last filled row seen is the top.
+  v128_t zero = wasm_i16x8_splat(0);
+  v128_t leftColMasks = wasm_i16x8_make(1 << 9, 1 << 8, 1 << 7, 1 << 6, 1 << 5, 1 << 4, 1 << 3, 1 << 2);
+  v128_t rightColMasks = wasm_i16x8_make(1 << 1, 1 << 0, 0, 0, 0, 0, 0, 0);
+  v128_t leftSurface = zero;
+  v128_t rightSurface = zero;
+  for (int r = 19; r >= 0; r--) {
+    v128_t row = wasm_i16x8_splat((short) (board[r] & FULL_ROW));
+    v128_t height = wasm_i16x8_splat((short) (20 - r));
+    leftSurface = wasm_v128_bitselect(height, leftSurface, wasm_i16x8_ne(wasm_v128_and(row, leftColMasks), zero));
+    rightSurface = wasm_v128_bitselect(height, rightSurface, wasm_i16x8_ne(wasm_v128_and(row, rightColMasks), zero));
+  }
+  short heights[16];
+  wasm_v128_store(heights, leftSurface);
+  wasm_v128_store(heights + 8, rightSurface);
+  for (int col = 0; col < 10; col++) {
+    outSurface[col] = heights[col];
+  }
+}
+
+/** Gets a bitmask of which of the 4 rows starting at r have any of the masked bits. */
+int getRowsWithBitsMask(unsigned int const board[20], int r, v128_t maskVec) {
+  return wasm_i32x4_bitmask(wasm_i32x4_ne(wasm_v128_and(wasm_v128_load(board + r), maskVec), wasm_i32x4_splat(0)));
+}
+
+int countRowsWithBitsSimd(unsigned int const board[20], unsigned int mask) {
+  v128_t maskVec = wasm_i32x4_splat(mask);
+  int count = 0;
+  for (int r = 0; r < 20; r += 4) {
+    count += __builtin_popcount(getRowsWithBitsMask(board, r, maskVec));
+  }
+  return count;
+}
+
+int findFirstRowWithBitsSimd(unsigned int const board[20], unsigned int mask) {
+  v128_t maskVec = wasm_i32x4_splat(mask);
+  for (int r = 0; r < 20; r += 4) {
+    int rowsMask = getRowsWithBitsMask(board, r, maskVec);
+    if (rowsMask != 0) {
+      return r + __builtin_ctz(rowsMask);
+    }
+  }
+  return -1;
+}
+
+#endif
+
+/* ---------- SELECTED AT BUILD TIME ---------- */
+
+/** Checks whether a piece's 4 rows (shifted by x, as in SHIFTBY) overlap board rows y to y+3. Requires 0 <= y <= 16. */
+int pieceRowsCollide(unsigned int const board[20], unsigned int const pieceRows[4], int x, int y) {
+#if BOARD_KERNELS_USE_SIMD
+  return pieceRowsCollideSimd(board, pieceRows, x, y);
+#else
+  return pieceRowsCollideScalar(board, pieceRows, x, y);
+#endif
+}
+
+/**
+ * Adds a piece's 4 rows to board rows y to y+3 (clearing any tuck setups it fills). Requires 0 <= y <= 16.
+ * @returns a bitmask of which of those rows are full, counting only rows that the piece occupies
+ */
+int placePieceRows(unsigned int const board[20], unsigned int const pieceRows[4], int x, int y, OUT unsigned int newRows[4]) {
+#if BOARD_KERNELS_USE_SIMD
+  return placePieceRowsSimd(board, pieceRows, x, y, newRows);
+#else
+  return placePieceRowsScalar(board, pieceRows, x, y, newRows);
+#endif
+}
+
+void getSurfaceArray(unsigned int const board[20], int outSurface[10]) {
+#if BOARD_KERNELS_USE_SIMD
+  getSurfaceArraySimd(board, outSurface);
+#else
+  getSurfaceArrayScalar(board, outSurface);
+#endif
+}
+
+/** Counts the rows with any of the masked bits set. */
+int countRowsWithBits(unsigned int const board[20], unsigned int mask) {
+#if BOARD_KERNELS_USE_SIMD
+  return countRowsWithBitsSimd(board, mask);
+#else
+  return countRowsWithBitsScalar(board, mask);
+#endif
+}
+
+/** Finds the highest row with any of the masked bits set, or -1 if there isn't one. */
+int findFirstRowWithBits(unsigned int const board[20], unsigned int mask) {
+#if BOARD_KERNELS_USE_SIMD
+  return findFirstRowWithBitsSimd(board, mask);
+#else
+  return findFirstRowWithBitsScalar(board, mask);
+#endif
+}
+
+/**
+ * Runs the kernels selected for this build against the scalar ones on random boards (with random hole and tuck setup bits).
+ * @returns the number of mismatches
+ */
+int checkBoardKernels(int numBoards, unsigned int seed) {
+  std::mt19937 rng(seed);
+  int numMismatches = 0;
+  for (int i = 0; i < numBoards; i++) {
+    unsigned int board[20];
+    int stackHeight = rng() % 21;
+    for (int r = 0; r < 20; r++) {
+      board[r] = r < 20 - stackHeight ? 0 : (rng() & FULL_ROW) | (rng() & ALL_AUXILIARY_BITS);
+    }
+    if (rng() % 4 == 0) {
+      board[19] = FULL_ROW; // Full rows only come from the input board, but should be handled the same way
+    }
+    unsigned int pieceRows[4];
+    for (int r = 0; r < 4; r++) {
+      pieceRows[r] = rng() % 3 == 0 ? 0 : (rng() & 15) << 6;
+    }
+    int x = (int) (rng() % 12) - 2;
+    int y = rng() % 17;
+    unsigned int mask = rng() % 2 == 0 ? CELL_BIT(rng() % 10) : (CELL_BIT(rng() % 10) | HOLE_WEIGHT_BIT);
+
+    int surface[10], scalarSurface[10];
+    getSurfaceArray(board, surface);
+    getSurfaceArrayScalar(board, scalarSurface);
+    unsigned int newRows[4], scalarNewRows[4];
+    int fullRowMask = placePieceRows(board, pieceRows, x, y, newRows);
+    int scalarFullRowMask = placePieceRowsScalar(board, pieceRows, x, y, scalarNewRows);
+
+    bool isMatch = pieceRowsCollide(board, pieceRows, x, y) == pieceRowsCollideScalar(board, pieceRows, x, y)
+        && fullRowMask == scalarFullRowMask
+        && countRowsWithBits(board, mask) == countRowsWithBitsScalar(board, mask)
+        && findFirstRowWithBits(board, mask) == findFirstRowWithBitsScalar(board, mask);
+    for (int j = 0; j < 10; j++) {
+      isMatch = isMatch && surface[j] == scalarSurface[j];
+    }
+    for (int j = 0; j < 4; j++) {
+      isMatch = isMatch && newRows[j] == scalarNewRows[j];
+    }
+    if (!isMatch) {
+      numMismatches++;
+    }
+  }
+  return numMismatches;
+}
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef CANCELLATION
+#define CANCELLATION
+
+#include <atomic>
+
+/**
+ * Cooperative cancellation of searches that have become stale (e.g. a precompute for a piece that has already locked).
+ *
+ * The search checks its token before each playout, and once it's cancelled, every remaining playout is skipped. The search
+ * still returns, but mainProcess() replaces its (meaningless) result with CANCELLED_RESULT.
+ */
+
+#define CANCELLED_RESULT "Cancelled"
+
+/** Bumped by cancelAllSearches(). Only ever touched atomically, so that it can be bumped from a signal handler. */
+std::atomic<int> cancellationEpoch(0);
+
+struct CancellationToken {
+  std::atomic<bool> isCancelled;
+  int epoch; // The cancellationEpoch when the search started
+
+  CancellationToken() : isCancelled(false), epoch(cancellationEpoch.load()) {}
+};
+
+/** Whether a search should stop. Costs a couple of relaxed atomic loads. */
+bool isSearchCancelled(const CancellationToken *cancellationToken) {
+  return cancellationToken != nullptr
+      && (cancellationToken->isCancelled.load(std::memory_order_relaxed)
+          || cancellationToken->epoch != cancellationEpoch.load(std::memory_order_relaxed));
+}
+
+void cancelSearch(CancellationToken *cancellationToken) {
+  cancellationToken->isCancelled.store(true, std::memory_order_relaxed);
+}
+
+/** Cancels every search that's running now, on any thread. Searches started afterwards aren't affected. */
+void cancelAllSearches() {
+  cancellationEpoch++;
+}
+
+#endif
@@ -12,14 +12,30 @@
 #define PLAYOUT_RESULT_LOGGING_ENABLED 0
 #define MOVE_SEARCH_DEBUG_LOGGING 0
 #define VARIABLE_RANGE_CHECKS_ENABLED 1
+#define USE_REACHABILITY_ORACLE 1 // Replays precomputed empty-board paths in the spawn move search, only checking collisions near the stack
+#define USE_SPECIALIZED_MOVE_SEARCH 1 // Explores with move search code compiled for the specific gravity and tap speed, when the timeline is a common one
+#define REACHABILITY_ORACLE_CACHE_SIZE 32 // The most timelines to keep oracles for. Timelines come from clients, so this bounds the memory they can use
+#ifndef EMBED_DATA_TABLES
+#define EMBED_DATA_TABLES 1 // Compiles in the surface ranks and piece sequences. Builds with -DEMBED_DATA_TABLES=0 load them at runtime (see data_tables.hpp)
+#endif
+#define TRACING_SUPPORTED 1 // Allows search phases to be recorded as a timeline once tracing is started at runtime (see tracing.hpp)
+#define REQUEST_CAPTURE_SUPPORTED 1 // Allows requests to be logged for offline replay once capture is started at runtime (see request_capture.hpp)
+#define USE_WASM_SIMD 1 // Uses the SIMD128 board kernels in board_kernels.hpp when the WASM build is compiled with -msimd128
 
 // Game simulation
 #define NUM_SIM_GAMES 1
+#define SIMULATION_THREADS 0 // 0 = one thread per core
+#define BATCH_THREADS 0 // Threads for mainProcessBatch. 0 = one thread per core
+#define GAME_ANALYSIS_THREADS 0 // Threads for analyzeGame. 0 = one thread per core
+#define HYBRID_SEARCH_THREADS 2 // Threads for GET_TOP_MOVES_HYBRID (it has two independent halves)
+#define NEXT_PIECE_PRECOMPUTE_THREADS 0 // Threads for GET_LOCK_VALUE_LOOKUP_ALL_NEXT_PIECES. 0 = one thread per core
+#define CANDIDATE_PLAYOUT_THREADS 0 // Threads for playing out a single search's candidate moves. 0 = one thread per core (or per WASM pthread)
 
 // How the agent should play
 #define USE_RANKS 0
 #define USE_BASE_7_RANKS 1
 #define CAN_TUCK 1
+#define USE_BIT_PARALLEL_TUCKS 1 // Uses findTucksBitParallel instead of the reference findTucks
 #define WELL_COLUMN 9
 #define USE_RIGHT_WELL_FEATURES 1
 #define PLAY_SAFE_PRE_KILLSCREEN 0
@@ -34,6 +50,8 @@
 #define DEFAULT_PLAYOUT_LENGTH 2
 #define DEFAULT_PRUNING_BREADTH 20
 #define TRACK_PLAYOUT_DETAILS true // Can disable for performance reasons
+#define USE_POSITION_BOOK 1 // Consult the loaded position book (if any) before searching. See position_book.hpp
+#define SPECULATIVE_CACHE_MB 64 // Default memory budget for the engine server's speculative search results (see speculation.hpp). 0 = don't speculate
 
 // Logistics of move search and pruning
 #define LOCK_POSITION_REPEAT_CAP_PROPORTION .25 // Only used for current+next piece search. Refers to the limit on the percent of positions considered that can have the same first move. This increases the diversity of moves considered.
@@ -0,0 +1,149 @@
+#include "data_tables.hpp"
+#include "piece_rng.hpp"
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+#if EMBED_DATA_TABLES
+#include "../data/canonical_sequences.hpp"
+#include "../data/ranks_base_7.hpp"
+#endif
+
+/**
+ * The active tables, or NULL if they haven't been loaded. Replaced tables are never freed, since searches on other threads may
+ * still be reading them.
+ */
+#if EMBED_DATA_TABLES
+std::atomic<const unsigned long long *> activeSurfaceRanks(surfaceRanksChunked);
+std::atomic<const int *> activePieceSequences(canonicalPieceSequences);
+#else
+std::atomic<const unsigned long long *> activeSurfaceRanks(nullptr);
+std::atomic<const int *> activePieceSequences(nullptr);
+#endif
+
+std::once_flag generatedPieceSequencesFlag;
+std::vector<int> generatedPieceSequences;
+
+/** Generates stand-in sequences with the same layout and piece distribution as the canonical ones, from a fixed seed. */
+void generateFallbackPieceSequences() {
+  generatedPieceSequences.resize(NUM_CANONICAL_SEQUENCES * SEQUENCE_LENGTH);
+  FastRandom rng = {0};
+  for (int i = 0; i < NUM_CANONICAL_SEQUENCES; i++) {
+    // The first 1000 sequences assume nothing about the last piece, and each later batch of 1000 assumes a given last piece
+    int batch = i / 1000;
+    Piece lastPiece = batch == 0 ? PIECE_LIST[fastRandomInRange(rng, 0, 7)] : PIECE_LIST[batch - 1];
+    for (int j = 0; j < SEQUENCE_LENGTH; j++) {
+      lastPiece = getRandomPiece(lastPiece, rng);
+      generatedPieceSequences[i * SEQUENCE_LENGTH + j] = lastPiece.index;
+    }
+  }
+}
+
+/** Gets the surface ranks, or NULL if they aren't loaded yet (in which case the eval should use the flatness score). */
+const unsigned long long *getSurfaceRanks() {
+  return activeSurfaceRanks.load(std::memory_order_acquire);
+}
+
+/** Gets the canonical piece sequences, or the generated stand-ins if they aren't loaded yet. */
+const int *getCanonicalPieceSequences() {
+  const int *sequences = activePieceSequences.load(std::memory_order_acquire);
+  if (sequences != nullptr) {
+    return sequences;
+  }
+  std::call_once(generatedPieceSequencesFlag, generateFallbackPieceSequences);
+  return generatedPieceSequences.data();
+}
+
+bool isDataTableLoaded(DataTableId tableId) {
+  return tableId == SURFACE_RANKS_TABLE ? activeSurfaceRanks.load() != nullptr : activePieceSequences.load() != nullptr;
+}
+
+/**
+ * Loads a table from a blob (e.g. one fetched after startup) and makes it active. Requests that are already running may
+ * finish with the previous table.
+ * @returns false if the blob is truncated, or isn't one of the tables from this version
+ */
+bool loadDataBlob(const char *data, size_t size) {
+  DataBlobHeader header;
+  if (size < sizeof(DataBlobHeader)) {
+    printf("Data blob is too short\n");
+    return false;
+  }
+  memcpy(&header, data, sizeof(DataBlobHeader));
+  if (memcmp(header.magic, DATA_BLOB_MAGIC, sizeof(DATA_BLOB_MAGIC)) != 0 || header.formatVersion != DATA_BLOB_FORMAT_VERSION) {
+    printf("Data blob is invalid or from an incompatible version\n");
+    return false;
+  }
+  // Blobs come from the network, so only the two known table shapes are accepted, before any size arithmetic on the header
+  bool isSurfaceRanks = header.tableId == SURFACE_RANKS_TABLE && header.elementSize == sizeof(unsigned long long) && header.numElements == NUM_SURFACE_RANK_CHUNKS;
+  bool isPieceSequences = header.tableId == PIECE_SEQUENCES_TABLE && header.elementSize == 1 && header.numElements == NUM_CANONICAL_SEQUENCES * SEQUENCE_LENGTH;
+  if (!isSurfaceRanks && !isPieceSequences) {
+    printf("Data blob has an unknown table (%u) or size\n", header.tableId);
+    return false;
+  }
+  const char *elements = data + sizeof(DataBlobHeader);
+  if ((size - sizeof(DataBlobHeader)) / header.elementSize < header.numElements) {
+    printf("Data blob is truncated\n");
+    return false;
+  }
+
+  if (isSurfaceRanks) {
+    std::vector<unsigned long long> *surfaceRanks = new std::vector<unsigned long long>(header.numElements);
+    memcpy(surfaceRanks->data(), elements, header.numElements * sizeof(unsigned long long));
+    activeSurfaceRanks.store(surfaceRanks->data(), std::memory_order_release);
+    return true;
+  }
+  std::vector<int> *pieceSequences = new std::vector<int>(header.numElements);
+  for (uint32_t i = 0; i < header.numElements; i++) {
+    if ((unsigned char) elements[i] >= 7) {
+      printf("Data blob has an invalid piece index\n");
+      delete pieceSequences;
+      return false;
+    }
+    (*pieceSequences)[i] = (unsigned char) elements[i];
+  }
+  activePieceSequences.store(pieceSequences->data(), std::memory_order_release);
+  return true;
+}
+
+bool writeDataBlob(std::string const &path, DataTableId tableId, uint32_t numElements, uint32_t elementSize, const void *elements) {
+  DataBlobHeader header = {};
+  memcpy(header.magic, DATA_BLOB_MAGIC, sizeof(DATA_BLOB_MAGIC));
+  header.formatVersion = DATA_BLOB_FORMAT_VERSION;
+  header.tableId = tableId;
+  header.numElements = numElements;
+  header.elementSize = elementSize;
+
+  FILE *blobFile = fopen(path.c_str(), "wb");
+  if (blobFile == NULL) {
+    printf("Unable to open %s for writing\n", path.c_str());
+    return false;
+  }
+  fwrite(&header, sizeof(DataBlobHeader), 1, blobFile);
+  fwrite(elements, elementSize, numElements, blobFile);
+  bool didSucceed = ferror(blobFile) == 0;
+  fclose(blobFile);
+  return didSucceed;
+}
+
+/**
+ * Writes the embedded tables out as blobs (surface_ranks.bin and piece_sequences.bin), for builds that load them lazily.
+ * @returns false if this build doesn't embed the tables, or the files couldn't be written
+ */
+bool writeDataBlobs(char const *outputDir) {
+#if EMBED_DATA_TABLES
+  std::vector<unsigned char> pieceSequenceBytes(NUM_CANONICAL_SEQUENCES * SEQUENCE_LENGTH);
+  for (size_t i = 0; i < pieceSequenceBytes.size(); i++) {
+    pieceSequenceBytes[i] = (unsigned char) canonicalPieceSequences[i];
+  }
+  std::string dir(outputDir);
+  return writeDataBlob(dir + "/surface_ranks.bin", SURFACE_RANKS_TABLE, NUM_SURFACE_RANK_CHUNKS, sizeof(unsigned long long), surfaceRanksChunked)
+      && writeDataBlob(dir + "/piece_sequences.bin", PIECE_SEQUENCES_TABLE, (uint32_t) pieceSequenceBytes.size(), 1, pieceSequenceBytes.data());
+#else
+  (void) outputDir;
+  printf("This build doesn't embed the data tables\n");
+  return false;
+#endif
+}
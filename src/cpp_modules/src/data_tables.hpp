@@ -0,0 +1,52 @@
+#ifndef DATA_TABLES
+#define DATA_TABLES
+
+#include <stdint.h>
+#include <stddef.h>
+#include "config.hpp"
+#include "types.hpp"
+
+/**
+ * Access to the engine's two large data tables: the surface ranks used by rateSurface(), and the canonical piece sequences
+ * used by the playouts.
+ *
+ * Native builds embed both tables (EMBED_DATA_TABLES). Builds without them (e.g. the lite WASM build, which would otherwise
+ * spend most of its download and startup time on the tables) are usable straight away, and load the tables later from
+ * binary blobs (see loadDataBlob). Until then, the eval falls back to calculateFlatness() and the playouts use sequences
+ * generated from the piece RNG's transition probabilities.
+ *
+ * Blob layout (little-endian):
+ *   DataBlobHeader
+ *   the table's elements: uint64 chunks for the surface ranks, or one byte per piece index for the piece sequences
+ */
+
+#define NUM_CANONICAL_SEQUENCES 8000 // 1000 for an unknown last piece, then 1000 for each last-known piece (see canonical_sequences.hpp)
+#define NUM_SURFACE_RANK_CHUNKS 720600 // 8 one-byte ranks per chunk
+
+enum DataTableId {
+  SURFACE_RANKS_TABLE,
+  PIECE_SEQUENCES_TABLE
+};
+
+const char DATA_BLOB_MAGIC[8] = {'S', 'R', 'D', 'A', 'T', 'A', 0, 0};
+const uint32_t DATA_BLOB_FORMAT_VERSION = 1;
+
+struct DataBlobHeader {
+  char magic[8];
+  uint32_t formatVersion;
+  uint32_t tableId; // A DataTableId
+  uint32_t numElements;
+  uint32_t elementSize; // In bytes
+};
+
+const unsigned long long *getSurfaceRanks();
+
+const int *getCanonicalPieceSequences();
+
+bool isDataTableLoaded(DataTableId tableId);
+
+bool loadDataBlob(const char *data, size_t size);
+
+bool writeDataBlobs(char const *outputDir);
+
+#endif
@@ -0,0 +1,373 @@
+#include "engine_server.hpp"
+#include "parallel.hpp"
+#include "request_scheduler.hpp"
+#include "cancellation.hpp"
+#include "shared_ring.hpp"
+#include "speculation.hpp"
+#include "tracing.hpp"
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/**
+ * A client connection, over either a socket or a shared ring file. The socket is closed once the reader is done and every
+ * response for it has been written.
+ */
+struct EngineServerConnection {
+  int socketFd; // -1 for a shared ring file
+  SharedRingFile *sharedRingFile; // NULL for a socket
+  std::mutex writeMutex; // Responses are written by whichever worker finishes the request
+  std::mutex requestsMutex;
+  std::unordered_map<uint32_t, std::shared_ptr<CancellationToken>> unfinishedRequests; // By request ID, for cancelling them
+  ~EngineServerConnection() {
+    if (socketFd >= 0) {
+      close(socketFd);
+    }
+  }
+};
+
+bool readFully(int fd, void *buf, size_t length) {
+  char *bytes = (char *) buf;
+  while (length > 0) {
+    ssize_t numRead = read(fd, bytes, length);
+    if (numRead < 0 && errno == EINTR) {
+      continue;
+    }
+    if (numRead <= 0) {
+      return false;
+    }
+    bytes += numRead;
+    length -= numRead;
+  }
+  return true;
+}
+
+bool writeFully(int fd, const void *buf, size_t length) {
+  const char *bytes = (const char *) buf;
+  while (length > 0) {
+    ssize_t numWritten = write(fd, bytes, length);
+    if (numWritten < 0 && errno == EINTR) {
+      continue;
+    }
+    if (numWritten <= 0) {
+      return false;
+    }
+    bytes += numWritten;
+    length -= numWritten;
+  }
+  return true;
+}
+
+void writeEngineResponse(EngineServerConnection &connection, uint32_t requestId, EngineResponseStatus status, std::string const &payload) {
+  EngineFrameHeader header = {requestId, (uint8_t) status, {0, 0, 0}};
+  if (connection.sharedRingFile != NULL) {
+    // Slots are lock-free, so this doesn't need the write lock
+    if (payload.length() > SHARED_RING_PAYLOAD_BYTES) {
+      std::string error = "Result is too large for a shared ring slot";
+      header.typeOrStatus = ENGINE_RESPONSE_ERROR;
+      pushSharedRing(connection.sharedRingFile->responses, header, error.data(), (uint32_t) error.length());
+    } else {
+      pushSharedRing(connection.sharedRingFile->responses, header, payload.data(), (uint32_t) payload.length());
+    }
+    return;
+  }
+  uint32_t frameLength = (uint32_t) (sizeof(EngineFrameHeader) + payload.length());
+  std::string frame((const char *) &frameLength, sizeof(frameLength));
+  frame.append((const char *) &header, sizeof(header));
+  frame += payload;
+  std::lock_guard<std::mutex> lock(connection.writeMutex);
+  writeFully(connection.socketFd, frame.data(), frame.length()); // If the client has gone away, there's no one to tell
+}
+
+/** Checks a request before it's scheduled, so that a malformed one is answered straight away. @returns the error, or "" if it's valid */
+std::string validateEngineRequest(int requestType, std::string const &input) {
+  if (requestType < GET_LOCK_VALUE_LOOKUP || requestType > GET_LOCK_VALUE_LOOKUP_PACKED) {
+    return "Unknown request type " + std::to_string(requestType);
+  }
+  return getRequestInputError(input.c_str(), (RequestType) requestType);
+}
+
+/** Gets the latency of each request class, along with the speculative cache's hit rate (if the server speculates). */
+std::string getEngineStatsJson(RequestScheduler &scheduler, SpeculativeCache *speculativeCache) {
+  std::string json = getSchedulerStatsJson(scheduler);
+  if (speculativeCache != NULL) {
+    json.pop_back();
+    json += ", \"speculativeCache\": " + getSpeculativeCacheStatsJson(*speculativeCache) + "}";
+  }
+  return json;
+}
+
+/**
+ * After answering a live request, schedules searches of the requests likely to follow it, to run when the workers are otherwise idle.
+ * @param generation - the speculative cache's generation when the request arrived
+ */
+void scheduleSpeculativeSearches(RequestScheduler &scheduler, SpeculativeCache &speculativeCache, long long generation, RequestType requestType, std::string const &input, SpeculativeResult const &result) {
+  std::vector<SpeculativeRequest> speculativeRequests;
+  if (!getSpeculativeRequests(requestType, input, result, speculativeRequests)) {
+    return;
+  }
+  for (SpeculativeRequest const &speculativeRequest : speculativeRequests) {
+    std::shared_ptr<SpeculativeSearch> search = registerSpeculativeSearch(speculativeCache, generation, speculativeRequest.requestType, speculativeRequest.input);
+    if (search == nullptr) {
+      return; // Another live request has arrived since, so these predictions are already stale
+    }
+    submitScheduledJob(scheduler, SPECULATIVE_REQUEST, [&speculativeCache, speculativeRequest, search]() {
+      SpeculativeResult result = {CANCELLED_RESULT, NULL_LOCK_LOCATION};
+      if (beginSpeculativeSearch(speculativeCache, search)) {
+        result.result = mainProcess(speculativeRequest.input.c_str(), speculativeRequest.requestType, &DEFAULT_WEIGHT_SET,
+                                    /* requestCaches= */ NULL, search->cancellationToken.get(), &result.chosenPlacement);
+      }
+      finishSpeculativeSearch(speculativeCache, search, result, isSearchCancelled(search->cancellationToken.get()));
+    });
+  }
+}
+
+/**
+ * Answers a request frame, or schedules it to be answered once it's been searched.
+ * @param speculativeCache - NULL if the server doesn't speculate
+ */
+void handleEngineFrame(RequestScheduler &scheduler, SpeculativeCache *speculativeCache, std::shared_ptr<EngineServerConnection> const &connection,
+                       EngineFrameHeader header, std::string const &input) {
+  if (header.typeOrStatus == ENGINE_CANCEL_REQUEST) {
+    std::lock_guard<std::mutex> lock(connection->requestsMutex);
+    auto request = connection->unfinishedRequests.find(header.requestId);
+    if (request != connection->unfinishedRequests.end()) {
+      cancelSearch(request->second.get());
+    }
+    return;
+  }
+  if (header.typeOrStatus == ENGINE_STATS_REQUEST) {
+    writeEngineResponse(*connection, header.requestId, ENGINE_RESPONSE_OK, getEngineStatsJson(scheduler, speculativeCache));
+    return;
+  }
+  std::string error = validateEngineRequest(header.typeOrStatus, input);
+  if (!error.empty()) {
+    writeEngineResponse(*connection, header.requestId, ENGINE_RESPONSE_ERROR, error);
+    return;
+  }
+  uint32_t requestId = header.requestId;
+  RequestType requestType = (RequestType) header.typeOrStatus;
+  RequestClass requestClass = getRequestClass(requestType);
+
+  // A live request means the game has moved on, so the searches predicted from the previous one are stale, unless one of them
+  // is already searching this very request
+  long long speculationGeneration = 0;
+  if (speculativeCache != NULL && requestClass == LIVE_REQUEST) {
+    {
+      // Held until the request is registered, so that a search it takes over can't finish (and answer it) before then
+      std::lock_guard<std::mutex> lock(connection->requestsMutex);
+      std::shared_ptr<CancellationToken> matchingSearchToken;
+      speculationGeneration = cancelSpeculativeSearches(*speculativeCache, requestType, input,
+          [&scheduler, speculativeCache, connection, requestId, requestType, input](SpeculativeResult const &result, bool wasCancelled, long long generation) {
+            {
+              std::lock_guard<std::mutex> lock(connection->requestsMutex);
+              connection->unfinishedRequests.erase(requestId);
+            }
+            writeEngineResponse(*connection, requestId, wasCancelled ? ENGINE_RESPONSE_ERROR : ENGINE_RESPONSE_OK, result.result);
+            if (!wasCancelled) {
+              scheduleSpeculativeSearches(scheduler, *speculativeCache, generation, requestType, input, result);
+            }
+          }, matchingSearchToken);
+      if (matchingSearchToken != nullptr) {
+        connection->unfinishedRequests[requestId] = matchingSearchToken; // So that the client can still cancel it
+        return;
+      }
+    }
+    SpeculativeResult cachedResult;
+    if (lookupSpeculativeResult(*speculativeCache, requestType, input, cachedResult)) {
+      writeEngineResponse(*connection, requestId, ENGINE_RESPONSE_OK, cachedResult.result);
+      scheduleSpeculativeSearches(scheduler, *speculativeCache, speculationGeneration, requestType, input, cachedResult);
+      return;
+    }
+  }
+
+  std::shared_ptr<CancellationToken> cancellationToken(new CancellationToken());
+  {
+    std::lock_guard<std::mutex> lock(connection->requestsMutex);
+    connection->unfinishedRequests[requestId] = cancellationToken;
+  }
+  submitScheduledJob(scheduler, requestClass, [&scheduler, speculativeCache, speculationGeneration, connection, requestId, requestType, requestClass, input, cancellationToken]() {
+    // Requests cancelled while they were queued aren't started at all
+    LockLocation chosenPlacement = NULL_LOCK_LOCATION;
+    std::string result = isSearchCancelled(cancellationToken.get())
+        ? CANCELLED_RESULT
+        : mainProcess(input.c_str(), requestType, &DEFAULT_WEIGHT_SET, /* requestCaches= */ NULL, cancellationToken.get(), &chosenPlacement);
+    {
+      std::lock_guard<std::mutex> lock(connection->requestsMutex);
+      connection->unfinishedRequests.erase(requestId);
+    }
+    bool wasCancelled = isSearchCancelled(cancellationToken.get());
+    writeEngineResponse(*connection, requestId, wasCancelled ? ENGINE_RESPONSE_ERROR : ENGINE_RESPONSE_OK, result);
+    if (speculativeCache != NULL && requestClass == LIVE_REQUEST && !wasCancelled) {
+      scheduleSpeculativeSearches(scheduler, *speculativeCache, speculationGeneration, requestType, input, {result, chosenPlacement});
+    }
+  });
+}
+
+/**
+ * Reads frames from a connection and schedules them, until the client disconnects or sends a malformed frame.
+ * @param speculativeCache - NULL if the server doesn't speculate
+ */
+void serveEngineConnection(RequestScheduler &scheduler, SpeculativeCache *speculativeCache, int socketFd) {
+  std::shared_ptr<EngineServerConnection> connection(new EngineServerConnection());
+  connection->socketFd = socketFd;
+  connection->sharedRingFile = NULL;
+  while (true) {
+    uint32_t frameLength;
+    EngineFrameHeader header;
+    if (!readFully(socketFd, &frameLength, sizeof(frameLength))) {
+      return;
+    }
+    if (frameLength < sizeof(EngineFrameHeader) || frameLength > ENGINE_SERVER_MAX_FRAME_LENGTH) {
+      printf("Closing connection after a frame of length %u\n", frameLength);
+      return;
+    }
+    std::string input(frameLength - sizeof(EngineFrameHeader), '\0');
+    if (!readFully(socketFd, &header, sizeof(header)) || !readFully(socketFd, &input[0], input.length())) {
+      return;
+    }
+
+    handleEngineFrame(scheduler, speculativeCache, connection, header, input);
+  }
+}
+
+/** Serves the requests from a shared ring file (see shared_ring.hpp), forever. */
+void serveSharedRingRequests(RequestScheduler &scheduler, SpeculativeCache *speculativeCache, SharedRingFile *sharedRingFile) {
+  std::shared_ptr<EngineServerConnection> connection(new EngineServerConnection());
+  connection->socketFd = -1;
+  connection->sharedRingFile = sharedRingFile;
+  while (true) {
+    EngineFrameHeader header;
+    std::string input;
+    popSharedRing(sharedRingFile->requests, header, input);
+    handleEngineFrame(scheduler, speculativeCache, connection, header, input);
+  }
+}
+
+/** Logs the engine stats every so often, while requests are coming in. */
+void reportEngineStats(RequestScheduler &scheduler, SpeculativeCache *speculativeCache, int intervalSeconds) {
+  std::string lastReport;
+  while (true) {
+    std::this_thread::sleep_for(std::chrono::seconds(intervalSeconds));
+    std::string report = getEngineStatsJson(scheduler, speculativeCache);
+    if (report != lastReport) {
+      printf("Engine stats: %s\n", report.c_str());
+      fflush(stdout);
+      lastReport = report;
+    }
+  }
+}
+
+void acceptEngineConnections(RequestScheduler &scheduler, SpeculativeCache *speculativeCache, int listenFd, bool isTcp) {
+  while (true) {
+    int socketFd = accept(listenFd, NULL, NULL);
+    if (socketFd < 0) {
+      if (errno != EINTR) {
+        printf("accept() failed: %s\n", strerror(errno));
+      }
+      continue;
+    }
+    if (isTcp) {
+      int noDelay = 1;
+      setsockopt(socketFd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    }
+    std::thread(serveEngineConnection, std::ref(scheduler), speculativeCache, socketFd).detach();
+  }
+}
+
+int openUnixListener(std::string const &socketPath) {
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  if (socketPath.length() >= sizeof(address.sun_path)) {
+    printf("Socket path is too long: %s\n", socketPath.c_str());
+    return -1;
+  }
+  strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+  unlink(socketPath.c_str()); // Left behind if a previous server didn't shut down cleanly
+  int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listenFd < 0 || bind(listenFd, (sockaddr *) &address, sizeof(address)) != 0 || listen(listenFd, SOMAXCONN) != 0) {
+    printf("Unable to listen on %s: %s\n", socketPath.c_str(), strerror(errno));
+    return -1;
+  }
+  return listenFd;
+}
+
+int openTcpListener(int port) {
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  int listenFd = socket(AF_INET, SOCK_STREAM, 0);
+  int reuseAddress = 1;
+  if (listenFd >= 0) {
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuseAddress, sizeof(reuseAddress));
+  }
+  if (listenFd < 0 || bind(listenFd, (sockaddr *) &address, sizeof(address)) != 0 || listen(listenFd, SOMAXCONN) != 0) {
+    printf("Unable to listen on 127.0.0.1:%d: %s\n", port, strerror(errno));
+    return -1;
+  }
+  return listenFd;
+}
+
+/**
+ * Runs the server until the process is killed.
+ * @returns non-zero if it couldn't start listening
+ */
+int runEngineServer(EngineServerConfig const &config) {
+  signal(SIGPIPE, SIG_IGN); // Writing to a client that disconnected should fail, not kill the server
+
+  static RequestScheduler scheduler;
+  static SpeculativeCache speculativeCacheStorage;
+  SpeculativeCache *speculativeCache = NULL;
+  if (config.speculativeCacheBytes > 0) {
+    speculativeCacheStorage.maxBytes = config.speculativeCacheBytes;
+    speculativeCache = &speculativeCacheStorage;
+  }
+  int unixListenFd = openUnixListener(config.socketPath);
+  if (unixListenFd < 0) {
+    return 1;
+  }
+  std::thread(acceptEngineConnections, std::ref(scheduler), speculativeCache, unixListenFd, /* isTcp= */ false).detach();
+  if (config.tcpPort != 0) {
+    int tcpListenFd = openTcpListener(config.tcpPort);
+    if (tcpListenFd < 0) {
+      return 1;
+    }
+    std::thread(acceptEngineConnections, std::ref(scheduler), speculativeCache, tcpListenFd, /* isTcp= */ true).detach();
+  }
+  if (!config.sharedRingPath.empty()) {
+    SharedRingFile *sharedRingFile = createSharedRingFile(config.sharedRingPath);
+    if (sharedRingFile == NULL) {
+      return 1;
+    }
+    std::thread(serveSharedRingRequests, std::ref(scheduler), speculativeCache, sharedRingFile).detach();
+  }
+
+  // With more than one worker, the parallel parts of each search run serially (see isInsideParallelFor), so that the pool is what
+  // divides up the cores
+  int numWorkers = config.numWorkers > 0 ? config.numWorkers : getDefaultThreadCount();
+  printf("Engine server listening on %s%s%s with %d workers\n", config.socketPath.c_str(),
+         config.tcpPort != 0 ? (" and 127.0.0.1:" + std::to_string(config.tcpPort)).c_str() : "",
+         !config.sharedRingPath.empty() ? (" and " + config.sharedRingPath).c_str() : "", numWorkers);
+  fflush(stdout);
+  if (config.statsIntervalSeconds > 0) {
+    std::thread(reportEngineStats, std::ref(scheduler), speculativeCache, config.statsIntervalSeconds).detach();
+  }
+  parallelFor(numWorkers, numWorkers, [&](int) {
+    runSchedulerWorker(scheduler);
+  });
+  return 0;
+}
@@ -0,0 +1,50 @@
+#ifndef ENGINE_SERVER
+#define ENGINE_SERVER
+
+#include <stdint.h>
+#include <string>
+#include "types.hpp"
+
+/**
+ * A standalone engine service, for running the engine outside of Node (see engine_server.md). It listens on a Unix domain
+ * socket (and optionally on a localhost TCP port), and serves requests on a fixed pool of worker threads, so a single
+ * connection can have many requests in flight and get their responses as each one finishes.
+ *
+ * Clients on the same machine can also send the same frames through shared memory (see shared_ring.hpp).
+ *
+ * Each message is a frame (little-endian):
+ *   uint32 frameLength    - the number of bytes after this field
+ *   EngineFrameHeader
+ *   the payload           - the request's input string (as passed to mainProcess), or the response's result
+ * Responses echo the request's ID, and may arrive in a different order than the requests were sent. Requests from live games
+ * are served ahead of batch analysis (see request_scheduler.hpp), and the requests likely to follow them are searched ahead of
+ * time (see speculation.hpp).
+ */
+
+#define ENGINE_SERVER_MAX_FRAME_LENGTH (1 << 20)
+#define ENGINE_STATS_REQUEST 255 // A request type that gets the latency of each request class, as JSON (see getSchedulerStatsJson)
+#define ENGINE_CANCEL_REQUEST 254 // A request type that cancels the connection's request with the frame's ID. Gets no response of its own.
+
+enum EngineResponseStatus {
+  ENGINE_RESPONSE_OK, // The payload is the result, exactly as mainProcess returned it
+  ENGINE_RESPONSE_ERROR // The request couldn't be processed, and the payload is the reason
+};
+
+struct EngineFrameHeader {
+  uint32_t requestId;
+  uint8_t typeOrStatus; // A RequestType for requests, or an EngineResponseStatus for responses
+  uint8_t reserved[3];
+};
+
+struct EngineServerConfig {
+  std::string socketPath;
+  int tcpPort; // 0 = Unix socket only. Only listens on 127.0.0.1.
+  int numWorkers; // 0 = one per core
+  int statsIntervalSeconds; // How often to log the latency of each request class. 0 = never.
+  size_t speculativeCacheBytes; // The memory budget for speculative search results (see speculation.hpp). 0 = don't speculate.
+  std::string sharedRingPath; // A shared ring file to create and serve requests from (see shared_ring.hpp). "" = sockets only.
+};
+
+int runEngineServer(EngineServerConfig const &config);
+
+#endif
@@ -0,0 +1,42 @@
+#include <iostream>
+#include <stdlib.h>
+#include <string.h>
+#include "main.cpp"
+#include "speculation.cpp"
+#include "shared_ring.cpp"
+#include "engine_server.cpp"
+
+/**
+ * The standalone engine server binary (see engine_server.md).
+ * Usage: engine_server [--socket <path>] [--tcp <port>] [--workers <count>] [--position-book <path>] [--stats-interval <seconds>] [--speculative-cache-mb <size>] [--shm <path>]
+ *        [--capture <path>] [--capture-results <path>]
+ */
+int main(int argc, const char *argv[]) {
+  EngineServerConfig config = {/* socketPath= */ "/tmp/stackrabbit.sock", /* tcpPort= */ 0, /* numWorkers= */ 0, /* statsIntervalSeconds= */ 60,
+                               /* speculativeCacheBytes= */ (size_t) SPECULATIVE_CACHE_MB << 20, /* sharedRingPath= */ ""};
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "--socket") == 0) {
+      config.socketPath = argv[i + 1];
+    } else if (strcmp(argv[i], "--tcp") == 0) {
+      config.tcpPort = atoi(argv[i + 1]);
+    } else if (strcmp(argv[i], "--workers") == 0) {
+      config.numWorkers = atoi(argv[i + 1]);
+    } else if (strcmp(argv[i], "--stats-interval") == 0) {
+      config.statsIntervalSeconds = atoi(argv[i + 1]);
+    } else if (strcmp(argv[i], "--speculative-cache-mb") == 0) {
+      config.speculativeCacheBytes = (size_t) atoi(argv[i + 1]) << 20;
+    } else if (strcmp(argv[i], "--shm") == 0) {
+      config.sharedRingPath = argv[i + 1];
+    } else if (strcmp(argv[i], "--position-book") == 0) {
+      loadPositionBook(argv[i + 1]);
+    } else if (strcmp(argv[i], "--capture") == 0 || strcmp(argv[i], "--capture-results") == 0) {
+      if (!startRequestCapture(argv[i + 1], /* includeResults= */ strcmp(argv[i], "--capture-results") == 0)) {
+        return 1;
+      }
+    } else {
+      printf("Unknown argument %s\n", argv[i]);
+      return 1;
+    }
+  }
+  return runEngineServer(config);
+}
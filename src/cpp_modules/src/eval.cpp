@@ -2,6 +2,8 @@
 #include "move_result.hpp"
 #include "eval_context.hpp"
 #include "utils.hpp"
+#include "board_kernels.hpp"
+#include "data_tables.hpp"
 #include "../data/ranks_output.hpp"
 #include "../data/ranks_base_7.hpp"
 #include <math.h>
@@ -46,8 +48,9 @@ float calculateFlatness(int surfaceArray[10], int wellColumn) {
 /** Gets the value of a surface. */
 float rateSurface(int surfaceArray[10], const EvalContext *evalContext) {
   int wellColumn = evalContext->wellColumn;
+  const unsigned long long *surfaceRanks = getSurfaceRanks();
   
-  if (USE_BASE_7_RANKS){
+  if (USE_BASE_7_RANKS && surfaceRanks != NULL){
     // Convert the surface array into the custom base-9 encoding
     int b7index = 0;
     int excessGap = 0;
@@ -63,7 +66,7 @@ float rateSurface(int surfaceArray[10], const EvalContext *evalContext) {
       b7index *= 7;
       b7index += diff + 3;
     }
-    unsigned long long chunk = surfaceRanksChunked[b7index / 8];
+    unsigned long long chunk = surfaceRanks[b7index / 8];
     unsigned int subIndex = b7index & 0b111;
     int numShifts = (7 - subIndex) * 8;
     unsigned int byte = (chunk >> numShifts) & 0xFF;
@@ -146,15 +149,13 @@ float getCoveredWellFactor(unsigned int board[20], int wellColumn, float scareHe
   if (wellColumn == -1) {
     return 0;
   }
-  int mask = (1 << (9 - wellColumn));
-  for (int r = 0; r < 20; r++) {
-    if (board[r] & mask) {
-      int difficultyMultiplier = (board[r] & (ALL_TUCK_SETUP_BITS)) > 0 ? 10 : 1;
-      float heightRatio = (20.0f - r) / max(3.0f, scareHeight);
-      return heightRatio * heightRatio * heightRatio * difficultyMultiplier;
-    }
+  int r = findFirstRowWithBits(board, CELL_BIT(wellColumn));
+  if (r == -1) {
+    return 0;
   }
-  return 0;
+  int difficultyMultiplier = (board[r] & (ALL_TUCK_SETUP_BITS)) > 0 ? 10 : 1;
+  float heightRatio = (20.0f - r) / max(3.0f, scareHeight);
+  return heightRatio * heightRatio * heightRatio * difficultyMultiplier;
 }
 
 float getGuaranteedBurnsFactor(unsigned int board[20], int wellColumn) {
@@ -162,14 +163,7 @@ float getGuaranteedBurnsFactor(unsigned int board[20], int wellColumn) {
   if (wellColumn == -1) {
     return 0;
   }
-  int wellMask = (1 << (9 - wellColumn));
-  int guaranteedBurns = 0;
-  for (int r = 0; r < 20; r++) {
-    if ((board[r] & wellMask) || (board[r] & HOLE_WEIGHT_BIT)) {
-      guaranteedBurns++;
-    }
-  }
-  return guaranteedBurns;
+  return countRowsWithBits(board, CELL_BIT(wellColumn) | HOLE_WEIGHT_BIT);
 }
 
 float getHoleWeightFactor(unsigned int board[20], int wellColumn) {
@@ -177,13 +171,7 @@ float getHoleWeightFactor(unsigned int board[20], int wellColumn) {
   if (wellColumn == -1) {
     return 0;
   }
-  int holeWeight = 0;
-  for (int r = 0; r < 20; r++) {
-    if ((board[r] & HOLE_WEIGHT_BIT)) {
-      holeWeight++;
-    }
-  }
-  return holeWeight;
+  return countRowsWithBits(board, HOLE_WEIGHT_BIT);
 }
 
 
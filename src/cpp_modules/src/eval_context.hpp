@@ -1,3 +1,3 @@
 #include "types.hpp"
 
-const EvalContext getEvalContext(GameState gameState, const PieceRangeContext pieceRangeContextLookup[]);
\ No newline at end of file
+const EvalContext getEvalContext(GameState gameState, const PieceRangeContext pieceRangeContextLookup[], const EvalWeightSet *weightSet);
\ No newline at end of file
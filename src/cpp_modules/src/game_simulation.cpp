@@ -1,4 +1,9 @@
-#include "types.hpp"
+#include "game_simulation.hpp"
+#include "board_kernels.hpp"
+#include "parallel.hpp"
+#include "tracing.hpp"
+#include <algorithm>
+#include <math.h>
 
 const int SCORE_REWARDS[] = {
   0,
@@ -8,17 +13,18 @@ const int SCORE_REWARDS[] = {
   1200
 };
 
-int countInputsBeforeReactionTime(int reactionTime, char const *inputFrameTimeline) {
-  int numInputs = 0;
-  for (int i = 0; i < reactionTime; i++){
-    if (shouldPerformInputsThisFrame(i, inputFrameTimeline)){
-      numInputs++;
-    }
-  }
-  return numInputs;
+int countInputsBeforeReactionTime(int reactionTime, const InputFrameSchedule *inputSchedule) {
+  return countInputFramesBefore(reactionTime, inputSchedule);
 }
 
-int simulateGame(char const *inputFrameTimeline, int startingLevel, int maxLines, int shouldAdjust, int reactionTime, int playoutCount, int playoutLength){
+/**
+ * Plays a full game with the engine, drawing pieces from a generator seeded with the given seed.
+ * The same seed always produces the same piece sequence (and therefore the same game).
+ * @param positions - if non-NULL, every position the engine plays from is appended here
+ */
+SimulatedGameResult simulateGame(char const *inputFrameTimeline, int startingLevel, int maxLines, int shouldAdjust, int reactionTime, EngineConfig const &engineConfig, unsigned long long seed, OUT std::vector<SimulatedPosition> *positions){
+  FastRandom rng = {seed};
+
   // Init empty data structures
   GameState gameState = {
     /* board= */ {},
@@ -30,30 +36,35 @@ int simulateGame(char const *inputFrameTimeline, int startingLevel, int maxLines
   };
   getSurfaceArray(gameState.board, gameState.surfaceArray);
   Piece curPiece;
-  Piece nextPiece = PIECE_LIST[qualityRandom(0,7)];
+  Piece nextPiece = PIECE_LIST[fastRandomInRange(rng, 0, 7)];
 
   // Calculate global context for the 4 possible gravity values
+  const InputFrameSchedule inputSchedule = compileInputFrameSchedule(inputFrameTimeline);
   const PieceRangeContext pieceRangeContextLookup[4] = {
-    getPieceRangeContext(inputFrameTimeline, 1, /* gravityDoubled= */ true),
-    getPieceRangeContext(inputFrameTimeline, 1, /* gravityDoubled= */ false),
-    getPieceRangeContext(inputFrameTimeline, 2, /* gravityDoubled= */ false),
-    getPieceRangeContext(inputFrameTimeline, 3, /* gravityDoubled= */ false),
+    getPieceRangeContext(&inputSchedule, 1, /* gravityDoubled= */ true),
+    getPieceRangeContext(&inputSchedule, 1, /* gravityDoubled= */ false),
+    getPieceRangeContext(&inputSchedule, 2, /* gravityDoubled= */ false),
+    getPieceRangeContext(&inputSchedule, 3, /* gravityDoubled= */ false),
   };
   int score = 0;
-  int numMoves = 0;
+  int numPiecesPlaced = 0;
 
   while (true) {
-    numMoves++;
-    
     // Get pieces
     curPiece = nextPiece;
-    nextPiece = getRandomPiece(curPiece);
-
+    nextPiece = getRandomPiece(curPiece, rng);
+    if (positions != NULL) {
+      SimulatedPosition position = {{}, gameState.level, gameState.lines, curPiece.index, nextPiece.index};
+      for (int i = 0; i < 20; i++) {
+        position.board[i] = gameState.board[i] & FULL_ROW;
+      }
+      positions->push_back(position);
+    }
     // Figure out modes and eval context
-    const EvalContext evalContextRaw = getEvalContext(gameState, pieceRangeContextLookup);
+    const EvalContext evalContextRaw = getEvalContext(gameState, pieceRangeContextLookup, engineConfig.weightSet);
     const EvalContext *evalContext = &evalContextRaw;
 
-    LockLocation bestMove = playOneMove(gameState, &curPiece, NULL, DEFAULT_PRUNING_BREADTH, playoutCount, playoutLength, evalContext, pieceRangeContextLookup);
+    LockLocation bestMove = playOneMove(gameState, &curPiece, NULL, engineConfig.pruningBreadth, engineConfig.playoutCount, engineConfig.playoutLength, evalContext, pieceRangeContextLookup);
     if (bestMove.x == NONE){
       // Agent died, simulated game is complete
       break;
@@ -64,6 +75,7 @@ int simulateGame(char const *inputFrameTimeline, int startingLevel, int maxLines
     // Update the state to keep playing
     int oldLines = gameState.lines;
     gameState = advanceGameState(gameState, bestPlacement, evalContext);
+    numPiecesPlaced++;
     score += SCORE_REWARDS[gameState.lines - oldLines] * gameState.level;
 
     if (SIMULATION_LOGGING_ENABLED) {
@@ -76,14 +88,81 @@ int simulateGame(char const *inputFrameTimeline, int startingLevel, int maxLines
       break;
     }
   }
-  return score;
+  return {seed, score, gameState.lines, gameState.level, numPiecesPlaced};
+}
+
+/** Derives the seed of each game in a batch from the batch's base seed. */
+unsigned long long getGameSeed(unsigned long long baseSeed, int gameIndex) {
+  FastRandom seedRng = {baseSeed + (unsigned long long) gameIndex * 0x9E3779B97F4A7C15ULL};
+  return nextRandom(seedRng);
+}
+
+/**
+ * Plays numGames games in parallel across numThreads threads (0 = one per core).
+ * Each game gets its own seed derived from baseSeed, so a batch is reproducible regardless of the thread count.
+ * @param results - filled with one result per game, in game order
+ */
+void simulateGames(int numGames, char const *inputFrameTimeline, int startingLevel, int maxLines, int shouldAdjust, int reactionTime, EngineConfig const &engineConfig, unsigned long long baseSeed, int numThreads, OUT std::vector<SimulatedGameResult> &results){
+  printf("Starting game simulations...\n");
+  results.resize(numGames);
+  parallelFor(numGames, numThreads, [&](int i) {
+    TraceSpan span("simulateGame", i);
+    results[i] = simulateGame(inputFrameTimeline, startingLevel, maxLines, /* shouldAdjust= */ false, /* reactionTime */ 21, engineConfig, getGameSeed(baseSeed, i));
+    if (SIMULATION_LOGGING_ENABLED) {
+      printf("%d: %d\n", i, results[i].score);
+    }
+  });
+}
+
+SimulationSummary summarizeSimulations(std::vector<SimulatedGameResult> const &results){
+  SimulationSummary summary = {};
+  summary.numGames = (int) results.size();
+  if (summary.numGames == 0) {
+    return summary;
+  }
+  std::vector<int> scores;
+  double totalScore = 0;
+  double totalLines = 0;
+  double totalLevel = 0;
+  for (SimulatedGameResult const &result : results) {
+    scores.push_back(result.score);
+    totalScore += result.score;
+    totalLines += result.lines;
+    totalLevel += result.deathLevel;
+  }
+  double mean = totalScore / summary.numGames;
+  double sumSquaredDiffs = 0;
+  for (int score : scores) {
+    sumSquaredDiffs += (score - mean) * (score - mean);
+  }
+  double variance = summary.numGames > 1 ? sumSquaredDiffs / (summary.numGames - 1) : 0;
+
+  std::sort(scores.begin(), scores.end());
+  summary.meanScore = (float) mean;
+  summary.stdDevScore = (float) sqrt(variance);
+  summary.stdErrorScore = (float) sqrt(variance / summary.numGames);
+  summary.medianScore = scores[summary.numGames / 2];
+  summary.minScore = scores.front();
+  summary.maxScore = scores.back();
+  summary.meanLines = (float) (totalLines / summary.numGames);
+  summary.meanDeathLevel = (float) (totalLevel / summary.numGames);
+  return summary;
 }
 
-void simulateGames(int numGames, char const *inputFrameTimeline, int startingLevel, int maxLines, int shouldAdjust, int reactionTime, int playoutCount, int playoutLength, OUT std::vector<int> &scores){
-  printf("Starting game simulations...");
-  for (int i = 0; i < numGames; i++) {
-    int score = simulateGame(inputFrameTimeline, startingLevel, maxLines, /* shouldAdjust= */ false, /* reactionTime */ 21, playoutCount, playoutLength);
-    scores.push_back(score);
-    printf("%d: %d\n", i, score);
+void printSimulationResults(std::vector<SimulatedGameResult> const &results){
+  for (int i = 0; i < (int) results.size(); i++) {
+    SimulatedGameResult const &result = results[i];
+    printf("%d: score=%d lines=%d level=%d pieces=%d seed=%llu\n", i, result.score, result.lines, result.deathLevel, result.numPieces, result.seed);
   }
+  SimulationSummary summary = summarizeSimulations(results);
+  printf("\nGames: %d\nMean score: %.0f (+/- %.0f)\nStd dev: %.0f\nMedian: %d\nMin: %d\nMax: %d\nMean lines: %.1f\nMean death level: %.1f\n",
+         summary.numGames,
+         summary.meanScore,
+         1.96f * summary.stdErrorScore,
+         summary.stdDevScore,
+         summary.medianScore,
+         summary.minScore,
+         summary.maxScore,
+         summary.meanLines,
+         summary.meanDeathLevel);
 }
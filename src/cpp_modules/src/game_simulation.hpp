@@ -1,2 +1,15 @@
+#ifndef GAME_SIMULATION
+#define GAME_SIMULATION
 
-void simulateGames(int numGames, int startingLevel, char const *inputFrameTimeline, int reactionTime, int playoutCount, int playoutLength);
+#include "types.hpp"
+
+SimulatedGameResult simulateGame(char const *inputFrameTimeline, int startingLevel, int maxLines, int shouldAdjust, int reactionTime, EngineConfig const &engineConfig, unsigned long long seed, OUT std::vector<SimulatedPosition> *positions = NULL);
+
+/** Derives the seed of each game in a batch from the batch's base seed. */
+unsigned long long getGameSeed(unsigned long long baseSeed, int gameIndex);
+
+void simulateGames(int numGames, char const *inputFrameTimeline, int startingLevel, int maxLines, int shouldAdjust, int reactionTime, EngineConfig const &engineConfig, unsigned long long baseSeed, int numThreads, OUT std::vector<SimulatedGameResult> &results);
+
+SimulationSummary summarizeSimulations(std::vector<SimulatedGameResult> const &results);
+
+#endif
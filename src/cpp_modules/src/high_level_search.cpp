@@ -2,9 +2,13 @@
 #include <string>
 #include <math.h>
 #include <unordered_map>
+#include <string.h>
 #include "params.hpp"
 #include <limits>
 #include "formatting.hpp"
+#include "tracing.hpp"
+#include "parallel.hpp"
+#include "cancellation.hpp"
 using namespace std;
 
 #define MAP_OFFSET 5000          // An offset to make any placement better than the default 0 in the map
@@ -14,6 +18,7 @@ using namespace std;
  * The other elements can be anywhere.
  */
 void partiallySortPossibilityList(list<Possibility> &possibilityList, int keepTopN, OUT list<Possibility> &sortedList){
+  TraceSpan span("partialSort");
   auto cutoffPossibility = possibilityList.begin(); // The node on the "cutoff" between being in the top N placements and not
   int size = 0; // Tracking manually is cheaper than doing the O(n) operation each iteration
 
@@ -58,8 +63,9 @@ void partiallySortPossibilityList(list<Possibility> &possibilityList, int keepTo
  * @returns an UNSORTED list of evaluated possibilities
  */
 int searchDepth1(GameState gameState, const Piece *firstPiece, int keepTopN, const EvalContext *evalContext, OUT list<Possibility> &possibilityList){
+  TraceSpan span("searchDepth1");
   vector<LockPlacement> firstLockPlacements;
-  moveSearch(gameState, firstPiece, evalContext->pieceRangeContext.inputFrameTimeline, firstLockPlacements);
+  moveSearch(gameState, firstPiece, evalContext->pieceRangeContext.inputSchedule, firstLockPlacements);
   for (auto it = begin(firstLockPlacements); it != end(firstLockPlacements); ++it) {
     LockPlacement firstPlacement = *it;
 
@@ -82,14 +88,10 @@ int searchDepth1(GameState gameState, const Piece *firstPiece, int keepTopN, con
   return (int) possibilityList.size();
 }
 
-/** Searches 2-ply from a starting state, and performs a fast eval on each of the resulting states. 
- * @returns an UNSORTED list of evaluated possibilities
- */
-int searchDepth2(GameState gameState, const Piece *firstPiece, const Piece *secondPiece, int keepTopN, const EvalContext *evalContext, OUT list<Possibility> &possibilityList){
-
-  // Get the placements of the first piece
+/** Searches the first ply of a 2-ply search, keeping the state after each placement so that it can be searched from for any second piece. */
+int searchFirstPly(GameState gameState, const Piece *firstPiece, const EvalContext *evalContext, OUT vector<FirstPlyResult> &firstPlyResults){
   vector<LockPlacement> firstLockPlacements;
-  moveSearch(gameState, firstPiece, evalContext->pieceRangeContext.inputFrameTimeline, firstLockPlacements);
+  moveSearch(gameState, firstPiece, evalContext->pieceRangeContext.inputSchedule, firstLockPlacements);
   for (auto it = begin(firstLockPlacements); it != end(firstLockPlacements); ++it) {
     LockPlacement firstPlacement = *it;
     maybePrint("\n\n\n\nNEW FIRST MOVE: rot=%d x=%d\n", firstPlacement.rotationIndex, firstPlacement.x);
@@ -107,10 +109,23 @@ int searchDepth2(GameState gameState, const Piece *firstPiece, const Piece *seco
     }
 
     float firstMoveReward = getLineClearFactor(afterFirstMove.lines - gameState.lines, evalContext->weights, evalContext->shouldRewardLineClears);
+    firstPlyResults.push_back({firstPlacement, afterFirstMove, firstMoveReward});
+  }
+  return (int) firstPlyResults.size();
+}
+
+/** Searches the second ply of a 2-ply search from the results of the first, and performs a fast eval on each of the resulting states.
+ * @returns an UNSORTED list of evaluated possibilities
+ */
+int searchSecondPly(vector<FirstPlyResult> const &firstPlyResults, const Piece *secondPiece, const EvalContext *evalContext, OUT list<Possibility> &possibilityList){
+  for (FirstPlyResult const &firstPlyResult : firstPlyResults) {
+    LockPlacement firstPlacement = firstPlyResult.placement;
+    GameState afterFirstMove = firstPlyResult.resultingState;
+    float firstMoveReward = firstPlyResult.reward;
 
     // Get the placements of the second piece
     vector<LockPlacement> secondLockPlacements;
-    moveSearch(afterFirstMove, secondPiece, evalContext->pieceRangeContext.inputFrameTimeline, secondLockPlacements);
+    moveSearch(afterFirstMove, secondPiece, evalContext->pieceRangeContext.inputSchedule, secondLockPlacements);
 
     for (auto secondPlacement : secondLockPlacements) {
       GameState resultingState = advanceGameState(afterFirstMove, secondPlacement, evalContext);
@@ -134,6 +149,27 @@ int searchDepth2(GameState gameState, const Piece *firstPiece, const Piece *seco
   return (int) possibilityList.size();
 }
 
+/** Searches 2-ply from a starting state, and performs a fast eval on each of the resulting states. 
+ * @returns an UNSORTED list of evaluated possibilities
+ */
+int searchDepth2(GameState gameState, const Piece *firstPiece, const Piece *secondPiece, int keepTopN, const EvalContext *evalContext, OUT list<Possibility> &possibilityList){
+  TraceSpan span("searchDepth2");
+  vector<FirstPlyResult> firstPlyResults;
+  searchFirstPly(gameState, firstPiece, evalContext, firstPlyResults);
+  return searchSecondPly(firstPlyResults, secondPiece, evalContext, possibilityList);
+}
+
+/**
+ * Plays out a list of candidate possibilities, spread over CANDIDATE_PLAYOUT_THREADS threads.
+ * @param overallScores - for each candidate, its immediate reward plus its playout score
+ */
+void playOutCandidates(vector<const Possibility *> const &candidates, int playoutCount, int playoutLength, const PieceRangeContext pieceRangeContextLookup[3], int lastSeenPieceIndex, const EvalContext *evalContext, OUT vector<float> &overallScores){
+  overallScores.assign(candidates.size(), 0);
+  parallelFor((int) candidates.size(), CANDIDATE_PLAYOUT_THREADS, [&](int i) {
+    overallScores[i] = candidates[i]->immediateReward + getPlayoutScore(candidates[i]->resultingState, playoutCount, playoutLength, pieceRangeContextLookup, lastSeenPieceIndex, evalContext->weightSet, evalContext->cancellationToken, /* playoutScores= */ NULL);
+  });
+}
+
 /** Plays one move from a given state, with or without knowledge of the next box.*/
 LockLocation playOneMove(GameState gameState, const Piece *firstPiece, const Piece *secondPiece, int numCandidatesToPlayout, int playoutCount, int playoutLength, const EvalContext *evalContext, const PieceRangeContext pieceRangeContextLookup[3]){
   // Get the list of evaluated possibilities
@@ -160,14 +196,21 @@ LockLocation playOneMove(GameState gameState, const Piece *firstPiece, const Pie
     return (*sortedList.begin()).firstPlacement;
   }
 
-  LockLocation bestLockLocation = {NONE, NONE, NONE};
-  float bestPossibilityScore = FLOAT_MIN;
-  int numPlayedOut = 0;
-  for (auto possibility : sortedList){
-    if (numPlayedOut >= numCandidatesToPlayout) {
+  vector<const Possibility *> candidates;
+  for (Possibility const& possibility : sortedList){
+    if ((int) candidates.size() >= numCandidatesToPlayout) {
       break;
     }
-    float overallScore = possibility.immediateReward + getPlayoutScore(possibility.resultingState, playoutCount, playoutLength, pieceRangeContextLookup, lastSeenPiece->index, /* playoutDataList */ NULL);
+    candidates.push_back(&possibility);
+  }
+  vector<float> candidateScores;
+  playOutCandidates(candidates, playoutCount, playoutLength, pieceRangeContextLookup, lastSeenPiece->index, evalContext, candidateScores);
+
+  LockLocation bestLockLocation = {NONE, NONE, NONE};
+  float bestPossibilityScore = FLOAT_MIN;
+  for (size_t i = 0; i < candidates.size(); i++){
+    Possibility const& possibility = *candidates[i];
+    float overallScore = candidateScores[i];
 
     maybePrint("Possibility %d %d has overallscore %f %f\n", possibility.firstPlacement.rotationIndex, possibility.firstPlacement.x - 3, overallScore, possibility.evalScoreInclReward);
 
@@ -176,7 +219,6 @@ LockLocation playOneMove(GameState gameState, const Piece *firstPiece, const Pie
       bestLockLocation = possibility.firstPlacement;
       bestPossibilityScore = overallScore;
     }
-    numPlayedOut++;
   }
 
   if (SHOULD_PLAY_PERFECT && bestPossibilityScore < 0.0001){
@@ -190,7 +232,7 @@ LockLocation playOneMove(GameState gameState, const Piece *firstPiece, const Pie
  * Finds the move out of a list of possibilities that has the resulting board equal to the player's resulting board.
  * NB: REMOVES THE ELEMENT FROM THE LIST IN-PLACE (to avoid having to do that later in rateMove())
  */
-Possibility findPlayerMove(list<Possibility> possibilityList, unsigned int playerBoardAfter[20]){
+Possibility findPlayerMove(list<Possibility> &possibilityList, unsigned int playerBoardAfter[20]){
   // Find the player move
   for (list<Possibility>::iterator iter=possibilityList.begin(); iter!=possibilityList.end(); iter++) {
     bool boardEqual = true;
@@ -202,15 +244,20 @@ Possibility findPlayerMove(list<Possibility> possibilityList, unsigned int playe
       }
     }
     if (boardEqual){
+      Possibility playerMove = *iter;
       possibilityList.erase(iter);
-      return *iter;
+      return playerMove;
     }
   }
   // Error out
   return {NULL_LOCK_LOCATION,NULL_LOCK_LOCATION,{}, -1, -1 /* rest default initializer */};
 }
 
-std::string rateMove(GameState gameState, const Piece *firstPiece, const Piece *secondPiece, unsigned int playerBoardAfter[20], int numCandidatesToPlayout, int playoutCount, int playoutLength, const EvalContext *evalContext, const PieceRangeContext pieceRangeContextLookup[3]){
+/**
+ * Compares a player's move to the best moves, with and without the next piece.
+ * @param playoutCache - if non-NULL, playout scores are shared with other requests through this cache
+ */
+std::string rateMove(GameState gameState, const Piece *firstPiece, const Piece *secondPiece, unsigned int playerBoardAfter[20], int numCandidatesToPlayout, int playoutCount, int playoutLength, const EvalContext *evalContext, const PieceRangeContext pieceRangeContextLookup[3], PlayoutCache *playoutCache){
   list<Possibility> possibilityListD1;
   list<Possibility> possibilityListD2;
   list<Possibility> sortedListD1; // Does not include player move
@@ -269,7 +316,7 @@ std::string rateMove(GameState gameState, const Piece *firstPiece, const Piece *
   // PLAYOUTS NEEDED
   else {
     // NNB Playouts (first on the player move, then on the rest)
-    playerValNoAdj = playerMove.immediateReward + getPlayoutScore(playerMove.resultingState, playoutCount, playoutLength, pieceRangeContextLookup, firstPiece->index, /* playoutDataList */ NULL);
+    playerValNoAdj = playerMove.immediateReward + getCachedPlayoutScore(playoutCache, playerMove.resultingState, playoutCount, playoutLength, pieceRangeContextLookup, firstPiece->index, evalContext->weightSet, evalContext->cancellationToken, /* playoutScores= */ NULL);
     
     bestValNoAdj = playerValNoAdj;
     int numPlayedOut = 0;
@@ -277,7 +324,7 @@ std::string rateMove(GameState gameState, const Piece *firstPiece, const Piece *
       if (numPlayedOut >= numCandidatesToPlayout) {
         break;
       }
-      float overallScore = possibility.immediateReward + getPlayoutScore(possibility.resultingState, playoutCount, playoutLength, pieceRangeContextLookup, firstPiece->index, /* playoutDataList */ NULL);
+      float overallScore = possibility.immediateReward + getCachedPlayoutScore(playoutCache, possibility.resultingState, playoutCount, playoutLength, pieceRangeContextLookup, firstPiece->index, evalContext->weightSet, evalContext->cancellationToken, /* playoutScores= */ NULL);
       if (overallScore > bestValNoAdj) {
         bestValNoAdj = overallScore;
       }
@@ -295,7 +342,7 @@ std::string rateMove(GameState gameState, const Piece *firstPiece, const Piece *
         if (numPlayedOut >= numCandidatesToPlayout) {
           break;
         }
-        float overallScore = possibility.immediateReward + getPlayoutScore(possibility.resultingState, playoutCount, playoutLength, pieceRangeContextLookup, secondPiece->index, /* playoutDataList */ NULL);
+        float overallScore = possibility.immediateReward + getCachedPlayoutScore(playoutCache, possibility.resultingState, playoutCount, playoutLength, pieceRangeContextLookup, secondPiece->index, evalContext->weightSet, evalContext->cancellationToken, /* playoutScores= */ NULL);
         if (bestValUnset || overallScore > bestValAfterAdj) {
           bestValUnset = false;
           bestValAfterAdj = overallScore;
@@ -310,9 +357,21 @@ std::string rateMove(GameState gameState, const Piece *firstPiece, const Piece *
     }
   }
 
+  TraceSpan formatSpan("format");
   return formatRateMove(playerValNoAdj, bestValNoAdj, playerValAfterAdj, bestValAfterAdj, hasNb);
 }
 
+/**
+ * Selects the playout at a given rank, where rank 0 is the best score. Ties are ranked by playout index, so that the selection is
+ * deterministic. Partially reorders the list.
+ */
+PlayoutScoreEntry selectPlayoutByRank(OUT vector<PlayoutScoreEntry> &playoutScores, int rank){
+  std::nth_element(playoutScores.begin(), playoutScores.begin() + rank, playoutScores.end(), [](PlayoutScoreEntry const &a, PlayoutScoreEntry const &b) {
+    return a.score > b.score || (a.score == b.score && a.playoutIndex < b.playoutIndex);
+  });
+  return playoutScores[rank];
+}
+
 /**
  * Gets a list of the top moves, formatted as a JSON string. (See formatting.hpp for exact format details).
  */
@@ -324,8 +383,6 @@ std::string getTopMoveList(GameState gameState, const Piece *firstPiece, const P
 
   // Get the list of evaluated possibilities
   list<Possibility> possibilityList;
-  list<Possibility> initiallySortedList;
-  list<EngineMoveData> sortedList;
   
   // Search depth either 1 or 2 depending on whether a next piece was provided
   const Piece *lastSeenPiece;
@@ -336,7 +393,58 @@ std::string getTopMoveList(GameState gameState, const Piece *firstPiece, const P
     searchDepth2(gameState, firstPiece, secondPiece, numSorted, evalContext, possibilityList);
     lastSeenPiece = secondPiece;
   }
+  return playOutTopMoves(possibilityList, firstPiece, secondPiece, lastSeenPiece, keepTopN, playoutCount, playoutLength, evalContext, pieceRangeContextLookup, /* playoutCache= */ NULL);
+}
+
+/**
+ * Gets the top moves for both GET_TOP_MOVES_HYBRID cases (without and with the next piece) from a single shared search.
+ * The placements of the first piece are only searched once, the two cases are played out in parallel, and their playouts share a cache.
+ * @returns the same JSON as two calls to getTopMoveList(), as {"noNextBox": ..., "nextBox": ...}
+ */
+std::string getTopMovesHybrid(GameState gameState, const Piece *firstPiece, const Piece *secondPiece, int keepTopN, int playoutCount, int playoutLength, const EvalContext *evalContext, const PieceRangeContext pieceRangeContextLookup[3]){
+  vector<FirstPlyResult> firstPlyResults;
+  searchFirstPly(gameState, firstPiece, evalContext, firstPlyResults);
+
+  // The depth 1 possibilities are just the first ply, with an eval
+  list<Possibility> depth1List;
+  for (FirstPlyResult const &firstPlyResult : firstPlyResults) {
+    LockPlacement firstPlacement = firstPlyResult.placement;
+    depth1List.push_back({
+      { firstPlacement.x, firstPlacement.y, firstPlacement.rotationIndex },
+      NULL_LOCK_LOCATION,
+      firstPlyResult.resultingState,
+      fastEval(gameState, firstPlyResult.resultingState, firstPlacement, evalContext),
+      firstPlyResult.reward
+    });
+  }
+
+  // The two cases are independent from here on, so play them out in parallel
+  PlayoutCache playoutCache;
+  std::string nnbResult;
+  std::string nbResult;
+  parallelFor(secondPiece != NULL ? 2 : 1, HYBRID_SEARCH_THREADS, [&](int i) {
+    if (i == 0) {
+      nnbResult = playOutTopMoves(depth1List, firstPiece, /* secondPiece= */ NULL, /* lastSeenPiece= */ firstPiece, keepTopN, playoutCount, playoutLength, evalContext, pieceRangeContextLookup, &playoutCache);
+    } else {
+      list<Possibility> depth2List;
+      searchSecondPly(firstPlyResults, secondPiece, evalContext, depth2List);
+      nbResult = playOutTopMoves(depth2List, firstPiece, secondPiece, /* lastSeenPiece= */ secondPiece, keepTopN, playoutCount, playoutLength, evalContext, pieceRangeContextLookup, &playoutCache);
+    }
+  });
+  if (secondPiece == NULL) {
+    nbResult = nnbResult;
+  }
+  return "{\"noNextBox\":" + nnbResult + ", \"nextBox\":" + nbResult + "}";
+}
 
+/**
+ * Plays out the most promising possibilities, and formats the best of them as a list of top moves.
+ * @param playoutCache - if non-NULL, playouts are shared with other calls through this cache
+ */
+std::string playOutTopMoves(list<Possibility> &possibilityList, const Piece *firstPiece, const Piece *secondPiece, const Piece *lastSeenPiece, int keepTopN, int playoutCount, int playoutLength, const EvalContext *evalContext, const PieceRangeContext pieceRangeContextLookup[3], PlayoutCache *playoutCache){
+  int numSorted = keepTopN * 2;
+  list<Possibility> initiallySortedList;
+  list<EngineMoveData> sortedList;
   if (possibilityList.size() == 0){
     return "No legal moves";
   }
@@ -345,128 +453,352 @@ std::string getTopMoveList(GameState gameState, const Piece *firstPiece, const P
   // Perform playouts on the promising possibilities
   int numAdded = 0;
   for (Possibility const& possibility : initiallySortedList) {
-    if (numAdded >= keepTopN){
+    if (numAdded >= keepTopN || isSearchCancelled(evalContext->cancellationToken)){
       break;
     }
     // printf("Doing playout for: %s %s\n", encodeLockPosition(possibility.firstPlacement).c_str(), encodeLockPosition(possibility.secondPlacement).c_str());
     string lockPosEncoded = encodeLockPosition(possibility.firstPlacement);
-    vector<PlayoutData> playoutDataList = {};
+    vector<PlayoutScoreEntry> playoutScores = {};
     float overallScore = possibility.immediateReward 
-          + getPlayoutScore(possibility.resultingState, playoutCount, playoutLength, pieceRangeContextLookup, lastSeenPiece->index, &playoutDataList);
+          + getCachedPlayoutScore(playoutCache, possibility.resultingState, playoutCount, playoutLength, pieceRangeContextLookup, lastSeenPiece->index, evalContext->weightSet, evalContext->cancellationToken, &playoutScores);
 
     // If this position has no legal playouts, ignore it
-    if (playoutDataList.size() == 0){
+    if (playoutScores.size() == 0){
       continue;
     }
-    // Pick 7 playouts from the sorted playout list
-    int len = (int) playoutDataList.size();
+    // Pick 7 playouts by rank, ordered best (100%ile) to worst (0%ile), then replay just those to get their details.
+    // Fractions are "backwards" because of that ordering.
+    int len = (int) playoutScores.size();
+    int percentileRanks[7] = {
+      /* best case */ 0,
+      /* 83 %ile */ len / 6,
+      /* 66 %ile */ len / 3,
+      /* median */ len / 2,
+      /* 33 %ile */ len * 2 / 3,
+      /* 16 %ile */ len * 5 / 6,
+      /* worst case */ len - 1
+    };
+    PlayoutData percentilePlayouts[7];
+    for (int p = 0; p < 7; p++) {
+      PlayoutScoreEntry entry = selectPlayoutByRank(playoutScores, percentileRanks[p]);
+      percentilePlayouts[p] = replayPlayout(possibility.resultingState, playoutCount, playoutLength, pieceRangeContextLookup, lastSeenPiece->index, evalContext->weightSet, entry.playoutIndex);
+    }
     EngineMoveData newMoveData = {
       possibility.firstPlacement,
       possibility.secondPlacement,
       /* playoutScore */ overallScore,
       /* shallowEvalScore */ possibility.evalScoreInclReward,
       /* resultingBoard */ formatBoard(possibility.resultingState.board),
-      /* playout1 (best case) */ playoutDataList.at(0),
-      /* playout2 (83 %ile case) */ playoutDataList.at(len / 6), // Fractions are "backwards" because moves are ordered best (100%ile) to worst (0%ile).
-      /* playout3 (66 %ile case) */ playoutDataList.at(len / 3),
-      /* playout4 (median case) */ playoutDataList.at(len / 2),
-      /* playout5 (33 %ile case) */ playoutDataList.at(len * 2 / 3),
-      /* playout6 (16 %ile case) */ playoutDataList.at(len * 5 / 6),
-      /* playout7 (worst case) */ playoutDataList.at(len - 1),
+      /* playout1 (best case) */ percentilePlayouts[0],
+      /* playout2 (83 %ile case) */ percentilePlayouts[1],
+      /* playout3 (66 %ile case) */ percentilePlayouts[2],
+      /* playout4 (median case) */ percentilePlayouts[3],
+      /* playout5 (33 %ile case) */ percentilePlayouts[4],
+      /* playout6 (16 %ile case) */ percentilePlayouts[5],
+      /* playout7 (worst case) */ percentilePlayouts[6],
     };
     insertIntoList(newMoveData, sortedList);
     numAdded++;
   }
 
+  TraceSpan formatSpan("format");
   return formatEngineMoveList(sortedList, firstPiece, secondPiece);
 }
 
+/** Gets the index of a lock position in a LockValueTable, or -1 if it's outside the table. */
+int getLockTableIndex(LockLocation lockLocation){
+  int xIndex = lockLocation.x - LOCK_TABLE_MIN_X;
+  int yIndex = lockLocation.y - LOCK_TABLE_MIN_Y;
+  if (lockLocation.rotationIndex < 0 || lockLocation.rotationIndex > 3 || xIndex < 0 || xIndex >= LOCK_TABLE_NUM_X || yIndex < 0 || yIndex >= LOCK_TABLE_NUM_Y) {
+    printf("lock position out of range %d|%d|%d\n", lockLocation.rotationIndex, lockLocation.x, lockLocation.y);
+    return -1;
+  }
+  return (lockLocation.rotationIndex * LOCK_TABLE_NUM_X + xIndex) * LOCK_TABLE_NUM_Y + yIndex;
+}
 
+LockLocation getLockTableLocation(int index){
+  return {
+    (index / LOCK_TABLE_NUM_Y) % LOCK_TABLE_NUM_X + LOCK_TABLE_MIN_X,
+    index % LOCK_TABLE_NUM_Y + LOCK_TABLE_MIN_Y,
+    index / (LOCK_TABLE_NUM_X * LOCK_TABLE_NUM_Y)
+  };
+}
 
-/** Calculates the valuation of every possible terminal position for a given piece on a given board, and stores it in a map.
+/** Gets the lock position with the highest value in a table, or NULL_LOCK_LOCATION if the table is empty. */
+LockLocation getBestLockLocation(const LockValueTable &lockValueTable){
+  int bestIndex = -1;
+  for (int index = 0; index < LOCK_TABLE_SIZE; index++) {
+    if (lockValueTable.isPresent[index] && (bestIndex == -1 || lockValueTable.values[index] > lockValueTable.values[bestIndex])) {
+      bestIndex = index;
+    }
+  }
+  return bestIndex == -1 ? NULL_LOCK_LOCATION : getLockTableLocation(bestIndex);
+}
+
+/** Calculates the valuation of every possible terminal position for a given piece on a given board, and encodes it as JSON.
  * @param keepTopN - How many possibilities to evaluate via a full set of playouts, as opposed to just the eval function.
+ * @param bestLockLocation - if non-NULL, set to the highest valued lock position
  */
-std::string getLockValueLookupEncoded(GameState gameState, const Piece *firstPiece, const Piece *secondPiece, int keepTopN, int playoutCount, int playoutLength, const EvalContext *evalContext, const PieceRangeContext pieceRangeContextLookup[3]){
-  unordered_map<string, float> lockValueMap;
-  unordered_map<string, int> lockValueRepeatMap;
+std::string getLockValueLookupEncoded(GameState gameState, const Piece *firstPiece, const Piece *secondPiece, int keepTopN, int playoutCount, int playoutLength, const EvalContext *evalContext, const PieceRangeContext pieceRangeContextLookup[3], OUT LockLocation *bestLockLocation){
+  LockValueTable lockValueTable = {};
+  getLockValueTable(gameState, firstPiece, secondPiece, keepTopN, playoutCount, playoutLength, evalContext, pieceRangeContextLookup, lockValueTable);
+  if (bestLockLocation != NULL) {
+    *bestLockLocation = getBestLockLocation(lockValueTable);
+  }
+  return formatLockValueTable(lockValueTable);
+}
 
+/** Same as getLockValueLookupEncoded, but in the packed binary form from packLockValueTable. */
+std::string getLockValueLookupPacked(GameState gameState, const Piece *firstPiece, const Piece *secondPiece, int keepTopN, int playoutCount, int playoutLength, const EvalContext *evalContext, const PieceRangeContext pieceRangeContextLookup[3], OUT LockLocation *bestLockLocation){
+  LockValueTable lockValueTable = {};
+  getLockValueTable(gameState, firstPiece, secondPiece, keepTopN, playoutCount, playoutLength, evalContext, pieceRangeContextLookup, lockValueTable);
+  if (bestLockLocation != NULL) {
+    *bestLockLocation = getBestLockLocation(lockValueTable);
+  }
+  return packLockValueTable(lockValueTable);
+}
+
+/** Calculates the valuation of every possible terminal position for a given piece on a given board, and stores it in a table. */
+void getLockValueTable(GameState gameState, const Piece *firstPiece, const Piece *secondPiece, int keepTopN, int playoutCount, int playoutLength, const EvalContext *evalContext, const PieceRangeContext pieceRangeContextLookup[3], OUT LockValueTable &lockValueTable){
   // Keep a running list of the top X possibilities as the move search is happening.
   // Keep twice as many as we'll eventually need, since some duplicates may be removed before playouts start
   int numSorted = keepTopN * 2;
   
   // Get the list of evaluated possibilities
   list<Possibility> possibilityList;
-  list<Possibility> sortedList;
   searchDepth2(gameState, firstPiece, secondPiece, numSorted, evalContext, possibilityList);
+  fillLockValueTable(possibilityList, secondPiece, keepTopN, playoutCount, playoutLength, evalContext, pieceRangeContextLookup, lockValueTable);
+}
+
+/** Plays out the most promising of the 2-ply possibilities, and encodes the best value found at each first lock position as JSON. */
+std::string encodeLockValueLookup(list<Possibility> &possibilityList, const Piece *secondPiece, int keepTopN, int playoutCount, int playoutLength, const EvalContext *evalContext, const PieceRangeContext pieceRangeContextLookup[3]){
+  LockValueTable lockValueTable = {};
+  fillLockValueTable(possibilityList, secondPiece, keepTopN, playoutCount, playoutLength, evalContext, pieceRangeContextLookup, lockValueTable);
+  return formatLockValueTable(lockValueTable);
+}
+
+/** Plays out the most promising of the 2-ply possibilities, and records the best value found at each first lock position. */
+void fillLockValueTable(list<Possibility> &possibilityList, const Piece *secondPiece, int keepTopN, int playoutCount, int playoutLength, const EvalContext *evalContext, const PieceRangeContext pieceRangeContextLookup[3], OUT LockValueTable &lockValueTable){
+  int numSorted = keepTopN * 2;
+  list<Possibility> sortedList;
   partiallySortPossibilityList(possibilityList, numSorted, sortedList);
 
   // If no playouts, just use the eval
   if (playoutCount * playoutLength == 0){
     for (Possibility const& possibility : sortedList) {
-      string lockPosEncoded = encodeLockPosition(possibility.firstPlacement);
+      int lockIndex = getLockTableIndex(possibility.firstPlacement);
+      if (lockIndex == -1) {
+        continue;
+      }
       float overallScore = MAP_OFFSET + possibility.evalScoreInclReward;
-      if (overallScore > lockValueMap[lockPosEncoded]) {
-        lockValueMap[lockPosEncoded] = overallScore;
+      lockValueTable.isPresent[lockIndex] = true;
+      if (overallScore > lockValueTable.values[lockIndex]) {
+        lockValueTable.values[lockIndex] = overallScore;
       }
     }
   } else {
-    // Perform playouts on the promising possibilities
+    // Decide which possibilities to play out. This doesn't depend on the playout results, so the playouts can then run in parallel.
     int i = 0;
     int numPlayedOut = 0;
     int firstPlacementRepeatCap = floor(LOCK_POSITION_REPEAT_CAP_PROPORTION * keepTopN);
+    vector<const Possibility *> candidates;
+    vector<bool> shouldPlayoutByIndex;
     for (Possibility const& possibility : sortedList) {
-      string lockPosEncoded = encodeLockPosition(possibility.firstPlacement);
+      int lockIndex = getLockTableIndex(possibility.firstPlacement);
+      if (lockIndex == -1) {
+        shouldPlayoutByIndex.push_back(false);
+        i++;
+        continue;
+      }
       // Cap the number of times a lock position can be repeated (despite differing second placements)
-      int shouldPlayout = i < numSorted && numPlayedOut < keepTopN && lockValueRepeatMap[lockPosEncoded] < firstPlacementRepeatCap;
+      int shouldPlayout = i < numSorted && numPlayedOut < keepTopN && lockValueTable.repeats[lockIndex] < firstPlacementRepeatCap;
       if (PLAYOUT_LOGGING_ENABLED) {
-        printf("\n----%s, repeats %d, willPlay %d\n", lockPosEncoded.c_str(), lockValueRepeatMap[lockPosEncoded], shouldPlayout);
+        printf("\n----%s, repeats %d, willPlay %d\n", encodeLockPosition(possibility.firstPlacement).c_str(), lockValueTable.repeats[lockIndex], shouldPlayout);
       }
-      lockValueRepeatMap[lockPosEncoded] += 1;
+      lockValueTable.repeats[lockIndex] += 1;
+      shouldPlayoutByIndex.push_back(shouldPlayout);
+      if (shouldPlayout) {
+        candidates.push_back(&possibility);
+        numPlayedOut++;
+      }
+      i++;
+    }
+    vector<float> candidateScores;
+    playOutCandidates(candidates, playoutCount, playoutLength, pieceRangeContextLookup, secondPiece->index, evalContext, candidateScores);
 
+    // Record the best value at each lock position, in the original order
+    i = 0;
+    int candidateIndex = 0;
+    for (Possibility const& possibility : sortedList) {
+      int lockIndex = getLockTableIndex(possibility.firstPlacement);
+      bool shouldPlayout = shouldPlayoutByIndex[i++];
+      if (lockIndex == -1) {
+        continue;
+      }
       float overallScore = MAP_OFFSET + (shouldPlayout
-         ? possibility.immediateReward + getPlayoutScore(possibility.resultingState, playoutCount, playoutLength, pieceRangeContextLookup, secondPiece->index, /* playoutDataList */ NULL)
+         ? candidateScores[candidateIndex++]
          : (SHOULD_PLAY_PERFECT ? 0 : evalContext->weights.deathCoef));
-      
-      if (overallScore > lockValueMap[lockPosEncoded]) {
+
+      lockValueTable.isPresent[lockIndex] = true;
+      if (overallScore > lockValueTable.values[lockIndex]) {
         if (PLAYOUT_LOGGING_ENABLED || PLAYOUT_RESULT_LOGGING_ENABLED) {
           if (shouldPlayout) {
-            printf("Adding to map: %s %f (%f + %f)\n", lockPosEncoded.c_str(), overallScore - MAP_OFFSET, possibility.immediateReward, overallScore - possibility.immediateReward - MAP_OFFSET);
+            printf("Adding to map: %s %f (%f + %f)\n", encodeLockPosition(possibility.firstPlacement).c_str(), overallScore - MAP_OFFSET, possibility.immediateReward, overallScore - possibility.immediateReward - MAP_OFFSET);
           }
         }
-        lockValueMap[lockPosEncoded] = overallScore;
+        lockValueTable.values[lockIndex] = overallScore;
       } else if (PLAYOUT_LOGGING_ENABLED || PLAYOUT_RESULT_LOGGING_ENABLED) {
         if (shouldPlayout) {
-          printf("Score of %.1f is worse than existing move %.1f\n", overallScore, lockValueMap[lockPosEncoded]);
+          printf("Score of %.1f is worse than existing move %.1f\n", overallScore, lockValueTable.values[lockIndex]);
         }
       }
-      i++;
-      if (shouldPlayout) {
-        numPlayedOut++;
-      }
     }
   }
+}
 
-  // Encode lookup to JSON
+/** Encodes a lock value table to JSON, keyed by "rot|x|y" as in encodeLockPosition(). */
+std::string formatLockValueTable(const LockValueTable &lockValueTable){
+  TraceSpan formatSpan("format");
   std::string mapEncoded = std::string("{");
-  // float globalMax = 0; // Only used for perfect play
-  for( const auto& n : lockValueMap ) {
-    char mapEntryBuf[30];
-    snprintf(mapEntryBuf, 30, "\"%s\":%.2f,", n.first.c_str(), n.second - MAP_OFFSET);
-    mapEncoded.append(mapEntryBuf);
-    // if (SHOULD_PLAY_PERFECT){
-    //   globalMax = std::max(globalMax, n.second - MAP_OFFSET);
-    // }
-  }
-  // if (SHOULD_PLAY_PERFECT && globalMax < FLOAT_EPSILON){
-  //   return "{\"abort\": true}";
-  // }
-  if (lockValueMap.size() > 0) {
+  char mapEntryBuf[30];
+  for (int index = 0; index < LOCK_TABLE_SIZE; index++) {
+    if (!lockValueTable.isPresent[index]) {
+      continue;
+    }
+    LockLocation lockLocation = getLockTableLocation(index);
+    int len = snprintf(mapEntryBuf, 30, "\"%d|%d|%d\":%.2f,", lockLocation.rotationIndex, lockLocation.x, lockLocation.y, lockValueTable.values[index] - MAP_OFFSET);
+    mapEncoded.append(mapEntryBuf, std::min(len, 29));
+  }
+  if (mapEncoded.length() > 1) {
     mapEncoded.pop_back(); // Remove the last comma
   }
   mapEncoded.append("}");
   return mapEncoded;
 }
 
+/**
+ * Encodes a lock value table in a packed binary form, for callers that don't want to parse JSON.
+ * The output is a little-endian uint16 entry count, followed by 8 bytes per entry: int8 rotation, int8 x, int8 y, one byte of padding,
+ * and the float32 value.
+ */
+std::string packLockValueTable(const LockValueTable &lockValueTable){
+  TraceSpan formatSpan("format");
+  std::string packed(2, '\0');
+  int numEntries = 0;
+  for (int index = 0; index < LOCK_TABLE_SIZE; index++) {
+    if (!lockValueTable.isPresent[index]) {
+      continue;
+    }
+    LockLocation lockLocation = getLockTableLocation(index);
+    uint32_t valueBits;
+    float value = lockValueTable.values[index] - MAP_OFFSET;
+    memcpy(&valueBits, &value, sizeof(float));
+    char entry[8] = {
+      (char) lockLocation.rotationIndex,
+      (char) lockLocation.x,
+      (char) lockLocation.y,
+      0,
+      (char) (valueBits & 0xFF),
+      (char) ((valueBits >> 8) & 0xFF),
+      (char) ((valueBits >> 16) & 0xFF),
+      (char) ((valueBits >> 24) & 0xFF)
+    };
+    packed.append(entry, 8);
+    numEntries++;
+  }
+  packed[0] = (char) (numEntries & 0xFF);
+  packed[1] = (char) ((numEntries >> 8) & 0xFF);
+  return packed;
+}
+
+/**
+ * Decodes the output of packLockValueTable. The values keep the MAP_OFFSET subtracted, as in the packed form.
+ * @returns false if the packed table is malformed
+ */
+bool unpackLockValueTable(std::string const &packed, OUT LockValueTable &lockValueTable){
+  if (packed.length() < 2) {
+    return false;
+  }
+  int numEntries = (unsigned char) packed[0] | ((unsigned char) packed[1] << 8);
+  if (packed.length() != 2 + 8 * (size_t) numEntries) {
+    return false;
+  }
+  for (int i = 0; i < numEntries; i++) {
+    const char *entry = packed.data() + 2 + 8 * i;
+    int index = getLockTableIndex({(signed char) entry[1], (signed char) entry[2], (signed char) entry[0]});
+    if (index == -1) {
+      return false;
+    }
+    uint32_t valueBits = (uint32_t) (unsigned char) entry[4] | ((uint32_t) (unsigned char) entry[5] << 8)
+                         | ((uint32_t) (unsigned char) entry[6] << 16) | ((uint32_t) (unsigned char) entry[7] << 24);
+    memcpy(&lockValueTable.values[index], &valueBits, sizeof(float));
+    lockValueTable.isPresent[index] = true;
+  }
+  return true;
+}
+
+/**
+ * Decodes the output of getLockValueLookupAllNextPieces into a table per next piece (indexed like PIECE_LIST). The values keep the
+ * MAP_OFFSET subtracted, as in the JSON.
+ * @returns false if the lookups are malformed
+ */
+bool parseLockValueLookupAllNextPieces(std::string const &encoded, OUT LockValueTable lockValueTables[7]){
+  for (int pieceIndex = 0; pieceIndex < 7; pieceIndex++) {
+    size_t pos = encoded.find(std::string("\"") + getPieceChar(pieceIndex) + "\":{");
+    if (pos == std::string::npos) {
+      return false;
+    }
+    pos += 5; // The quoted piece, the colon and the brace
+    while (pos < encoded.length() && encoded[pos] == '"') {
+      int rotationIndex, x, y, numChars;
+      float value;
+      if (sscanf(encoded.c_str() + pos, "\"%d|%d|%d\":%f%n", &rotationIndex, &x, &y, &value, &numChars) != 4) {
+        return false;
+      }
+      int index = getLockTableIndex({x, y, rotationIndex});
+      if (index == -1) {
+        return false;
+      }
+      lockValueTables[pieceIndex].values[index] = value;
+      lockValueTables[pieceIndex].isPresent[index] = true;
+      pos += numChars;
+      if (pos < encoded.length() && encoded[pos] == ',') {
+        pos++;
+      }
+    }
+  }
+  return true;
+}
+
+/**
+ * Calculates the lock value lookup for each of the 7 possible next pieces, as a JSON object keyed by piece (e.g. {"I":{...},"O":{...}}).
+ * Each lookup matches getLockValueLookupEncoded for that next piece, but the first piece's placements are only searched once,
+ * and the next pieces are computed in parallel.
+ */
+std::string getLockValueLookupAllNextPieces(GameState gameState, const Piece *firstPiece, int keepTopN, int playoutCount, int playoutLength, const EvalContext *evalContext, const PieceRangeContext pieceRangeContextLookup[3]){
+  vector<FirstPlyResult> firstPlyResults;
+  {
+    TraceSpan span("searchFirstPly");
+    searchFirstPly(gameState, firstPiece, evalContext, firstPlyResults);
+  }
+
+  std::string lookupsByPiece[7];
+  parallelFor(7, NEXT_PIECE_PRECOMPUTE_THREADS, [&](int pieceIndex) {
+    TraceSpan span("nextPieceLookup", pieceIndex);
+    const Piece *secondPiece = &PIECE_LIST[pieceIndex];
+    list<Possibility> possibilityList;
+    searchSecondPly(firstPlyResults, secondPiece, evalContext, possibilityList);
+    lookupsByPiece[pieceIndex] = encodeLockValueLookup(possibilityList, secondPiece, keepTopN, playoutCount, playoutLength, evalContext, pieceRangeContextLookup);
+  });
+
+  std::string encoded = "{";
+  for (int pieceIndex = 0; pieceIndex < 7; pieceIndex++) {
+    encoded += std::string("\"") + getPieceChar(pieceIndex) + "\":" + lookupsByPiece[pieceIndex];
+    encoded += pieceIndex < 6 ? "," : "}";
+  }
+  return encoded;
+}
+
 
 // void evaluatePossibilitiesWithPlayouts(int timeoutMs){
 //   auto millisec_since_epoch = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
@@ -3,13 +3,46 @@
 
 #include "types.hpp"
 #include "utils.hpp"
+#include "playout.hpp"
 #include <list>
 #include <algorithm>
 
+void playOutCandidates(std::vector<const Possibility *> const &candidates, int playoutCount, int playoutLength, const PieceRangeContext pieceRangeContextLookup[3], int lastSeenPieceIndex, const EvalContext *evalContext, OUT std::vector<float> &overallScores);
+
 LockLocation playOneMove(GameState gameState, const Piece *curPiece, const Piece *nextPiece, int numCandidatesToPlayout, int playoutCount, int playoutLength, const EvalContext *evalContext, const PieceRangeContext pieceRangeContextLookup[3]);
 
+PlayoutScoreEntry selectPlayoutByRank(OUT std::vector<PlayoutScoreEntry> &playoutScores, int rank);
+
 std::string getTopMoveList(GameState gameState, const Piece *firstPiece, const Piece *secondPiece, int keepTopN, int playoutCount, int playoutLength, const EvalContext *evalContext, const PieceRangeContext pieceRangeContextLookup[3]);
 
-std::string getLockValueLookupEncoded(GameState gameState, const Piece *firstPiece, const Piece *secondPiece, int keepTopN, int playoutCount, int playoutLength, const EvalContext *evalContext, const PieceRangeContext pieceRangeContextLookup[3]);
+std::string getTopMovesHybrid(GameState gameState, const Piece *firstPiece, const Piece *secondPiece, int keepTopN, int playoutCount, int playoutLength, const EvalContext *evalContext, const PieceRangeContext pieceRangeContextLookup[3]);
+
+std::string playOutTopMoves(std::list<Possibility> &possibilityList, const Piece *firstPiece, const Piece *secondPiece, const Piece *lastSeenPiece, int keepTopN, int playoutCount, int playoutLength, const EvalContext *evalContext, const PieceRangeContext pieceRangeContextLookup[3], PlayoutCache *playoutCache);
+
+int getLockTableIndex(LockLocation lockLocation);
+
+LockLocation getLockTableLocation(int index);
+
+LockLocation getBestLockLocation(const LockValueTable &lockValueTable);
+
+void getLockValueTable(GameState gameState, const Piece *firstPiece, const Piece *secondPiece, int keepTopN, int playoutCount, int playoutLength, const EvalContext *evalContext, const PieceRangeContext pieceRangeContextLookup[3], OUT LockValueTable &lockValueTable);
+
+void fillLockValueTable(std::list<Possibility> &possibilityList, const Piece *secondPiece, int keepTopN, int playoutCount, int playoutLength, const EvalContext *evalContext, const PieceRangeContext pieceRangeContextLookup[3], OUT LockValueTable &lockValueTable);
+
+std::string formatLockValueTable(const LockValueTable &lockValueTable);
+
+std::string packLockValueTable(const LockValueTable &lockValueTable);
+
+bool unpackLockValueTable(std::string const &packed, OUT LockValueTable &lockValueTable);
+
+bool parseLockValueLookupAllNextPieces(std::string const &encoded, OUT LockValueTable lockValueTables[7]);
+
+std::string getLockValueLookupPacked(GameState gameState, const Piece *firstPiece, const Piece *secondPiece, int keepTopN, int playoutCount, int playoutLength, const EvalContext *evalContext, const PieceRangeContext pieceRangeContextLookup[3], OUT LockLocation *bestLockLocation = NULL);
+
+std::string encodeLockValueLookup(std::list<Possibility> &possibilityList, const Piece *secondPiece, int keepTopN, int playoutCount, int playoutLength, const EvalContext *evalContext, const PieceRangeContext pieceRangeContextLookup[3]);
+
+std::string getLockValueLookupEncoded(GameState gameState, const Piece *firstPiece, const Piece *secondPiece, int keepTopN, int playoutCount, int playoutLength, const EvalContext *evalContext, const PieceRangeContext pieceRangeContextLookup[3], OUT LockLocation *bestLockLocation = NULL);
+
+std::string getLockValueLookupAllNextPieces(GameState gameState, const Piece *firstPiece, int keepTopN, int playoutCount, int playoutLength, const EvalContext *evalContext, const PieceRangeContext pieceRangeContextLookup[3]);
 
 #endif
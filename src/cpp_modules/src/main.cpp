@@ -5,20 +5,35 @@
 #include <string.h>
 
 
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
 #include "params.hpp"
+#include "tracing.hpp"
+#include "parallel.hpp"
+#include "cancellation.hpp"
 // I have to include the C++ files here due to a complication of node-gyp. Consider this the equivalent
 // of listing all the C++ sources in the makefile (Node-gyp seems to only work with 1 source rn).
 #include "../data/tetrominoes.cpp"
+#include "data_tables.cpp"
 #include "eval.cpp"
 #include "eval_context.cpp"
 #include "move_result.cpp"
 #include "move_search.cpp"
+#include "reachability_oracle.cpp"
 #include "piece_ranges.cpp"
+#include "request_scheduler.cpp"
 #include "playout.cpp"
 #include "high_level_search.cpp"
 #include "piece_rng.cpp"
+#include "position_book.cpp"
+#include "request_capture.cpp"
 // #include "../data/ranks_output.cpp"
+#if EMBED_DATA_TABLES
 #include "../data/ranks_base_7.cpp"
+#endif
 
 template<typename ... Args>
 std::string string_format( const std::string& format, Args ... args )
@@ -34,8 +49,117 @@ std::string string_format( const std::string& format, Args ... args )
     return std::string( buf.get(), buf.get() + size - 1 ); // We don't want the '\0' inside
 }
 
-std::string mainProcess(char const *inputStr, RequestType requestType) {
+/** Compiles the input schedule for a timeline, and the range contexts for the 4 possible gravity values. */
+void computeSharedRangeContexts(char const *inputFrameTimeline, OUT SharedRangeContexts &result) {
+  result.inputSchedule = compileInputFrameSchedule(inputFrameTimeline);
+  result.pieceRangeContextLookup[0] = getPieceRangeContext(&result.inputSchedule, 1, /* gravityDoubled= */ true);
+  result.pieceRangeContextLookup[1] = getPieceRangeContext(&result.inputSchedule, 1, /* gravityDoubled= */ false);
+  result.pieceRangeContextLookup[2] = getPieceRangeContext(&result.inputSchedule, 2, /* gravityDoubled= */ false);
+  result.pieceRangeContextLookup[3] = getPieceRangeContext(&result.inputSchedule, 3, /* gravityDoubled= */ false);
+}
+
+/** Range contexts keyed by input timeline, so that the positions in a batch only compute them once per timeline. */
+struct RangeContextCache {
+  std::mutex mutex;
+  std::map<std::string, std::unique_ptr<SharedRangeContexts>> contextsByTimeline;
+};
+
+const SharedRangeContexts *getSharedRangeContexts(RangeContextCache &cache, std::string const &inputFrameTimeline) {
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  std::unique_ptr<SharedRangeContexts> &cached = cache.contextsByTimeline[inputFrameTimeline];
+  if (cached == nullptr) {
+    cached.reset(new SharedRangeContexts());
+    computeSharedRangeContexts(inputFrameTimeline.c_str(), *cached);
+  }
+  return cached.get();
+}
+
+/** Caches shared by the requests in a batch or a game analysis. */
+struct RequestCaches {
+  RangeContextCache rangeContexts;
+  PlayoutCache playouts;
+};
+
+/** Parses a request argument that has to be a whole integer. @returns false if it isn't one */
+bool parseIntArg(std::string const &arg, OUT int &value) {
+  size_t firstDigit = !arg.empty() && arg[0] == '-' ? 1 : 0;
+  if (arg.length() <= firstDigit || arg.length() > 9) {
+    return false;
+  }
+  for (size_t i = firstDigit; i < arg.length(); i++) {
+    if (arg[i] < '0' || arg[i] > '9') {
+      return false;
+    }
+  }
+  value = atoi(arg.c_str());
+  return true;
+}
+
+/**
+ * Checks that an input has every argument that processRequest reads, in range, since the search indexes the piece list with
+ * them and can't recover from a bad one.
+ * @returns the error to send back, or "" if the input is valid
+ */
+std::string getRequestInputError(char const *inputStr, RequestType requestType) {
+  // Rate move requests have two boards
+  size_t numBoardChars = requestType == RATE_MOVE ? 402 : 201;
+  size_t inputLength = strlen(inputStr);
+  if (inputLength < numBoardChars || inputStr[200] != '|' || (requestType == RATE_MOVE && inputStr[401] != '|')) {
+    return "Error: the input should start with a 200 character board and a '|'";
+  }
+
+  std::vector<std::string> args;
+  size_t start = numBoardChars;
+  for (size_t end = start; end < inputLength; end++) {
+    if (inputStr[end] == '|') {
+      args.push_back(std::string(inputStr + start, end - start));
+      start = end + 1;
+    }
+  }
+  // level|lines|currentPiece|nextPiece|inputFrameTimeline|, optionally followed by playoutCount|playoutLength|pruningBreadth|
+  if (args.size() < 5) {
+    return "Error: expected at least 5 arguments after the board (level, lines, current piece, next piece and input timeline)";
+  }
+  int value;
+  if (!parseIntArg(args[0], value) || value < 0) {
+    return "Error: the level should be a non-negative integer";
+  }
+  if (!parseIntArg(args[1], value) || value < 0) {
+    return "Error: the lines should be a non-negative integer";
+  }
+  if (!parseIntArg(args[2], value) || value < 0 || value > 6) {
+    return "Error: please provide a value for currentPiece, from 0 to 6.";
+  }
+  if (!parseIntArg(args[3], value) || value < -1 || value > 6) {
+    return "Error: the next piece should be from -1 (none) to 6";
+  }
+  if (args[4].empty()) {
+    return "Error: the input timeline is empty";
+  }
+  for (size_t i = 5; i < args.size() && i < 8; i++) {
+    if (!parseIntArg(args[i], value) || value < 0) {
+      return "Error: the playout count, playout length and pruning breadth should be non-negative integers";
+    }
+  }
+  return "";
+}
+
+/** Processes one request. See mainProcess(). */
+std::string processRequest(char const *inputStr, RequestType requestType, const EvalWeightSet *weightSet, RequestCaches *requestCaches, const CancellationToken *cancellationToken, OUT LockLocation &chosenPlacement, OUT bool &wasBookHit) {
   maybePrint("Input string %s\n", inputStr);
+  TraceSpan requestSpan("mainProcess", requestType);
+  std::string inputError = getRequestInputError(inputStr, requestType);
+  if (!inputError.empty()) {
+    return inputError;
+  }
+
+  // Positions that recur across games may already be in the book
+  std::string bookResult;
+  if (USE_POSITION_BOOK && lookupPositionBook(requestType, inputStr, weightSet, bookResult, chosenPlacement)) {
+    wasBookHit = true;
+    return bookResult;
+  }
+  TraceSpan parseSpan("parse");
 
   // Init empty data structures
   GameState startingGameState = {
@@ -80,9 +204,6 @@ std::string mainProcess(char const *inputStr, RequestType requestType) {
       startingGameState.lines = argAsInt;
       break;
     case 2:
-      if (argAsInt == -1){
-        return "Error: please provide a value for currentPiece.";
-      }
       curPiece = &(PIECE_LIST[argAsInt]);
       break;
     case 3:
@@ -120,20 +241,26 @@ std::string mainProcess(char const *inputStr, RequestType requestType) {
   std::pair<int, float> result = updateSurfaceAndHoles(startingGameState.surfaceArray, startingGameState.board, wellColumn, /* isDigMode= */ false);
   startingGameState.numTrueHoles = result.first;
   startingGameState.numPartialHoles = result.second;
+  parseSpan.end();
 
   // Calculate global context for the 3 possible gravity values
-  const PieceRangeContext pieceRangeContextLookup[4] = {
-    getPieceRangeContext(inputFrameTimeline.c_str(), 1, /* gravityDoubled= */ true),
-    getPieceRangeContext(inputFrameTimeline.c_str(), 1, /* gravityDoubled= */ false),
-    getPieceRangeContext(inputFrameTimeline.c_str(), 2, /* gravityDoubled= */ false),
-    getPieceRangeContext(inputFrameTimeline.c_str(), 3, /* gravityDoubled= */ false),
-  };
-  const EvalContext context = getEvalContext(startingGameState, pieceRangeContextLookup);
+  TraceSpan contextSpan("evalContext");
+  SharedRangeContexts localRangeContexts;
+  const SharedRangeContexts *rangeContexts = &localRangeContexts;
+  if (requestCaches != NULL) {
+    rangeContexts = getSharedRangeContexts(requestCaches->rangeContexts, inputFrameTimeline);
+  } else {
+    computeSharedRangeContexts(inputFrameTimeline.c_str(), localRangeContexts);
+  }
+  const PieceRangeContext *pieceRangeContextLookup = rangeContexts->pieceRangeContextLookup;
+  EvalContext context = getEvalContext(startingGameState, pieceRangeContextLookup, weightSet);
+  context.cancellationToken = cancellationToken;
 
   // Recalculate holes once we have the eval context
   pair<int, float> result2 = updateSurfaceAndHoles(startingGameState.surfaceArray, startingGameState.board, context.countWellHoles ? -1 : context.wellColumn, context.aiMode == DIG);
   startingGameState.numTrueHoles = result2.first;
   startingGameState.numPartialHoles = result2.second;
+  contextSpan.end();
 
   if (LOGGING_ENABLED) {
     printBoard(startingGameState.board);
@@ -143,7 +270,15 @@ std::string mainProcess(char const *inputStr, RequestType requestType) {
   // Take the specified action on the input based on the request type
   switch (requestType) {
     case GET_LOCK_VALUE_LOOKUP: {
-      return getLockValueLookupEncoded(startingGameState, curPiece, nextPiece, pruningBreadth, playoutCount, playoutLength, &context, pieceRangeContextLookup);
+      return getLockValueLookupEncoded(startingGameState, curPiece, nextPiece, pruningBreadth, playoutCount, playoutLength, &context, pieceRangeContextLookup, &chosenPlacement);
+    }
+
+    case GET_LOCK_VALUE_LOOKUP_PACKED: {
+      return getLockValueLookupPacked(startingGameState, curPiece, nextPiece, pruningBreadth, playoutCount, playoutLength, &context, pieceRangeContextLookup, &chosenPlacement);
+    }
+
+    case GET_LOCK_VALUE_LOOKUP_ALL_NEXT_PIECES: {
+      return getLockValueLookupAllNextPieces(startingGameState, curPiece, pruningBreadth, playoutCount, playoutLength, &context, pieceRangeContextLookup);
     }
 
     case GET_TOP_MOVES: {
@@ -151,17 +286,17 @@ std::string mainProcess(char const *inputStr, RequestType requestType) {
     }
 
     case GET_TOP_MOVES_HYBRID: {
-      std::string nnbResult = getTopMoveList(startingGameState, curPiece, /* nextPiece= */ NULL, NUM_TOP_ENGINE_MOVES, playoutCount, playoutLength, &context, pieceRangeContextLookup);
-      std::string nbResult = getTopMoveList(startingGameState, curPiece, nextPiece, NUM_TOP_ENGINE_MOVES, playoutCount, playoutLength, &context, pieceRangeContextLookup);
-      return "{\"noNextBox\":" + nnbResult + ", \"nextBox\":" + nbResult + "}";
+      return getTopMovesHybrid(startingGameState, curPiece, nextPiece, NUM_TOP_ENGINE_MOVES, playoutCount, playoutLength, &context, pieceRangeContextLookup);
     }
 
     case RATE_MOVE: {
-      return rateMove(startingGameState, curPiece, nextPiece, secondBoard, pruningBreadth, playoutCount, playoutLength, &context, pieceRangeContextLookup);
+      PlayoutCache *playoutCache = requestCaches != NULL ? &requestCaches->playouts : NULL;
+      return rateMove(startingGameState, curPiece, nextPiece, secondBoard, pruningBreadth, playoutCount, playoutLength, &context, pieceRangeContextLookup, playoutCache);
     }
 
     case GET_MOVE: {
       LockLocation bestMove = playOneMove(startingGameState, curPiece, nextPiece, pruningBreadth, playoutCount, playoutLength, &context, pieceRangeContextLookup);
+      chosenPlacement = bestMove;
       int xOffset = bestMove.x - 3;
       int rot = bestMove.rotationIndex;
       int yOffset = bestMove.y - curPiece->initialY;
@@ -177,6 +312,101 @@ std::string mainProcess(char const *inputStr, RequestType requestType) {
   }
 }
 
+/**
+ * Processes one request.
+ * @param requestCaches - if non-NULL, range contexts and playout scores are looked up (and stored) here rather than computed for just this request.
+ * @param cancellationToken - if non-NULL, the search can be cut short through this token, in which case the result is CANCELLED_RESULT
+ * @param chosenPlacement - if non-NULL, set to where the search placed the current piece (for GET_MOVE and the single lock value
+ *                          lookups), or NULL_LOCK_LOCATION if it didn't choose one
+ */
+std::string mainProcess(char const *inputStr, RequestType requestType, const EvalWeightSet *weightSet = &DEFAULT_WEIGHT_SET, RequestCaches *requestCaches = NULL, const CancellationToken *cancellationToken = NULL, OUT LockLocation *chosenPlacement = NULL) {
+  // Requests with other weights (e.g. from the weight optimizer) couldn't be replayed, and speculative ones aren't real traffic
+  RequestCaptureScope capture(weightSet == &DEFAULT_WEIGHT_SET && currentRequestClass != SPECULATIVE_REQUEST);
+  LockLocation placement = NULL_LOCK_LOCATION;
+  bool wasBookHit = false;
+  std::string result = processRequest(inputStr, requestType, weightSet, requestCaches, cancellationToken, placement, wasBookHit);
+  if (chosenPlacement != NULL) {
+    *chosenPlacement = placement;
+  }
+  bool wasCancelled = isSearchCancelled(cancellationToken);
+  capture.finish(requestType, inputStr, result, wasCancelled, wasBookHit);
+  return wasCancelled ? CANCELLED_RESULT : result;
+}
+
+/**
+ * Processes many requests in one call, spread over BATCH_THREADS threads. Positions with the same input timeline share their range contexts.
+ * @param requestTypes - either one type per input, or a single type that applies to every input
+ * @param chosenPlacements - if non-NULL, filled in with the chosen placement for each input (see mainProcess)
+ * @returns the result for each input, in the same order as the inputs
+ */
+std::vector<std::string> mainProcessBatch(std::vector<std::string> const &inputStrs, std::vector<RequestType> const &requestTypes, const EvalWeightSet *weightSet = &DEFAULT_WEIGHT_SET, OUT std::vector<LockLocation> *chosenPlacements = NULL) {
+  TraceSpan batchSpan("mainProcessBatch", (int) inputStrs.size());
+  std::vector<std::string> results(inputStrs.size());
+  if (requestTypes.size() != 1 && requestTypes.size() != inputStrs.size()) {
+    printf("Batch has %d inputs but %d request types\n", (int) inputStrs.size(), (int) requestTypes.size());
+    return results;
+  }
+  if (chosenPlacements != NULL) {
+    chosenPlacements->assign(inputStrs.size(), NULL_LOCK_LOCATION);
+  }
+  RequestCaches requestCaches;
+  parallelFor((int) inputStrs.size(), BATCH_THREADS, [&](int i) {
+    RequestType requestType = requestTypes.size() == 1 ? requestTypes[0] : requestTypes[i];
+    LockLocation *chosenPlacement = chosenPlacements != NULL ? &(*chosenPlacements)[i] : NULL;
+    results[i] = mainProcess(inputStrs[i].c_str(), requestType, weightSet, &requestCaches, /* cancellationToken= */ NULL, chosenPlacement);
+  });
+  return results;
+}
+
+/**
+ * Rates every move of a game in one call.
+ * @param inputStr - one RATE_MOVE input string per move (the board before the move, the board after it, and the usual args), separated by newlines
+ * @returns a JSON array with the RATE_MOVE result for each move, or {"error": "..."} for moves that couldn't be rated
+ *
+ * The moves are rated in parallel, sharing playout scores. Consecutive moves overlap, since the 2-ply search from one position
+ * plays out some of the same states as the 1-ply search from the next (about a fifth of the playouts, in simulated level 18
+ * games), so each thread rates a contiguous run of moves in order. That way the shared states are already cached by the time
+ * the next move needs them, rather than being played out by two threads at once.
+ */
+std::string analyzeGame(char const *inputStr, const EvalWeightSet *weightSet = &DEFAULT_WEIGHT_SET) {
+  TraceSpan analysisSpan("analyzeGame");
+  std::vector<std::string> moveInputs;
+  std::string input(inputStr);
+  size_t start = 0;
+  while (start < input.length()) {
+    size_t end = input.find('\n', start);
+    if (end == std::string::npos) {
+      end = input.length();
+    }
+    if (end > start) {
+      moveInputs.push_back(input.substr(start, end - start));
+    }
+    start = end + 1;
+  }
+
+  std::vector<std::string> moveResults(moveInputs.size());
+  RequestCaches requestCaches;
+  int numMoves = (int) moveInputs.size();
+  int numRuns = std::max(1, std::min(numMoves, GAME_ANALYSIS_THREADS > 0 ? GAME_ANALYSIS_THREADS : getDefaultThreadCount()));
+  parallelFor(numRuns, numRuns, [&](int run) {
+    for (int i = run * numMoves / numRuns; i < (run + 1) * numMoves / numRuns; i++) {
+      moveResults[i] = mainProcess(moveInputs[i].c_str(), RATE_MOVE, weightSet, &requestCaches);
+    }
+  });
+
+  std::string output = "[";
+  for (size_t i = 0; i < moveResults.size(); i++) {
+    if (moveResults[i].rfind("Error", 0) == 0) {
+      output += "{\"error\":\"" + moveResults[i] + "\"}";
+    } else {
+      output += moveResults[i];
+    }
+    output += i + 1 < moveResults.size() ? "," : "";
+  }
+  output += "]";
+  return output;
+}
+
 // int main(){
 //   printf("Starting...\n");
 //   std::string result = mainProcess("0000000000000000000000000000000000000000000000000000000000000000001110000000111000000011110000"
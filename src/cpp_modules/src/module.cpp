@@ -1,6 +1,10 @@
 #include <nan.h>
+#include <signal.h>
 #include "main.cpp"
 #include "types.hpp"
+#ifndef _WIN32
+#include "shared_ring.cpp"
+#endif
 
 using namespace v8;
 
@@ -10,24 +14,132 @@ NAN_METHOD(GetLockValueLookup) {
   v8::Local<String> inputStrNan;
   if (maybeStr.ToLocal(&inputStrNan) == false) {
     Nan::ThrowError("Error converting first argument to string");
+    return;
   }
-  char const * inputStr = *Nan::Utf8String(inputStrNan);
+  Nan::Utf8String inputStrUtf8(inputStrNan); // Owns the string, so it has to outlive inputStr
+  char const * inputStr = *inputStrUtf8;
 
-  std::string result = mainProcess(inputStr, GET_LOCK_VALUE_LOOKUP);
+  CancellationToken cancellationToken;
+  std::string result = mainProcess(inputStr, GET_LOCK_VALUE_LOOKUP, &DEFAULT_WEIGHT_SET, /* requestCaches= */ NULL, &cancellationToken);
 
   info.GetReturnValue().Set(Nan::New<String>(result.c_str()).ToLocalChecked());
 }
 
+NAN_METHOD(GetLockValueLookupPacked) {
+  // Parse string arg
+  Nan::MaybeLocal<String> maybeStr = Nan::To<String>(info[0]);
+  v8::Local<String> inputStrNan;
+  if (maybeStr.ToLocal(&inputStrNan) == false) {
+    Nan::ThrowError("Error converting first argument to string");
+    return;
+  }
+  Nan::Utf8String inputStrUtf8(inputStrNan);
+  char const * inputStr = *inputStrUtf8;
+
+  CancellationToken cancellationToken;
+  std::string result = mainProcess(inputStr, GET_LOCK_VALUE_LOOKUP_PACKED, &DEFAULT_WEIGHT_SET, /* requestCaches= */ NULL, &cancellationToken);
+
+  // Return the binary result as a Buffer
+  info.GetReturnValue().Set(Nan::CopyBuffer(result.data(), (uint32_t) result.size()).ToLocalChecked());
+}
+
+NAN_METHOD(GetLockValueLookupAllNextPieces) {
+  // Parse string arg
+  Nan::MaybeLocal<String> maybeStr = Nan::To<String>(info[0]);
+  v8::Local<String> inputStrNan;
+  if (maybeStr.ToLocal(&inputStrNan) == false) {
+    Nan::ThrowError("Error converting first argument to string");
+    return;
+  }
+  Nan::Utf8String inputStrUtf8(inputStrNan);
+  char const * inputStr = *inputStrUtf8;
+
+  CancellationToken cancellationToken;
+  std::string result = mainProcess(inputStr, GET_LOCK_VALUE_LOOKUP_ALL_NEXT_PIECES, &DEFAULT_WEIGHT_SET, /* requestCaches= */ NULL, &cancellationToken);
+
+  info.GetReturnValue().Set(Nan::New<String>(result.c_str()).ToLocalChecked());
+}
+
+NAN_METHOD(LoadPositionBook) {
+  // Parse string arg
+  Nan::MaybeLocal<String> maybeStr = Nan::To<String>(info[0]);
+  v8::Local<String> pathNan;
+  if (maybeStr.ToLocal(&pathNan) == false) {
+    Nan::ThrowError("Error converting first argument to string");
+    return;
+  }
+  Nan::Utf8String path(pathNan);
+
+  bool didLoad = loadPositionBook(*path);
+
+  info.GetReturnValue().Set(Nan::New<v8::Boolean>(didLoad));
+}
+
+NAN_METHOD(AnalyzeGame) {
+  // Parse string arg
+  Nan::MaybeLocal<String> maybeStr = Nan::To<String>(info[0]);
+  v8::Local<String> inputStrNan;
+  if (maybeStr.ToLocal(&inputStrNan) == false) {
+    Nan::ThrowError("Error converting first argument to string");
+    return;
+  }
+  Nan::Utf8String inputStr(inputStrNan);
+
+  std::string result = analyzeGame(*inputStr);
+
+  info.GetReturnValue().Set(Nan::New<String>(result.c_str()).ToLocalChecked());
+}
+
+NAN_METHOD(EvaluateBatch) {
+  // Parse the array of input strings
+  if (!info[0]->IsArray()) {
+    Nan::ThrowError("First argument must be an array of input strings");
+    return;
+  }
+  v8::Local<v8::Array> inputArray = info[0].As<v8::Array>();
+  std::vector<std::string> inputStrs;
+  for (uint32_t i = 0; i < inputArray->Length(); i++) {
+    Nan::Utf8String inputStr(Nan::Get(inputArray, i).ToLocalChecked());
+    inputStrs.push_back(std::string(*inputStr));
+  }
+
+  // Parse the request types, which are either an array with one per input, or a single type for every input
+  std::vector<RequestType> requestTypes;
+  if (info[1]->IsArray()) {
+    v8::Local<v8::Array> typeArray = info[1].As<v8::Array>();
+    for (uint32_t i = 0; i < typeArray->Length(); i++) {
+      requestTypes.push_back((RequestType) Nan::To<int32_t>(Nan::Get(typeArray, i).ToLocalChecked()).FromJust());
+    }
+  } else {
+    requestTypes.push_back((RequestType) Nan::To<int32_t>(info[1]).FromJust());
+  }
+  if (requestTypes.size() != 1 && requestTypes.size() != inputStrs.size()) {
+    Nan::ThrowError("Expected one request type, or one per input string");
+    return;
+  }
+
+  std::vector<std::string> results = mainProcessBatch(inputStrs, requestTypes);
+
+  v8::Local<v8::Array> resultArray = Nan::New<v8::Array>((int) results.size());
+  for (uint32_t i = 0; i < results.size(); i++) {
+    Nan::Set(resultArray, i, Nan::New<String>(results[i]).ToLocalChecked());
+  }
+  info.GetReturnValue().Set(resultArray);
+}
+
 NAN_METHOD(GetMove) {
   // Parse string arg
   Nan::MaybeLocal<String> maybeStr = Nan::To<String>(info[0]);
   v8::Local<String> inputStrNan;
   if (maybeStr.ToLocal(&inputStrNan) == false) {
     Nan::ThrowError("Error converting first argument to string");
+    return;
   }
-  char const * inputStr = *Nan::Utf8String(inputStrNan);
+  Nan::Utf8String inputStrUtf8(inputStrNan);
+  char const * inputStr = *inputStrUtf8;
 
-  std::string result = mainProcess(inputStr, GET_MOVE);
+  CancellationToken cancellationToken;
+  std::string result = mainProcess(inputStr, GET_MOVE, &DEFAULT_WEIGHT_SET, /* requestCaches= */ NULL, &cancellationToken);
 
   info.GetReturnValue().Set(Nan::New<String>(result.c_str()).ToLocalChecked());
 }
@@ -38,10 +150,13 @@ NAN_METHOD(GetTopMoves) {
   v8::Local<String> inputStrNan;
   if (maybeStr.ToLocal(&inputStrNan) == false) {
     Nan::ThrowError("Error converting first argument to string");
+    return;
   }
-  char const * inputStr = *Nan::Utf8String(inputStrNan);
+  Nan::Utf8String inputStrUtf8(inputStrNan);
+  char const * inputStr = *inputStrUtf8;
 
-  std::string result = mainProcess(inputStr, GET_TOP_MOVES);
+  CancellationToken cancellationToken;
+  std::string result = mainProcess(inputStr, GET_TOP_MOVES, &DEFAULT_WEIGHT_SET, /* requestCaches= */ NULL, &cancellationToken);
 
   info.GetReturnValue().Set(Nan::New<String>(result.c_str()).ToLocalChecked());
 }
@@ -52,10 +167,13 @@ NAN_METHOD(GetTopMovesHybrid) {
   v8::Local<String> inputStrNan;
   if (maybeStr.ToLocal(&inputStrNan) == false) {
     Nan::ThrowError("Error converting first argument to string");
+    return;
   }
-  char const * inputStr = *Nan::Utf8String(inputStrNan);
+  Nan::Utf8String inputStrUtf8(inputStrNan);
+  char const * inputStr = *inputStrUtf8;
 
-  std::string result = mainProcess(inputStr, GET_TOP_MOVES_HYBRID);
+  CancellationToken cancellationToken;
+  std::string result = mainProcess(inputStr, GET_TOP_MOVES_HYBRID, &DEFAULT_WEIGHT_SET, /* requestCaches= */ NULL, &cancellationToken);
 
   info.GetReturnValue().Set(Nan::New<String>(result.c_str()).ToLocalChecked());
 }
@@ -66,17 +184,149 @@ NAN_METHOD(RateMove) {
   v8::Local<String> inputStrNan;
   if (maybeStr.ToLocal(&inputStrNan) == false) {
     Nan::ThrowError("Error converting first argument to string");
+    return;
+  }
+  Nan::Utf8String inputStrUtf8(inputStrNan);
+  char const * inputStr = *inputStrUtf8;
+
+  CancellationToken cancellationToken;
+  std::string result = mainProcess(inputStr, RATE_MOVE, &DEFAULT_WEIGHT_SET, /* requestCaches= */ NULL, &cancellationToken);
+
+  info.GetReturnValue().Set(Nan::New<String>(result.c_str()).ToLocalChecked());
+}
+
+NAN_METHOD(CancelAllSearches) {
+  cancelAllSearches();
+}
+
+void onCancelSignal(int) {
+  cancelAllSearches(); // Just an atomic increment, so it's safe in a signal handler
+}
+
+/**
+ * Lets another process (e.g. the precompute manager, for its worker processes) cancel the searches running in this one, by
+ * sending it SIGUSR2. A search blocks the process's event loop, so it can't be cancelled with a message.
+ * @returns false if the platform doesn't have SIGUSR2 (i.e. Windows)
+ */
+NAN_METHOD(EnableCancelSignal) {
+#ifdef SIGUSR2
+  signal(SIGUSR2, onCancelSignal);
+  info.GetReturnValue().Set(Nan::True());
+#else
+  info.GetReturnValue().Set(Nan::False());
+#endif
+}
+
+#ifndef _WIN32
+SharedRingFile *sharedRingFile = NULL; // Set by openSharedRing()
+
+/** Opens the shared ring file that an engine server created with --shm (see shared_ring.hpp). Throws if it can't. */
+NAN_METHOD(OpenSharedRing) {
+  if (info.Length() < 1 || !info[0]->IsString()) {
+    Nan::ThrowTypeError("Expected a shared ring file path");
+    return;
+  }
+  Nan::Utf8String path(info[0]);
+  std::string error;
+  SharedRingFile *file = openSharedRingFile(*path, error);
+  if (file == NULL) {
+    Nan::ThrowError(error.c_str());
+    return;
   }
-  char const * inputStr = *Nan::Utf8String(inputStrNan);
+  sharedRingFile = file;
+}
+
+/**
+ * Sends a request (or an ENGINE_CANCEL_REQUEST for one) to the engine server through the shared ring, without waiting for it.
+ * @returns false if the ring is full (or the input doesn't fit in a slot)
+ */
+NAN_METHOD(SubmitToSharedRing) {
+  if (sharedRingFile == NULL) {
+    Nan::ThrowError("No shared ring is open");
+    return;
+  }
+  if (info.Length() < 3 || !info[0]->IsNumber() || !info[1]->IsNumber() || !info[2]->IsString()) {
+    Nan::ThrowTypeError("Expected a request ID, a request type, and an input string");
+    return;
+  }
+  uint32_t requestId = Nan::To<uint32_t>(info[0]).FromJust();
+  uint32_t requestType = Nan::To<uint32_t>(info[1]).FromJust();
+  if (requestType > GET_LOCK_VALUE_LOOKUP_PACKED && requestType != ENGINE_CANCEL_REQUEST) {
+    Nan::ThrowRangeError("Unknown request type");
+    return;
+  }
+  Nan::Utf8String inputStr(info[2]);
+
+  EngineFrameHeader header = {requestId, (uint8_t) requestType, {0, 0, 0}};
+  bool didSubmit = tryPushSharedRing(sharedRingFile->requests, header, *inputStr, (uint32_t) inputStr.length());
 
-  std::string result = mainProcess(inputStr, RATE_MOVE);
+  info.GetReturnValue().Set(Nan::New<v8::Boolean>(didSubmit));
+}
+
+/** Takes every response waiting in the shared ring. @returns an array of [requestId, status, payload] */
+NAN_METHOD(PollSharedRing) {
+  if (sharedRingFile == NULL) {
+    Nan::ThrowError("No shared ring is open");
+    return;
+  }
+  v8::Local<v8::Array> responses = Nan::New<v8::Array>();
+  EngineFrameHeader header;
+  std::string payload;
+  for (uint32_t i = 0; tryPopSharedRing(sharedRingFile->responses, header, payload); i++) {
+    v8::Local<v8::Array> response = Nan::New<v8::Array>(3);
+    Nan::Set(response, 0, Nan::New<v8::Uint32>(header.requestId));
+    Nan::Set(response, 1, Nan::New<v8::Uint32>((uint32_t) header.typeOrStatus));
+    Nan::Set(response, 2, Nan::New<String>(payload).ToLocalChecked());
+    Nan::Set(responses, i, response);
+  }
+  info.GetReturnValue().Set(responses);
+}
+#endif
+
+NAN_METHOD(StartTrace) {
+  startTracing();
+}
+
+NAN_METHOD(StopTrace) {
+  // Optional string arg: a file path to also write the trace to
+  std::string outputPath;
+  if (info.Length() > 0 && info[0]->IsString()) {
+    outputPath = *Nan::Utf8String(info[0]);
+  }
+
+  std::string result = stopTracing(outputPath);
 
   info.GetReturnValue().Set(Nan::New<String>(result.c_str()).ToLocalChecked());
 }
 
+NAN_METHOD(StartRequestCapture) {
+  // Args: the log file path, and optionally whether to store each result in full (see request_capture.hpp)
+  if (info.Length() < 1 || !info[0]->IsString()) {
+    Nan::ThrowTypeError("Expected a capture file path");
+    return;
+  }
+  std::string path = *Nan::Utf8String(info[0]);
+  bool includeResults = info.Length() > 1 && Nan::To<bool>(info[1]).FromJust();
+  info.GetReturnValue().Set(Nan::New<v8::Boolean>(startRequestCapture(path, includeResults)));
+}
+
+NAN_METHOD(StopRequestCapture) {
+  stopRequestCapture();
+}
+
 NAN_MODULE_INIT(Init) {
   Nan::Set(target, Nan::New("getLockValueLookup").ToLocalChecked(),
            Nan::GetFunction(Nan::New<FunctionTemplate>(GetLockValueLookup)).ToLocalChecked());
+  Nan::Set(target, Nan::New("getLockValueLookupPacked").ToLocalChecked(),
+           Nan::GetFunction(Nan::New<FunctionTemplate>(GetLockValueLookupPacked)).ToLocalChecked());
+  Nan::Set(target, Nan::New("getLockValueLookupAllNextPieces").ToLocalChecked(),
+           Nan::GetFunction(Nan::New<FunctionTemplate>(GetLockValueLookupAllNextPieces)).ToLocalChecked());
+  Nan::Set(target, Nan::New("loadPositionBook").ToLocalChecked(),
+           Nan::GetFunction(Nan::New<FunctionTemplate>(LoadPositionBook)).ToLocalChecked());
+  Nan::Set(target, Nan::New("analyzeGame").ToLocalChecked(),
+           Nan::GetFunction(Nan::New<FunctionTemplate>(AnalyzeGame)).ToLocalChecked());
+  Nan::Set(target, Nan::New("evaluateBatch").ToLocalChecked(),
+           Nan::GetFunction(Nan::New<FunctionTemplate>(EvaluateBatch)).ToLocalChecked());
   Nan::Set(target, Nan::New("getMove").ToLocalChecked(),
            Nan::GetFunction(Nan::New<FunctionTemplate>(GetMove)).ToLocalChecked());
   Nan::Set(target, Nan::New("getTopMoves").ToLocalChecked(),
@@ -85,6 +335,26 @@ NAN_MODULE_INIT(Init) {
            Nan::GetFunction(Nan::New<FunctionTemplate>(GetTopMovesHybrid)).ToLocalChecked());
   Nan::Set(target, Nan::New("rateMove").ToLocalChecked(),
            Nan::GetFunction(Nan::New<FunctionTemplate>(RateMove)).ToLocalChecked());
+  Nan::Set(target, Nan::New("cancelAllSearches").ToLocalChecked(),
+           Nan::GetFunction(Nan::New<FunctionTemplate>(CancelAllSearches)).ToLocalChecked());
+  Nan::Set(target, Nan::New("enableCancelSignal").ToLocalChecked(),
+           Nan::GetFunction(Nan::New<FunctionTemplate>(EnableCancelSignal)).ToLocalChecked());
+#ifndef _WIN32
+  Nan::Set(target, Nan::New("openSharedRing").ToLocalChecked(),
+           Nan::GetFunction(Nan::New<FunctionTemplate>(OpenSharedRing)).ToLocalChecked());
+  Nan::Set(target, Nan::New("submitToSharedRing").ToLocalChecked(),
+           Nan::GetFunction(Nan::New<FunctionTemplate>(SubmitToSharedRing)).ToLocalChecked());
+  Nan::Set(target, Nan::New("pollSharedRing").ToLocalChecked(),
+           Nan::GetFunction(Nan::New<FunctionTemplate>(PollSharedRing)).ToLocalChecked());
+#endif
+  Nan::Set(target, Nan::New("startTrace").ToLocalChecked(),
+           Nan::GetFunction(Nan::New<FunctionTemplate>(StartTrace)).ToLocalChecked());
+  Nan::Set(target, Nan::New("stopTrace").ToLocalChecked(),
+           Nan::GetFunction(Nan::New<FunctionTemplate>(StopTrace)).ToLocalChecked());
+  Nan::Set(target, Nan::New("startRequestCapture").ToLocalChecked(),
+           Nan::GetFunction(Nan::New<FunctionTemplate>(StartRequestCapture)).ToLocalChecked());
+  Nan::Set(target, Nan::New("stopRequestCapture").ToLocalChecked(),
+           Nan::GetFunction(Nan::New<FunctionTemplate>(StopRequestCapture)).ToLocalChecked());
 }
 
 NODE_MODULE(myaddon, Init)
@@ -1,4 +1,5 @@
 #include "move_result.hpp"
+#include "board_kernels.hpp"
 #include <stdexcept>
 #include <utility>
 
@@ -265,13 +266,45 @@ std::pair<int, float> updateSurfaceAndHoles(int surfaceArray[10], unsigned int b
  * @returns the number of lines cleared
  */
 int getNewBoardAndLinesCleared(unsigned int board[20], LockPlacement lockPlacement, OUT unsigned int newBoard[20]) {
+  unsigned int const *pieceRows = lockPlacement.piece->rowsByRotation[lockPlacement.rotationIndex];
+  if (lockPlacement.y >= 0 && lockPlacement.y <= 16) {
+    // The piece is fully on the board, so its rows can be placed all at once
+    unsigned int newRows[4];
+    int fullRowMask = placePieceRows(board, pieceRows, lockPlacement.x, lockPlacement.y, newRows);
+    if (fullRowMask == 0) {
+      copyBoard(board, newBoard);
+      for (int i = 0; i < 4; i++) {
+        newBoard[lockPlacement.y + i] = newRows[i];
+      }
+      return 0;
+    }
+    // Compact the rows that weren't cleared, bottom to top
+    int numLinesCleared = 0;
+    for (int r = lockPlacement.y + 4; r < 20; r++) {
+      newBoard[r] = board[r];
+    }
+    for (int i = 3; i >= 0; i--) {
+      if (fullRowMask & (1 << i)) {
+        numLinesCleared++;
+        continue;
+      }
+      newBoard[lockPlacement.y + i + numLinesCleared] = newRows[i];
+    }
+    for (int r = lockPlacement.y - 1; r >= 0; r--) {
+      newBoard[r + numLinesCleared] = board[r];
+    }
+    for (int i = 0; i < numLinesCleared; i++) {
+      newBoard[i] = 0;
+    }
+    return numLinesCleared;
+  }
+
   int numLinesCleared = 0;
   // The rows below the piece are always the same
   for (int r = lockPlacement.y + 4; r < 20; r++) {
     newBoard[r] = board[r];
   }
   // Check the piece rows, bottom to top
-  unsigned int const *pieceRows = lockPlacement.piece->rowsByRotation[lockPlacement.rotationIndex];
   for (int i = 3; i >= 0; i--) {
     // Don't add any minos off the board
     if (lockPlacement.y + i < 0) {
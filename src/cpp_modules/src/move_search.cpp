@@ -1,13 +1,16 @@
 #include "move_search.hpp"
 #include "piece_ranges.hpp"
+#include "reachability_oracle.hpp"
 
 #include <algorithm>
+#include <bitset>
 #include <cmath>
 #include <stdio.h>
 #include <string.h>
 #include <unordered_set>
 #include <vector>
 #include "utils.hpp"
+#include "board_kernels.hpp"
 #include "types.hpp"
 using namespace std;
 
@@ -21,6 +24,9 @@ int collision(unsigned int board[20], const Piece *piece, int x, int y, int rotI
   if (X_BOUNDS_COLLISION_TABLE[piece->index][rotIndex][x + X_BOUNDS_COLLISION_TABLE_OFFSET]) {
     return 1;
   }
+  if (y >= 0 && y <= 16) {
+    return pieceRowsCollide(board, piece->rowsByRotation[rotIndex], x, y);
+  }
   for (int r = 0; r < 4; r++) {
     // Don't collide above ceiling
     if (y + r < 0) {
@@ -54,74 +60,106 @@ int rotateTowardsGoal(int curRotation, int goalRotation) {
   return MOD_4(curRotation + 1);
 }
 
+/**
+ * The exploration functions below are templated on the gravity and on the period of the input timeline, so that the common
+ * configurations (e.g. "X..." at level 18) get a copy where those are compile-time constants, and the frame math reduces to a few
+ * multiplies and shifts. A value of 0 means "not known at compile time", and uses the runtime arguments instead. The copies are
+ * only used when the search explores (adjustment searches, and spawn searches without a reachability oracle), and never on
+ * double killscreen. testSpecializedMoveSearch checks them against the generic copy.
+ */
+
+/**
+ * Applies the gravity of the frames from startFrame (inclusive) to endFrame (exclusive) to the piece.
+ * @returns false if the piece locked along the way
+ */
+template <int GRAVITY = 0>
+bool applyGravityBetweenFrames(unsigned int board[20], int startFrame, int endFrame, int gravity, bool gravityDoubled, SimState &simState) {
+  if (GRAVITY) {
+    gravity = GRAVITY;
+    gravityDoubled = false;
+  }
+  // There's a gravity frame every Nth frame (where N = gravity), so count how many multiples of N were crossed
+  int numGravityFrames = endFrame / gravity - startFrame / gravity;
+  int rowsToFall = numGravityFrames * (gravityDoubled ? 2 : 1);
+  for (int i = 0; i < rowsToFall; i++) {
+    if (collision(board, simState.piece, simState.x, simState.y + 1, simState.rotationIndex)) {
+      return false;
+    }
+    simState.y++;
+  }
+  return true;
+}
+
 /**
  * Explores how far in a given direction a piece can be shifted, and registers all the legal placements along
  * the way
  */
+template <int GRAVITY, int PERIOD>
 int exploreHorizontally(unsigned int board[20],
                         SimState simState,
                         int shiftIncrement,
                         int maxOrMinX,
                         int goalRotationIndex,
-                        char const *inputFrameTimeline,
+                        const InputFrameSchedule *inputSchedule,
                         int gravity,
                         bool gravityDoubled,
                         vector<SimState> &legalPlacements,
                         int availableTuckCols[40]) {
   int rangeCurrent = 0;
   debugPrint("Exploring horizontally, inc=%d maxmin=%d goalRot=%d\n", shiftIncrement, maxOrMinX, goalRotationIndex);
+  if (!PERIOD && inputSchedule->inputsPerPeriod == 0) {
+    return rangeCurrent; // The piece can never move
+  }
 
-  // Loop through hypothetical frames
+  // Step from one input frame to the next (nothing but gravity happens on the frames in between)
   while (simState.x != maxOrMinX || simState.rotationIndex != goalRotationIndex) {
-    int isInputFrame = shouldPerformInputsThisFrame(simState.arrIndex, inputFrameTimeline);
-    int isGravityFrame =
-      simState.frameIndex % gravity == gravity - 1;   // Returns true every Nth frame, where N = gravity
+    int framesUntilInput = PERIOD
+                           ? (PERIOD - simState.arrIndex % PERIOD) % PERIOD // The only input frame is the first of the loop
+                           : inputSchedule->framesUntilInput[simState.arrIndex % inputSchedule->period];
+    if (!applyGravityBetweenFrames<GRAVITY>(board, simState.frameIndex, simState.frameIndex + framesUntilInput, gravity, gravityDoubled, simState)) {
+      return rangeCurrent;
+    }
+    simState.frameIndex += framesUntilInput;
+    simState.arrIndex += framesUntilInput;
+
     // Event trackers to handle the ordering of a few edge cases (explained more below)
     int foundNewPlacementThisFrame = false;
     int didLockThisFrame = false;
 
-    if (isInputFrame) {
-      // Try shifting
-      if (simState.x != maxOrMinX) {
-        if (collision(
-              board, simState.piece, simState.x + shiftIncrement, simState.y, simState.rotationIndex)) {
-          debugPrint("Shift collision at xOff=%d\n", simState.x - INITIAL_X);
-          return rangeCurrent;
-        }
-        simState.x += shiftIncrement;
+    // Try shifting
+    if (simState.x != maxOrMinX) {
+      if (collision(
+            board, simState.piece, simState.x + shiftIncrement, simState.y, simState.rotationIndex)) {
+        debugPrint("Shift collision at xOff=%d\n", simState.x - INITIAL_X);
+        return rangeCurrent;
       }
+      simState.x += shiftIncrement;
+    }
 
-      // Try rotating
-      if (simState.rotationIndex != goalRotationIndex) {
-        int rotationAfter = rotateTowardsGoal(simState.rotationIndex, goalRotationIndex);
-        if (collision(board, simState.piece, simState.x, simState.y, rotationAfter)) {
-          if (MOVE_SEARCH_DEBUG_LOGGING){
-            printf("Rotation collision at x=%d, rot=%d\n", simState.x - INITIAL_X, rotationAfter);
-            // printBoardWithPiece(board, *(simState.piece), simState.x, simState.y, rotationAfter);
-          }
-          return rangeCurrent;
+    // Try rotating
+    if (simState.rotationIndex != goalRotationIndex) {
+      int rotationAfter = rotateTowardsGoal(simState.rotationIndex, goalRotationIndex);
+      if (collision(board, simState.piece, simState.x, simState.y, rotationAfter)) {
+        if (MOVE_SEARCH_DEBUG_LOGGING){
+          printf("Rotation collision at x=%d, rot=%d\n", simState.x - INITIAL_X, rotationAfter);
+          // printBoardWithPiece(board, *(simState.piece), simState.x, simState.y, rotationAfter);
         }
-        simState.rotationIndex = rotationAfter;
+        return rangeCurrent;
       }
+      simState.rotationIndex = rotationAfter;
+    }
 
-      // If both succeeded, extend the range
-      debugPrint("Extending range, current xOff= %d\n", simState.x - INITIAL_X);
-      rangeCurrent = simState.x;
-      // ...and register a new legal placement if we were in the goal rotation
-      if (simState.rotationIndex == goalRotationIndex) {
-        foundNewPlacementThisFrame = true;
-      }
+    // If both succeeded, extend the range
+    debugPrint("Extending range, current xOff= %d\n", simState.x - INITIAL_X);
+    rangeCurrent = simState.x;
+    // ...and register a new legal placement if we were in the goal rotation
+    if (simState.rotationIndex == goalRotationIndex) {
+      foundNewPlacementThisFrame = true;
     }
 
-    if (isGravityFrame) {
-      for (int i = 0; i < (gravityDoubled ? 2 : 1); i++){
-        if (collision(board, simState.piece, simState.x, simState.y + 1, simState.rotationIndex)) {
-          didLockThisFrame = true;
-          break;
-        } else {
-          simState.y++;
-        }
-      }
+    // Then the gravity of the input frame itself
+    if (!applyGravityBetweenFrames<GRAVITY>(board, simState.frameIndex, simState.frameIndex + 1, gravity, gravityDoubled, simState)) {
+      didLockThisFrame = true;
     }
 
     simState.frameIndex++;
@@ -159,10 +197,11 @@ int exploreHorizontally(unsigned int board[20],
  * Explores for moves with more rotations than shifts (the only blind spot of the default exploration
  * behavior).
  */
+template <int GRAVITY, int PERIOD>
 void explorePlacementsNearSpawn(unsigned int board[20],
                                 SimState simState,
                                 int goalRotationIndex,
-                                char const *inputFrameTimeline,
+                                const InputFrameSchedule *inputSchedule,
                                 int gravity,
                                 bool gravityDoubled,
                                 vector<SimState> &legalPlacements,
@@ -175,16 +214,16 @@ void explorePlacementsNearSpawn(unsigned int board[20],
 
   for (int xOffset = rangeStart; xOffset <= rangeEnd; xOffset++) {
     // Check if the placement is legal.
-    exploreHorizontally(board,
-                        simState,
-                        xOffset,
-                        simState.x + xOffset,
-                        goalRotationIndex,
-                        inputFrameTimeline,
-                        gravity,
-                        gravityDoubled,
-                        legalPlacements,
-                        availableTuckCols);
+    exploreHorizontally<GRAVITY, PERIOD>(board,
+                                         simState,
+                                         xOffset,
+                                         simState.x + xOffset,
+                                         goalRotationIndex,
+                                         inputSchedule,
+                                         gravity,
+                                         gravityDoubled,
+                                         legalPlacements,
+                                         availableTuckCols);
   }
 }
 
@@ -294,6 +333,7 @@ char findTuckInput(unsigned int board[20],
    overhang cells and trying all the ways that the piece could possibly fill that cell. Each piece has a
    precomputed list of the possible ways it can fill a tuck cell (defined in tetrominoes.h), which drastically
    reduces the number of placements to try each time.
+   This is the reference implementation of findTucksBitParallel (see testBitParallelTucks).
  */
 void findTucks(unsigned int board[20],
                const Piece *piece,
@@ -341,23 +381,164 @@ void findTucks(unsigned int board[20],
   }
 }
 
+#define MAX_BUFFERED_TUCKS 64
+
+/** For one tuck origin spot, the minos of the piece relative to the overhang cell it's anchored to. */
+struct TuckSpotMinos {
+  int numMinos;
+  int rowOffset[4]; // The mino's row, relative to the piece's y
+  int anchorShift[4]; // Shifting a board row right by this lines its cells up with the anchor columns the mino would hit
+  unsigned int inBoundsAnchors; // The anchor columns (in board row bit order) for which the piece is within the walls
+};
+
+typedef array<array<TuckSpotMinos, MAX_TUCK_SPOTS>, 7> tuckSpotMinosTable;
+
+tuckSpotMinosTable getTuckSpotMinosTable() {
+  tuckSpotMinosTable table = {};
+  for (int p = 0; p < 7; p++) {
+    for (int i = 0; i < TUCK_SPOTS_FLAT.numSpots[p]; i++) {
+      TuckOriginSpot spot = TUCK_SPOTS_FLAT.spots[p][i];
+      TuckSpotMinos &minos = table[p][i];
+      for (int r = 0; r < 4; r++) {
+        for (int c = 0; c < 4; c++) {
+          if (PIECE_LIST[p].rowsByRotation[spot.orientation][r] & (1U << (9 - c))) {
+            minos.rowOffset[minos.numMinos] = r;
+            // Anchor column X puts this mino in board column X - spot.x + c, and board column N is bit 9 - N
+            minos.anchorShift[minos.numMinos] = spot.x - c;
+            minos.numMinos++;
+          }
+        }
+      }
+      // Same as the X_BOUNDS_COLLISION_TABLE check (which isn't initialized yet at this point)
+      for (int anchorX = 0; anchorX < 10; anchorX++) {
+        int pieceX = anchorX - spot.x;
+        bool isInBounds = pieceX <= 8; // Every piece overhangs the right wall by then
+        for (int r = 0; r < 4; r++) {
+          unsigned int pieceRow = PIECE_LIST[p].rowsByRotation[spot.orientation][r];
+          if (SHIFTBY(pieceRow, pieceX) >= 1024 || (SHIFTBY(pieceRow, pieceX - 1) & 1)) {
+            isInBounds = false;
+          }
+        }
+        if (isInBounds) {
+          minos.inBoundsAnchors |= 1U << (9 - anchorX);
+        }
+      }
+    }
+  }
+  return table;
+}
+
+const tuckSpotMinosTable TUCK_SPOT_MINOS = getTuckSpotMinosTable();
+
+/**
+ * Finds the same tucks as findTucks, in the same order, but tests every overhang cell in a row at once.
+ * For each origin spot, the overhang cells that the piece could be anchored to without colliding are found by masking
+ * the row's overhang bits with the in-bounds columns and with each mino's row of the board (shifted to line up with the
+ * anchor). Only the surviving (cell, spot) pairs get gravity-dropped and checked for a tuck input.
+ */
+void findTucksBitParallel(unsigned int board[20],
+                          const Piece *piece,
+                          int availableTuckCols[40],
+                          int minTuckYValsByNumPrevInputs[7],
+                          OUT std::vector<LockPlacement> &lockPlacements) {
+  const int numSpots = TUCK_SPOTS_FLAT.numSpots[piece->index];
+  const TuckOriginSpot *spots = TUCK_SPOTS_FLAT.spots[piece->index];
+  const array<TuckSpotMinos, MAX_TUCK_SPOTS> &spotMinos = TUCK_SPOT_MINOS[piece->index];
+  // Lock positions that already have a tuck, indexed by (y + 4) * 64 + (x + 4) * 4 + rotation
+  std::bitset<24 * 64> tuckLockSpots;
+  LockPlacement tuckBuffer[MAX_BUFFERED_TUCKS];
+  int numBuffered = 0;
+
+  for (int overhangY = 0; overhangY < 20; overhangY++) {
+    unsigned int overhangBits = (board[overhangY] & ALL_TUCK_SETUP_BITS) >> 20; // Same bit order as the board's cells
+    if (overhangBits == 0) {
+      continue;
+    }
+    // Find which overhang cells each spot fits into
+    unsigned int fitsBySpot[MAX_TUCK_SPOTS];
+    unsigned int fitsAnySpot = 0;
+    for (int i = 0; i < numSpots; i++) {
+      int postTuckPieceY = overhangY - spots[i].y;
+      if (postTuckPieceY > piece->maxYByRotation[spots[i].orientation]) {
+        fitsBySpot[i] = 0;
+        continue;
+      }
+      unsigned int blockedAnchors = 0;
+      for (int m = 0; m < spotMinos[i].numMinos; m++) {
+        int row = postTuckPieceY + spotMinos[i].rowOffset[m];
+        if (row < 0) {
+          continue; // Don't collide above ceiling
+        }
+        blockedAnchors |= SHIFTBY((board[row] & FULL_ROW), spotMinos[i].anchorShift[m]);
+      }
+      fitsBySpot[i] = overhangBits & spotMinos[i].inBoundsAnchors & ~blockedAnchors;
+      fitsAnySpot |= fitsBySpot[i];
+    }
+
+    // Visit the cells left to right, and the spots in list order, to match findTucks
+    while (fitsAnySpot) {
+      int anchorBit = 31 - __builtin_clz(fitsAnySpot);
+      fitsAnySpot &= ~(1U << anchorBit);
+      int overhangX = 9 - anchorBit;
+      for (int i = 0; i < numSpots; i++) {
+        if (!(fitsBySpot[i] & (1U << anchorBit))) {
+          continue;
+        }
+        int pieceX = overhangX - spots[i].x;
+        int postTuckPieceY = overhangY - spots[i].y;
+        int lockPieceY = postTuckPieceY;
+        while (!collision(board, piece, pieceX, lockPieceY + 1, spots[i].orientation)) {
+          lockPieceY++;
+        }
+        int lockPositionIndex = (lockPieceY + 4) * 64 + (pieceX + 4) * 4 + spots[i].orientation;
+        if (tuckLockSpots[lockPositionIndex]) {
+          continue;
+        }
+        char c = findTuckInput(board,
+                               {pieceX, postTuckPieceY, spots[i].orientation, -1, -1, piece},
+                               availableTuckCols,
+                               minTuckYValsByNumPrevInputs);
+        if (c != NO_TUCK_NOTATION) {
+          if (numBuffered == MAX_BUFFERED_TUCKS) {
+            lockPlacements.insert(lockPlacements.end(), tuckBuffer, tuckBuffer + numBuffered);
+            numBuffered = 0;
+          }
+          tuckBuffer[numBuffered++] = {pieceX, lockPieceY, spots[i].orientation, -1, c, piece};
+          tuckLockSpots[lockPositionIndex] = true;
+        }
+      }
+    }
+  }
+  lockPlacements.insert(lockPlacements.end(), tuckBuffer, tuckBuffer + numBuffered);
+}
+
 /**
  * Main move search implementation.
  * Wrapped in two parent functions depending on whether the move search is from standard spawn or from a midair adjustment spot.
+ * @param reachabilityOracle - precomputed paths from spawn, or NULL when searching from elsewhere
  */
+template <int GRAVITY, int PERIOD>
 int moveSearchInternal(GameState gameState,
                        SimState spawnState,
                        const Piece *piece,
-                       char const *inputFrameTimeline,
+                       const InputFrameSchedule *inputSchedule,
+                       const ReachabilityOracle *reachabilityOracle,
                        OUT std::vector<LockPlacement> &lockPlacements) {
   vector<SimState> legalMidairPlacements;
-  int gravity = getGravity(gameState.level);
-  bool gravityDoubled = isGravityDoubled(gameState.level);
+  int gravity = GRAVITY ? GRAVITY : getGravity(gameState.level);
+  bool gravityDoubled = GRAVITY ? false : isGravityDoubled(gameState.level);
 
   // Encodes which rotation/column pairs are reachable, and stores the lowest Y value reached in that pair
   int availableTuckCols[40] = {};
   int minTuckYValsByNumPrevInputs[7] = {};
-  computeYValueOfEachShift(inputFrameTimeline, gravity, gravityDoubled, piece->initialY, minTuckYValsByNumPrevInputs);
+  computeYValueOfEachShift(inputSchedule, gravity, gravityDoubled, piece->initialY, minTuckYValsByNumPrevInputs);
+
+  // The oracle's paths only need checking against the board once they reach the highest filled row
+  int topRow = 0;
+  while (topRow < 20 && (gameState.board[topRow] & FULL_ROW) == 0) {
+    topRow++;
+  }
+  int gravityIndex = gravityDoubled ? 0 : gravity;
 
   for (int goalRotIndex = 0; goalRotIndex < 4; goalRotIndex++) {
     if (piece->rowsByRotation[goalRotIndex][0] == NONE) {
@@ -379,36 +560,47 @@ int moveSearchInternal(GameState gameState,
       legalMidairPlacements.push_back(spawnState);
     }
 
+    if (reachabilityOracle != NULL) {
+      // Replay the same explorations as below, from their precomputed paths
+      replayReachabilityTrace(gameState.board, topRow, reachabilityOracle, gravityIndex, piece, goalRotIndex, EXPLORE_LEFT, legalMidairPlacements);
+      replayReachabilityTrace(gameState.board, topRow, reachabilityOracle, gravityIndex, piece, goalRotIndex, EXPLORE_RIGHT, legalMidairPlacements);
+      int rotationDifference = abs(goalRotIndex - spawnState.rotationIndex);
+      for (int xOffset = rotationDifference == 2 ? -1 : 0; xOffset <= (rotationDifference == 2 ? 1 : 0); xOffset++) {
+        replayReachabilityTrace(gameState.board, topRow, reachabilityOracle, gravityIndex, piece, goalRotIndex, EXPLORE_NEAR_SPAWN(xOffset), legalMidairPlacements);
+      }
+      continue;
+    }
+
     // Search for placements as far as possible to both sides
-    exploreHorizontally(gameState.board,
-                        spawnState,
-                        -1,
-                        -99,
-                        goalRotIndex,
-                        inputFrameTimeline,
-                        gravity,
-                        gravityDoubled,
-                        legalMidairPlacements,
-                        availableTuckCols);
-    exploreHorizontally(gameState.board,
-                        spawnState,
-                        1,
-                        99,
-                        goalRotIndex,
-                        inputFrameTimeline,
-                        gravity,
-                        gravityDoubled,
-                        legalMidairPlacements,
-                        availableTuckCols);
+    exploreHorizontally<GRAVITY, PERIOD>(gameState.board,
+                                         spawnState,
+                                         -1,
+                                         -99,
+                                         goalRotIndex,
+                                         inputSchedule,
+                                         gravity,
+                                         gravityDoubled,
+                                         legalMidairPlacements,
+                                         availableTuckCols);
+    exploreHorizontally<GRAVITY, PERIOD>(gameState.board,
+                                         spawnState,
+                                         1,
+                                         99,
+                                         goalRotIndex,
+                                         inputSchedule,
+                                         gravity,
+                                         gravityDoubled,
+                                         legalMidairPlacements,
+                                         availableTuckCols);
     // Then double check for some we missed near spawn
-    explorePlacementsNearSpawn(gameState.board,
-                               spawnState,
-                               goalRotIndex,
-                               inputFrameTimeline,
-                               gravity,
-                               gravityDoubled,
-                               legalMidairPlacements,
-                               availableTuckCols);
+    explorePlacementsNearSpawn<GRAVITY, PERIOD>(gameState.board,
+                                                spawnState,
+                                                goalRotIndex,
+                                                inputSchedule,
+                                                gravity,
+                                                gravityDoubled,
+                                                legalMidairPlacements,
+                                                availableTuckCols);
   }
 
   // Let the pieces fall until they lock
@@ -417,23 +609,72 @@ int moveSearchInternal(GameState gameState,
 
   // Search for tucks
   if (CAN_TUCK) {
-    findTucks(gameState.board, piece, availableTuckCols, minTuckYValsByNumPrevInputs, lockPlacements);
+    if (USE_BIT_PARALLEL_TUCKS) {
+      findTucksBitParallel(gameState.board, piece, availableTuckCols, minTuckYValsByNumPrevInputs, lockPlacements);
+    } else {
+      findTucks(gameState.board, piece, availableTuckCols, minTuckYValsByNumPrevInputs, lockPlacements);
+    }
   }
 
   return (int)lockPlacements.size();
 }
 
+template <int GRAVITY>
+int moveSearchForGravity(GameState gameState,
+                         SimState spawnState,
+                         const Piece *piece,
+                         const InputFrameSchedule *inputSchedule,
+                         OUT std::vector<LockPlacement> &lockPlacements) {
+  switch (inputSchedule->singleInputPeriod) {
+    case 2:
+      return moveSearchInternal<GRAVITY, 2>(gameState, spawnState, piece, inputSchedule, /* reachabilityOracle= */ NULL, lockPlacements);
+    case 3:
+      return moveSearchInternal<GRAVITY, 3>(gameState, spawnState, piece, inputSchedule, /* reachabilityOracle= */ NULL, lockPlacements);
+    case 4:
+      return moveSearchInternal<GRAVITY, 4>(gameState, spawnState, piece, inputSchedule, /* reachabilityOracle= */ NULL, lockPlacements);
+    case 5:
+      return moveSearchInternal<GRAVITY, 5>(gameState, spawnState, piece, inputSchedule, /* reachabilityOracle= */ NULL, lockPlacements);
+    default:
+      return moveSearchInternal<GRAVITY, 0>(gameState, spawnState, piece, inputSchedule, /* reachabilityOracle= */ NULL, lockPlacements);
+  }
+}
+
+/**
+ * Picks the move search specialized for the current gravity and timeline, falling back to the generic one. Searches with an oracle
+ * replay its paths instead of exploring, so they always use the generic one.
+ */
+int moveSearchDispatch(GameState gameState,
+                       SimState spawnState,
+                       const Piece *piece,
+                       const InputFrameSchedule *inputSchedule,
+                       const ReachabilityOracle *reachabilityOracle,
+                       OUT std::vector<LockPlacement> &lockPlacements) {
+  if (!USE_SPECIALIZED_MOVE_SEARCH || reachabilityOracle != NULL || isGravityDoubled(gameState.level)) {
+    return moveSearchInternal<0, 0>(gameState, spawnState, piece, inputSchedule, reachabilityOracle, lockPlacements);
+  }
+  switch (getGravity(gameState.level)) {
+    case 1:
+      return moveSearchForGravity<1>(gameState, spawnState, piece, inputSchedule, lockPlacements);
+    case 2:
+      return moveSearchForGravity<2>(gameState, spawnState, piece, inputSchedule, lockPlacements);
+    case 3:
+      return moveSearchForGravity<3>(gameState, spawnState, piece, inputSchedule, lockPlacements);
+    default:
+      return moveSearchInternal<0, 0>(gameState, spawnState, piece, inputSchedule, /* reachabilityOracle= */ NULL, lockPlacements);
+  }
+}
+
 int moveSearch(GameState gameState,
                const Piece *piece,
-               char const *inputFrameTimeline,
+               const InputFrameSchedule *inputSchedule,
                OUT std::vector<LockPlacement> &lockPlacements) {
   SimState spawnState = {INITIAL_X, piece->initialY, /* rotationIndex= */ 0, /* frameIndex= */ 0, /* arrIndex= */ 0, piece};
-  return moveSearchInternal(gameState, spawnState, piece, inputFrameTimeline, lockPlacements);
+  return moveSearchDispatch(gameState, spawnState, piece, inputSchedule, inputSchedule->reachabilityOracle, lockPlacements);
 }
 
 int adjustmentSearch(GameState gameState,
                      const Piece *piece,
-                     char const *inputFrameTimeline,
+                     const InputFrameSchedule *inputSchedule,
                      int existingXOffset,
                      int existingYOffset,
                      int existingRotation,
@@ -441,7 +682,7 @@ int adjustmentSearch(GameState gameState,
                      int arrWasReset,
                      OUT std::vector<LockPlacement> &lockPlacements){
   SimState startState = {INITIAL_X + existingXOffset, piece->initialY + existingYOffset, existingRotation, framesAlreadyElapsed, /* arrIndex= */ arrWasReset ? 0 : framesAlreadyElapsed, piece};
-  return moveSearchInternal(gameState, startState, piece, inputFrameTimeline, lockPlacements);
+  return moveSearchDispatch(gameState, startState, piece, inputSchedule, /* reachabilityOracle= */ NULL, lockPlacements);
 }
 
 /* ----------- TESTS ----------- */
@@ -472,6 +713,108 @@ void testTuckSpots() {
   }
 }
 
+/**
+ * Differential test of findTucksBitParallel against the reference findTucks, on random boards with random overhang cells.
+ * @returns the number of boards where the two disagreed
+ */
+int testBitParallelTucks(int numBoards) {
+  int numMismatches = 0;
+  FastRandom rng = {12345};
+  for (int i = 0; i < numBoards; i++) {
+    unsigned int board[20] = {};
+    int stackHeight = fastRandomInRange(rng, 0, 20);
+    for (int r = 20 - stackHeight; r < 20; r++) {
+      board[r] = (unsigned int) nextRandom(rng) & FULL_ROW;
+      board[r] |= ((unsigned int) nextRandom(rng) & ~board[r] & FULL_ROW) << 20; // Overhang markers on some of the empty cells
+    }
+    // Allow tucks from anywhere, so that findTuckInput's checks are exercised too
+    int availableTuckCols[40];
+    for (int c = 0; c < 40; c++) {
+      availableTuckCols[c] = 20;
+    }
+    int minTuckYValsByNumPrevInputs[7] = {};
+
+    const Piece *piece = &PIECE_LIST[i % 7];
+    std::vector<LockPlacement> expected;
+    std::vector<LockPlacement> actual;
+    findTucks(board, piece, availableTuckCols, minTuckYValsByNumPrevInputs, expected);
+    findTucksBitParallel(board, piece, availableTuckCols, minTuckYValsByNumPrevInputs, actual);
+
+    bool matches = expected.size() == actual.size();
+    for (int j = 0; matches && j < (int) expected.size(); j++) {
+      matches = expected[j].x == actual[j].x
+                && expected[j].y == actual[j].y
+                && expected[j].rotationIndex == actual[j].rotationIndex
+                && expected[j].tuckInput == actual[j].tuckInput;
+    }
+    if (!matches) {
+      numMismatches++;
+      if (MOVE_SEARCH_DEBUG_LOGGING) {
+        printf("Tuck mismatch on piece %c: expected %d, got %d\n", piece->id, (int) expected.size(), (int) actual.size());
+        printBoard(board);
+      }
+    }
+  }
+  printf("Bit-parallel tucks: %d mismatches in %d boards\n", numMismatches, numBoards);
+  return numMismatches;
+}
+
+/**
+ * Differential test of the move search copies specialized on gravity and timeline against the generic copy, from random states
+ * on random boards, at each gravity and with each specialized timeline (and one that isn't specialized).
+ * @returns the number of searches where the two disagreed
+ */
+int testSpecializedMoveSearch(int numSearches) {
+  const char *timelines[] = {"X.", "X..", "X...", "X....", "X....X..."};
+  const int levels[] = {18, 19, 29};
+  int numMismatches = 0;
+  FastRandom rng = {54321};
+  for (int i = 0; i < numSearches; i++) {
+    GameState gameState = {};
+    int stackHeight = fastRandomInRange(rng, 0, 14);
+    for (int r = 20 - stackHeight; r < 20; r++) {
+      gameState.board[r] = (unsigned int) nextRandom(rng) & FULL_ROW;
+    }
+    getSurfaceArray(gameState.board, gameState.surfaceArray);
+    gameState.level = levels[i % 3];
+    const InputFrameSchedule inputSchedule = compileInputFrameSchedule(timelines[(i / 3) % 5]);
+
+    // From spawn, or from partway through the piece's fall as in an adjustment
+    const Piece *piece = &PIECE_LIST[fastRandomInRange(rng, 0, 7)];
+    SimState startState = {INITIAL_X, piece->initialY, /* rotationIndex= */ 0, /* frameIndex= */ 0, /* arrIndex= */ 0, piece};
+    if (i % 2 == 1) {
+      startState.x += fastRandomInRange(rng, -2, 3);
+      startState.y += fastRandomInRange(rng, 0, 6);
+      startState.rotationIndex = piece->index == 1 ? 0 : fastRandomInRange(rng, 0, piece->index == 0 || piece->index >= 5 ? 2 : 4);
+      startState.frameIndex = fastRandomInRange(rng, 0, 24);
+      startState.arrIndex = fastRandomInRange(rng, 0, 2) ? 0 : startState.frameIndex;
+    }
+
+    std::vector<LockPlacement> expected;
+    std::vector<LockPlacement> actual;
+    moveSearchInternal<0, 0>(gameState, startState, piece, &inputSchedule, /* reachabilityOracle= */ NULL, expected);
+    moveSearchDispatch(gameState, startState, piece, &inputSchedule, /* reachabilityOracle= */ NULL, actual);
+
+    bool matches = expected.size() == actual.size();
+    for (int j = 0; matches && j < (int) expected.size(); j++) {
+      matches = expected[j].x == actual[j].x
+                && expected[j].y == actual[j].y
+                && expected[j].rotationIndex == actual[j].rotationIndex
+                && expected[j].tuckFrame == actual[j].tuckFrame
+                && expected[j].tuckInput == actual[j].tuckInput;
+    }
+    if (!matches) {
+      numMismatches++;
+      if (MOVE_SEARCH_DEBUG_LOGGING) {
+        printf("Specialized move search mismatch on piece %c: expected %d, got %d\n", piece->id, (int) expected.size(), (int) actual.size());
+        printBoard(gameState.board);
+      }
+    }
+  }
+  printf("Specialized move search: %d mismatches in %d searches\n", numMismatches, numSearches);
+  return numMismatches;
+}
+
 /** A generated set of test cases for use in fuzz testing against the original Node.js movesearch. */
 int testCases[50][4] = {
   { -5, 10, 3, 41 }, { -2, 5, 0, 23 },  { -1, 1, 2, 6 },
@@ -515,7 +858,8 @@ int testAdjustmentSearch(int testCase[4]){
   }
 
   std::vector<LockPlacement> lockPlacements;
-  int adjCount = adjustmentSearch(gameState, &PIECE_T, "X...", xOffset, yOffset, rotation, framesElapsed, arrReset, lockPlacements);
+  const InputFrameSchedule inputSchedule = compileInputFrameSchedule("X...");
+  int adjCount = adjustmentSearch(gameState, &PIECE_T, &inputSchedule, xOffset, yOffset, rotation, framesElapsed, arrReset, lockPlacements);
   if (MOVE_SEARCH_DEBUG_LOGGING) {
     for (auto state : lockPlacements) {
       if (MOVE_SEARCH_DEBUG_LOGGING) {
@@ -5,11 +5,11 @@
 #include "utils.hpp"
 #include <vector>
 
-int moveSearch(GameState gameState, const Piece *piece, char const *inputFrameTimeline, OUT std::vector<LockPlacement> &lockPlacements, OUT int availableTuckCols[40]);
+int moveSearch(GameState gameState, const Piece *piece, const InputFrameSchedule *inputSchedule, OUT std::vector<LockPlacement> &lockPlacements);
 
 int adjustmentSearch(GameState gameState,
                      const Piece *piece,
-                     char const *inputFrameTimeline,
+                     const InputFrameSchedule *inputSchedule,
                      int existingXOffset,
                      int existingYOffset,
                      int existingRotation,
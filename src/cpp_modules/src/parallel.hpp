@@ -0,0 +1,62 @@
+#ifndef PARALLEL
+#define PARALLEL
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+/** Set on threads that are already running inside a parallelFor, so that nested calls don't oversubscribe the cores. */
+thread_local bool isInsideParallelFor = false;
+
+/** The number of threads to use when the caller doesn't specify one. */
+int getDefaultThreadCount() {
+  int numCores = (int) std::thread::hardware_concurrency();
+  return numCores > 0 ? numCores : 1;
+}
+
+/**
+ * Calls itemFunc(i) for every i in [0, numItems), spread over up to numThreads threads (0 = one per core).
+ * Items are handed out one at a time, so a few slow items (e.g. very long games) don't leave the other threads idle.
+ * The calling thread does work too, and the call returns once every item is complete.
+ */
+template <typename ItemFunc>
+void parallelFor(int numItems, int numThreads, ItemFunc itemFunc) {
+  if (numThreads <= 0) {
+    numThreads = getDefaultThreadCount();
+  }
+  if (isInsideParallelFor) {
+    numThreads = 1;
+  }
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+  numThreads = 1; // WASM builds without pthreads can't start threads
+#endif
+  numThreads = std::min(numThreads, numItems);
+  if (numThreads <= 1) {
+    for (int i = 0; i < numItems; i++) {
+      itemFunc(i);
+    }
+    return;
+  }
+
+  std::atomic<int> nextItem(0);
+  auto workerLoop = [&]() {
+    bool wasInside = isInsideParallelFor;
+    isInsideParallelFor = true;
+    for (int i = nextItem++; i < numItems; i = nextItem++) {
+      itemFunc(i);
+    }
+    isInsideParallelFor = wasInside;
+  };
+
+  std::vector<std::thread> workers;
+  for (int t = 1; t < numThreads; t++) {
+    workers.emplace_back(workerLoop);
+  }
+  workerLoop();
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+}
+
+#endif
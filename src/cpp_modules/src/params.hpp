@@ -19,7 +19,7 @@ const FastEvalWeights MAIN_WEIGHTS = {
   /* tetrisCoef= */ 50,
   /* tetrisReadyCoef= */ 6,
   /* surfaceCoef= */ 1,
-  /* surfaceLeft= */ 0,
+  /* surfaceLeftCoef= */ 0,
   /* unableToBurnCoef= */ -0.5
 };
 
@@ -39,7 +39,7 @@ const FastEvalWeights PLAY_PERFECT_WEIGHTS = {
   /* tetrisCoef= */ 0,
   /* tetrisReadyCoef= */ 0,
   /* surfaceCoef= */ 0,
-  /* surfaceLeft= */ 0,
+  /* surfaceLeftCoef= */ 0,
   /* unableToBurnCoef= */ 0
 };
 
@@ -136,29 +136,28 @@ const FastEvalWeights LINEOUT_WEIGHTS = {
   MAIN_WEIGHTS.tetrisCoef,
   MAIN_WEIGHTS.tetrisReadyCoef,
   MAIN_WEIGHTS.surfaceCoef,
-  /* surfaceLeft= */ 40,
+  /* surfaceLeftCoef= */ 40,
   MAIN_WEIGHTS.unableToBurnCoef
 };
 
-FastEvalWeights getWeights(AiMode mode){
+// Indexed by AiMode, so this must stay in the same order as the enum
+const EvalWeightSet DEFAULT_WEIGHT_SET = {{
+  /* STANDARD= */ MAIN_WEIGHTS,
+  /* DIG= */ DIG_WEIGHTS,
+  /* LINEOUT= */ LINEOUT_WEIGHTS,
+  /* NEAR_KILLSCREEN= */ NEAR_KILLSCREEN_WEIGHTS,
+  /* DIRTY_NEAR_KILLSCREEN= */ DIRTY_NEAR_KILLSCREEN_WEIGHTS
+}};
+
+FastEvalWeights getWeights(AiMode mode, const EvalWeightSet *weightSet){
   if (SHOULD_PLAY_PERFECT){
     return PLAY_PERFECT_WEIGHTS;
   }
-  switch (mode) {
-    case DIG:
-      return DIG_WEIGHTS;
-    case NEAR_KILLSCREEN:
-      return NEAR_KILLSCREEN_WEIGHTS;
-    case DIRTY_NEAR_KILLSCREEN:
-      return DIRTY_NEAR_KILLSCREEN_WEIGHTS;
-    case LINEOUT:
-      return LINEOUT_WEIGHTS;
-    case STANDARD:
-      return MAIN_WEIGHTS;
-    default:
-      printf("Unknown AI Mode");
-      return {};
+  if (mode < 0 || mode >= NUM_AI_MODES) {
+    printf("Unknown AI Mode");
+    return {};
   }
+  return weightSet->weightsByMode[mode];
 }
 
 
@@ -1,4 +1,8 @@
 #include "piece_ranges.hpp"
+#include "reachability_oracle.hpp"
+
+#include <algorithm>
+#include <string.h>
 
 xtable getRangeXTable() {
   xtable table = {};
@@ -27,33 +31,70 @@ xtable getRangeXTable() {
 const xtable X_BOUNDS_COLLISION_TABLE = getRangeXTable();
 
 /**
- * Calculates a lookup table for the Y value you'd be at while doing shift number N.
- * This is used in the tuck search, since this would be the first Y value where you could perform a tuck after N inputs of a standard placement.
+ * Compiles an input frame timeline such as "X...." (a loop of which frames are allowed for inputs) into lookup tables.
+ * This is done once per request, rather than re-reading the string on every simulated frame of the move search.
  */
-void computeYValueOfEachShift(char const *inputFrameTimeline, int gravity, bool gravityDoubled, int initialY, OUT int result[7]){
-  int inputsPerformed = 0;
-  int y = initialY;
-  int frameIndex = 0;
-  while (inputsPerformed <= 5) {
-    int isInputFrame = shouldPerformInputsThisFrame(frameIndex, inputFrameTimeline);
-    int isGravityFrame =
-      frameIndex % gravity == gravity - 1;   // Returns true every Nth frame, where N = gravity
-    if (isInputFrame) {
-      result[inputsPerformed + 1] = y;
-      inputsPerformed++;
+const InputFrameSchedule compileInputFrameSchedule(char const *inputFrameTimeline){
+  InputFrameSchedule schedule = {};
+  schedule.period = std::max(1, std::min((int) strlen(inputFrameTimeline), MAX_INPUT_TIMELINE_LENGTH));
+  for (int i = 0; i < schedule.period; i++) {
+    schedule.inputsBeforeFrame[i] = schedule.inputsPerPeriod;
+    if (inputFrameTimeline[i] == 'X') {
+      schedule.inputMask |= 1ULL << i;
+      schedule.inputsPerPeriod++;
+    }
+  }
+  schedule.inputsBeforeFrame[schedule.period] = schedule.inputsPerPeriod;
+  if (schedule.inputMask == 1 && schedule.period == (int) strlen(inputFrameTimeline)) {
+    schedule.singleInputPeriod = schedule.period;
+  }
+  if (schedule.inputsPerPeriod == 0) {
+    return schedule; // No inputs are ever possible, so the remaining tables are never used
+  }
+
+  // Walk backwards over two loops, so that the frames at the end of the loop see the first input of the next loop
+  int nextInputFrame = 2 * schedule.period;
+  for (int i = 2 * schedule.period - 1; i >= 0; i--) {
+    if (schedule.inputMask & (1ULL << (i % schedule.period))) {
+      nextInputFrame = i;
+    }
+    if (i < schedule.period) {
+      schedule.framesUntilInput[i] = nextInputFrame - i;
     }
-    if (isGravityFrame) {
-      y += gravityDoubled ? 2 : 1;
+  }
+
+  // Find the frame of each of the first few inputs, and how far the piece has fallen by then at each gravity
+  int frameIndex = 0;
+  for (int inputNum = 0; inputNum < NUM_SCHEDULED_INPUTS; inputNum++) {
+    frameIndex += schedule.framesUntilInput[frameIndex % schedule.period];
+    schedule.frameOfInput[inputNum] = frameIndex;
+    // There's a gravity frame every Nth frame (where N = gravity), and on double killscreen the piece falls 2 rows each frame
+    schedule.rowsFallenBeforeInput[0][inputNum] = 2 * frameIndex;
+    for (int gravity = 1; gravity <= 3; gravity++) {
+      schedule.rowsFallenBeforeInput[gravity][inputNum] = frameIndex / gravity;
     }
     frameIndex++;
   }
+  schedule.reachabilityOracle = USE_REACHABILITY_ORACLE ? getReachabilityOracle(&schedule) : NULL;
+  return schedule;
+}
+
+/**
+ * Calculates a lookup table for the Y value you'd be at while doing shift number N.
+ * This is used in the tuck search, since this would be the first Y value where you could perform a tuck after N inputs of a standard placement.
+ */
+void computeYValueOfEachShift(const InputFrameSchedule *inputSchedule, int gravity, bool gravityDoubled, int initialY, OUT int result[7]){
+  int gravityIndex = gravityDoubled ? 0 : gravity;
+  for (int inputNum = 0; inputNum <= 5; inputNum++) {
+    result[inputNum + 1] = initialY + inputSchedule->rowsFallenBeforeInput[gravityIndex][inputNum];
+  }
 }
 
-const PieceRangeContext getPieceRangeContext(char const *inputFrameTimeline, int gravity, bool gravityDoubled){
+const PieceRangeContext getPieceRangeContext(const InputFrameSchedule *inputSchedule, int gravity, bool gravityDoubled){
   PieceRangeContext context = {};
   
-  context.inputFrameTimeline = inputFrameTimeline;
-  computeYValueOfEachShift(inputFrameTimeline, gravity, gravityDoubled, -1, OUT context.yValueOfEachShift);
+  context.inputSchedule = inputSchedule;
+  computeYValueOfEachShift(inputSchedule, gravity, gravityDoubled, -1, OUT context.yValueOfEachShift);
   context.max4TapHeight = 17 - context.yValueOfEachShift[4]; // 17 is the surface height of a square/long bar when y=0
   context.max5TapHeight = 17 - context.yValueOfEachShift[5];
   
@@ -11,13 +11,16 @@ typedef array<array<array<int, 12>, 4>, 7> xtable;
 
 extern const xtable X_BOUNDS_COLLISION_TABLE;
 
+/** Compiles an input frame timeline such as "X...." into lookup tables for the move search. */
+const InputFrameSchedule compileInputFrameSchedule(char const *inputFrameTimeline);
+
 /**
  * Calculates a lookup table for the Y value you'd be at while doing shift number N.
  * This is used in the tuck search, since this would be the first Y value where you could perform a tuck after N inputs of a standard placement.
  */
-void computeYValueOfEachShift(char const *inputFrameTimeline, int gravity, bool gravityDoubled, int initialY, OUT int result[7]);
+void computeYValueOfEachShift(const InputFrameSchedule *inputSchedule, int gravity, bool gravityDoubled, int initialY, OUT int result[7]);
 
-const PieceRangeContext getPieceRangeContext(char const *inputFrameTimeline, int gravity, bool gravityDoubled);
+const PieceRangeContext getPieceRangeContext(const InputFrameSchedule *inputSchedule, int gravity, bool gravityDoubled);
 
 
 #endif
@@ -10,8 +10,8 @@ int transitionProbability[7][7] = {
   {10, 10, 10, 10, 12, 10, 2},
 };
 
-Piece getRandomPiece(Piece previousPiece) {
-  int rand = qualityRandom(0, 64);
+/** Maps a roll in [0, 64) to the next piece, following the transition probabilities from the previous piece. */
+Piece getPieceFromRoll(Piece previousPiece, int rand) {
   for (int i = 0; i < 7; i++) {
     int chance = transitionProbability[previousPiece.index][i];
     if (rand < chance) {
@@ -22,3 +22,11 @@ Piece getRandomPiece(Piece previousPiece) {
   // Never reaches here since cumulative probability is always == 64;
   return {};
 }
+
+Piece getRandomPiece(Piece previousPiece) {
+  return getPieceFromRoll(previousPiece, qualityRandom(0, 64));
+}
+
+Piece getRandomPiece(Piece previousPiece, FastRandom &rng) {
+  return getPieceFromRoll(previousPiece, fastRandomInRange(rng, 0, 64));
+}
@@ -1,3 +1,7 @@
 #include "types.hpp"
+#include "utils.hpp"
 
 Piece getRandomPiece(Piece previousPiece);
+
+/** Same as above, but draws from a seeded generator so the sequence is reproducible. */
+Piece getRandomPiece(Piece previousPiece, FastRandom &rng);
@@ -2,6 +2,10 @@
 #include "eval.hpp"
 #include "utils.hpp"
 #include "params.hpp"
+#include "tracing.hpp"
+#include "data_tables.hpp"
+#include "request_scheduler.hpp"
+#include "cancellation.hpp"
 #include "../data/canonical_sequences.hpp"
 
 using namespace std;
@@ -27,26 +31,30 @@ LockPlacement pickLockPlacement(GameState gameState,
 
 /**
  * Plays out a starting state N moves into the future.
+ * @param playoutData - if non-NULL, the placements and final board of the playout are recorded here.
+ * @param didComplete - if non-NULL, set to whether the playout reached its final evaluation (rather than ending early, e.g. by topping out)
  * @returns the total value of the playout (intermediate rewards + eval of the final board)
  */
-float playSequence(GameState gameState, const PieceRangeContext pieceRangeContextLookup[3], const int pieceSequence[SEQUENCE_LENGTH], int playoutLength, OUT vector<PlayoutData> *playoutDataList) {
+float playSequence(GameState gameState, const PieceRangeContext pieceRangeContextLookup[3], const EvalWeightSet *weightSet, const int pieceSequence[SEQUENCE_LENGTH], int playoutLength, OUT PlayoutData *playoutData, OUT bool *didComplete) {
   // Note down the original AI mode to prevent the AI from putting itself in alternate modes to affect the valuations
-  AiMode originalAiMode = getEvalContext(gameState, pieceRangeContextLookup).aiMode;
+  AiMode originalAiMode = getEvalContext(gameState, pieceRangeContextLookup, weightSet).aiMode;
   
-  PlayoutData newPlayoutData;
-  const bool trackPlayouts = TRACK_PLAYOUT_DETAILS && playoutDataList != NULL;
+  const bool trackPlayouts = playoutData != NULL;
+  if (didComplete != NULL) {
+    *didComplete = false;
+  }
 
   float totalReward = 0;
   for (int i = 0; i < playoutLength; i++) {
     // Figure out modes and eval context
-    const EvalContext evalContextRaw = getEvalContext(gameState, pieceRangeContextLookup);
+    const EvalContext evalContextRaw = getEvalContext(gameState, pieceRangeContextLookup, weightSet);
     const EvalContext *evalContext = &evalContextRaw;
-    FastEvalWeights weights = getWeights(evalContext->aiMode);
+    FastEvalWeights weights = evalContext->weights;
 
     // Get the lock placements
     std::vector<LockPlacement> lockPlacements;
     Piece piece = PIECE_LIST[pieceSequence[i]];
-    moveSearch(gameState, &piece, evalContext->pieceRangeContext.inputFrameTimeline, lockPlacements);
+    moveSearch(gameState, &piece, evalContext->pieceRangeContext.inputSchedule, lockPlacements);
 
     if (lockPlacements.size() == 0) {
       return weights.deathCoef;
@@ -56,8 +64,8 @@ float playSequence(GameState gameState, const PieceRangeContext pieceRangeContex
     LockPlacement bestMove = pickLockPlacement(gameState, evalContext, lockPlacements);
     if (trackPlayouts){
       LockLocation bestMoveLocation = { bestMove.x, bestMove.y, bestMove.rotationIndex };
-      newPlayoutData.pieceSequence += getPieceChar(piece.index);
-      newPlayoutData.placements.push_back(bestMoveLocation);
+      playoutData->pieceSequence += getPieceChar(piece.index);
+      playoutData->placements.push_back(bestMoveLocation);
     }
 
     // On the last move, do a final evaluation
@@ -67,9 +75,11 @@ float playSequence(GameState gameState, const PieceRangeContext pieceRangeContex
       if (SHOULD_PLAY_PERFECT){
         float eval = evalForPerfectPlay(gameState, nextState, bestMove, evalContext);
         if (trackPlayouts){
-          newPlayoutData.totalScore = totalReward + eval;
-          copyBoard(nextState.board, newPlayoutData.resultingBoard);
-          insertIntoList(newPlayoutData, playoutDataList);
+          playoutData->totalScore = totalReward + eval;
+          copyBoard(nextState.board, playoutData->resultingBoard);
+        }
+        if (didComplete != NULL) {
+          *didComplete = true;
         }
         return eval;
       }
@@ -89,9 +99,11 @@ float playSequence(GameState gameState, const PieceRangeContext pieceRangeContex
         printf("*** TOTAL= %f ***\n", totalReward + evalScore);
       }
       if (trackPlayouts) {
-        newPlayoutData.totalScore = totalReward + evalScore;
-        copyBoard(nextState.board, newPlayoutData.resultingBoard);
-        insertIntoList(newPlayoutData, playoutDataList);
+        playoutData->totalScore = totalReward + evalScore;
+        copyBoard(nextState.board, playoutData->resultingBoard);
+      }
+      if (didComplete != NULL) {
+        *didComplete = true;
       }
       return totalReward + evalScore;
     }
@@ -105,7 +117,7 @@ float playSequence(GameState gameState, const PieceRangeContext pieceRangeContex
         return 0; // 0% chance of continuing perfect
       }
     } else {
-      FastEvalWeights rewardWeights = evalContext->aiMode == DIG ? getWeights(STANDARD) : weights; // When the AI is digging, still deduct from the overall value of the sequence at standard amounts
+      FastEvalWeights rewardWeights = evalContext->aiMode == DIG ? getWeights(STANDARD, weightSet) : weights; // When the AI is digging, still deduct from the overall value of the sequence at standard amounts
       totalReward += getLineClearFactor(gameState.lines - oldLines, rewardWeights, evalContext->shouldRewardLineClears);
       if (PLAYOUT_LOGGING_ENABLED) {
         printBoard(gameState.board);
@@ -117,12 +129,11 @@ float playSequence(GameState gameState, const PieceRangeContext pieceRangeContex
 }
 
 
-float getPlayoutScore(GameState gameState, int playoutCount, int playoutLength, const PieceRangeContext pieceRangeContextLookup[3], int firstPieceIndex, OUT vector<PlayoutData> *playoutDataList){
-  // // Don't perform playouts if logging is enabled
-  // if (LOGGING_ENABLED) {
-  //   return 0;
-  // }
-
+/**
+ * Gets the piece sequence played by a given playout. Playouts use the exhaustive list of sequences when the playout count covers every
+ * possible sequence of the requested length, and otherwise index into the randomly-generated sequences for the last known piece.
+ */
+const int *getPlayoutPieceSequence(int playoutCount, int playoutLength, int firstPieceIndex, int playoutIndex){
   // Index into the sequences based on the last known piece given by the in-game randomizer.
   // The piece RNG is dependent on the previous piece, we will then have 1000 sequences with accurate RNG given the last known piece
   int pieceOffset = 1000 + firstPieceIndex * 1000;
@@ -134,14 +145,41 @@ float getPlayoutScore(GameState gameState, int playoutCount, int playoutLength,
     || (playoutCount == 343 && playoutLength == 3)
     || (playoutCount == 2401 && playoutLength == 4);
 
+  return useExhaustiveSequences 
+        ? exhaustivePieceSequences + playoutIndex * EXHAUSTIVE_SEQUENCE_LENGTH // Index into the exhaustive list of possible sequences;
+        : getCanonicalPieceSequences() + (pieceOffset + playoutIndex) * SEQUENCE_LENGTH; // Index into the mega array of randomly-generated piece sequences;
+}
+
+/**
+ * Plays out a starting state with each of the playout piece sequences.
+ * @param cancellationToken - if non-NULL, the remaining playouts are skipped once it's cancelled
+ * @param playoutScores - if non-NULL, the score of each playout that reached its final evaluation is appended here (unsorted).
+ *                        Details for any of them can be recovered afterwards with replayPlayout().
+ * @returns the average score of the playouts (meaningless if the search was cancelled)
+ */
+float getPlayoutScore(GameState gameState, int playoutCount, int playoutLength, const PieceRangeContext pieceRangeContextLookup[3], int firstPieceIndex, const EvalWeightSet *weightSet, const CancellationToken *cancellationToken, OUT vector<PlayoutScoreEntry> *playoutScores){
+  TraceSpan span("getPlayoutScore");
+
+  // // Don't perform playouts if logging is enabled
+  // if (LOGGING_ENABLED) {
+  //   return 0;
+  // }
+
   float playoutScore = 0;
   for (int i = 0; i < playoutCount; i++) {
+    // Let any waiting live requests go first, if this is a batch request
+    yieldToLiveRequests();
+    if (isSearchCancelled(cancellationToken)) {
+      break;
+    }
+
     // Do one playout
-    const int *pieceSequence = useExhaustiveSequences 
-          ? exhaustivePieceSequences + i * EXHAUSTIVE_SEQUENCE_LENGTH // Index into the exhaustive list of possible sequences;
-          : canonicalPieceSequences + (pieceOffset + i) * SEQUENCE_LENGTH; // Index into the mega array of randomly-generated piece sequences;
-    float resultScore = playSequence(gameState, pieceRangeContextLookup, pieceSequence, playoutLength, playoutDataList);
-    // printf("Did playout with score %f %d\n", resultScore, playoutDataList->size());
+    const int *pieceSequence = getPlayoutPieceSequence(playoutCount, playoutLength, firstPieceIndex, i);
+    bool didComplete;
+    float resultScore = playSequence(gameState, pieceRangeContextLookup, weightSet, pieceSequence, playoutLength, /* playoutData= */ NULL, &didComplete);
+    if (playoutScores != NULL && didComplete) {
+      playoutScores->push_back({resultScore, i});
+    }
     playoutScore += resultScore;
   }
 
@@ -150,3 +188,52 @@ float getPlayoutScore(GameState gameState, int playoutCount, int playoutLength,
   }
   return playoutCount == 0 ? 0 : (playoutScore / playoutCount);
 }
+
+/** Same as getPlayoutScore(), but looks up (and stores) the result in a PlayoutCache if one is provided. */
+float getCachedPlayoutScore(PlayoutCache *playoutCache, GameState gameState, int playoutCount, int playoutLength, const PieceRangeContext pieceRangeContextLookup[3], int firstPieceIndex, const EvalWeightSet *weightSet, const CancellationToken *cancellationToken, OUT vector<PlayoutScoreEntry> *playoutScores){
+  if (playoutCache == NULL) {
+    return getPlayoutScore(gameState, playoutCount, playoutLength, pieceRangeContextLookup, firstPieceIndex, weightSet, cancellationToken, playoutScores);
+  }
+
+  // Key on everything the playouts depend on
+  int settings[3] = {playoutCount, playoutLength, firstPieceIndex};
+  const void *contexts[2] = {pieceRangeContextLookup, weightSet};
+  std::string key((const char *) &gameState, sizeof(GameState));
+  key.append((const char *) settings, sizeof(settings));
+  key.append((const char *) contexts, sizeof(contexts));
+  {
+    std::lock_guard<std::mutex> lock(playoutCache->mutex);
+    auto cached = playoutCache->scoresByKey.find(key);
+    if (cached != playoutCache->scoresByKey.end() && (playoutScores == NULL || cached->second.hasPlayoutScores)) {
+      if (playoutScores != NULL) {
+        playoutScores->insert(playoutScores->end(), cached->second.playoutScores.begin(), cached->second.playoutScores.end());
+      }
+      return cached->second.score;
+    }
+  }
+
+  // Compute outside the lock, since other threads may be playing out different states
+  CachedPlayoutScore newEntry = {};
+  newEntry.hasPlayoutScores = playoutScores != NULL;
+  newEntry.score = getPlayoutScore(gameState, playoutCount, playoutLength, pieceRangeContextLookup, firstPieceIndex, weightSet, cancellationToken, newEntry.hasPlayoutScores ? &newEntry.playoutScores : NULL);
+  if (playoutScores != NULL) {
+    playoutScores->insert(playoutScores->end(), newEntry.playoutScores.begin(), newEntry.playoutScores.end());
+  }
+  if (isSearchCancelled(cancellationToken)) {
+    return newEntry.score; // Only some of the playouts were done, so it can't be shared
+  }
+  std::lock_guard<std::mutex> lock(playoutCache->mutex);
+  playoutCache->scoresByKey[key] = newEntry;
+  return newEntry.score;
+}
+
+/** Re-plays one of the playouts from getPlayoutScore() (they're deterministic), recording its placements and final board. */
+PlayoutData replayPlayout(GameState gameState, int playoutCount, int playoutLength, const PieceRangeContext pieceRangeContextLookup[3], int firstPieceIndex, const EvalWeightSet *weightSet, int playoutIndex){
+  PlayoutData playoutData = {};
+  if (!TRACK_PLAYOUT_DETAILS) {
+    return playoutData;
+  }
+  const int *pieceSequence = getPlayoutPieceSequence(playoutCount, playoutLength, firstPieceIndex, playoutIndex);
+  playSequence(gameState, pieceRangeContextLookup, weightSet, pieceSequence, playoutLength, &playoutData, /* didComplete= */ NULL);
+  return playoutData;
+}
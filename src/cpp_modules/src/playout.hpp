@@ -5,11 +5,36 @@
 #include "utils.hpp"
 #include <vector>
 #include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/**
+ * Playout scores keyed by the exact state they were played out from, for requests that are likely to play out the same states
+ * (e.g. consecutive moves of a game, where the 2-ply search of one move overlaps the 1-ply search of the next).
+ * Only valid while the range contexts and weights it was filled with stay alive, since their addresses are part of the key.
+ */
+struct CachedPlayoutScore {
+  float score;
+  bool hasPlayoutScores; // Whether the individual playout scores were recorded
+  std::vector<PlayoutScoreEntry> playoutScores;
+};
+
+struct PlayoutCache {
+  std::mutex mutex;
+  std::unordered_map<std::string, CachedPlayoutScore> scoresByKey;
+};
 
 LockPlacement pickLockPlacement(GameState gameState,
                            const EvalContext *evalContext,
                            OUT std::vector<LockPlacement> &lockPlacements);
 
-float getPlayoutScore(GameState gameState, int playoutCount, int playoutLength, const PieceRangeContext pieceRangeContextLookup[3], int pieceOffsetIndex, OUT vector<PlayoutData> *playoutDataList);
+const int *getPlayoutPieceSequence(int playoutCount, int playoutLength, int firstPieceIndex, int playoutIndex);
+
+float getPlayoutScore(GameState gameState, int playoutCount, int playoutLength, const PieceRangeContext pieceRangeContextLookup[3], int pieceOffsetIndex, const EvalWeightSet *weightSet, const CancellationToken *cancellationToken, OUT vector<PlayoutScoreEntry> *playoutScores);
+
+float getCachedPlayoutScore(PlayoutCache *playoutCache, GameState gameState, int playoutCount, int playoutLength, const PieceRangeContext pieceRangeContextLookup[3], int firstPieceIndex, const EvalWeightSet *weightSet, const CancellationToken *cancellationToken, OUT vector<PlayoutScoreEntry> *playoutScores);
+
+PlayoutData replayPlayout(GameState gameState, int playoutCount, int playoutLength, const PieceRangeContext pieceRangeContextLookup[3], int firstPieceIndex, const EvalWeightSet *weightSet, int playoutIndex);
 
 #endif
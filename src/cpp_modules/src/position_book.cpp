@@ -0,0 +1,186 @@
+#include "position_book.hpp"
+#include <algorithm>
+#include <atomic>
+#include <stdio.h>
+#include <string.h>
+#if !defined(_WIN32) && !defined(__EMSCRIPTEN__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define POSITION_BOOK_USE_MMAP 1
+#endif
+
+/** The book consulted by mainProcess. Replaced books are never unmapped, since lookups on other threads may still be reading them. */
+std::atomic<const PositionBook *> activePositionBook(nullptr);
+
+/** 64-bit FNV-1a, continuing from a given hash. */
+uint64_t fnv1aHash(const void *data, size_t length, uint64_t hash) {
+  const unsigned char *bytes = (const unsigned char *) data;
+  for (size_t i = 0; i < length; i++) {
+    hash ^= bytes[i];
+    hash *= 0x100000001B3ULL;
+  }
+  return hash;
+}
+
+/** A stamp of the eval weights (and book format), so that a book built with other weights is never used. */
+uint64_t getWeightStamp(const EvalWeightSet *weightSet) {
+  uint64_t stamp = fnv1aHash(&POSITION_BOOK_FORMAT_VERSION, sizeof(POSITION_BOOK_FORMAT_VERSION), 0xCBF29CE484222325ULL);
+  return fnv1aHash(weightSet, sizeof(EvalWeightSet), stamp);
+}
+
+void getPositionBookKey(RequestType requestType, char const *inputStr, OUT uint64_t &keyHash, OUT uint64_t &keyCheck) {
+  int32_t requestTypeInt = (int32_t) requestType;
+  size_t inputLength = strlen(inputStr);
+  keyHash = fnv1aHash(inputStr, inputLength, fnv1aHash(&requestTypeInt, sizeof(requestTypeInt), 0xCBF29CE484222325ULL));
+  keyCheck = fnv1aHash(inputStr, inputLength, fnv1aHash(&requestTypeInt, sizeof(requestTypeInt), 0x84222325CBF29CE4ULL));
+}
+
+/** Checks that a book's contents are in bounds, so that a truncated or corrupt file can't cause out-of-bounds reads. */
+bool isPositionBookValid(PositionBook const &book) {
+  if (book.size < sizeof(PositionBookHeader)) {
+    return false;
+  }
+  if (memcmp(book.header->magic, POSITION_BOOK_MAGIC, sizeof(POSITION_BOOK_MAGIC)) != 0 || book.header->formatVersion != POSITION_BOOK_FORMAT_VERSION) {
+    return false;
+  }
+  size_t entriesEnd = sizeof(PositionBookHeader) + (size_t) book.header->numEntries * sizeof(PositionBookEntry);
+  return entriesEnd <= book.size;
+}
+
+/**
+ * Loads a book from disk and makes it the active book.
+ * @returns false if the book couldn't be read, or was built with a different format
+ */
+bool loadPositionBook(char const *path) {
+  PositionBook *book = new PositionBook();
+#ifdef POSITION_BOOK_USE_MMAP
+  int fd = open(path, O_RDONLY);
+  struct stat fileStats;
+  if (fd < 0 || fstat(fd, &fileStats) != 0 || fileStats.st_size == 0) {
+    printf("Unable to open position book %s\n", path);
+    if (fd >= 0) {
+      close(fd);
+    }
+    delete book;
+    return false;
+  }
+  book->size = (size_t) fileStats.st_size;
+  void *mapped = mmap(NULL, book->size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    printf("Unable to map position book %s\n", path);
+    delete book;
+    return false;
+  }
+  book->data = (const char *) mapped;
+#else
+  FILE *bookFile = fopen(path, "rb");
+  if (bookFile == NULL) {
+    printf("Unable to open position book %s\n", path);
+    delete book;
+    return false;
+  }
+  char readBuf[65536];
+  size_t numRead;
+  while ((numRead = fread(readBuf, 1, sizeof(readBuf), bookFile)) > 0) {
+    book->ownedData.insert(book->ownedData.end(), readBuf, readBuf + numRead);
+  }
+  fclose(bookFile);
+  book->data = book->ownedData.data();
+  book->size = book->ownedData.size();
+#endif
+
+  book->header = (const PositionBookHeader *) book->data;
+  if (!isPositionBookValid(*book)) {
+    printf("Position book %s is invalid or from an incompatible version\n", path);
+#ifdef POSITION_BOOK_USE_MMAP
+    munmap((void *) book->data, book->size);
+#endif
+    delete book;
+    return false;
+  }
+  book->entries = (const PositionBookEntry *) (book->data + sizeof(PositionBookHeader));
+  book->results = (const char *) (book->entries + book->header->numEntries);
+  book->resultsSize = book->size - (book->results - book->data);
+  activePositionBook = book;
+  printf("Loaded position book with %u entries\n", book->header->numEntries);
+  return true;
+}
+
+/**
+ * Looks up a request in the active book.
+ * @returns true (and fills in the result and chosen placement) on a hit. Always misses if no book is loaded, or the book was built with other weights.
+ */
+bool lookupPositionBook(RequestType requestType, char const *inputStr, const EvalWeightSet *weightSet, OUT std::string &result, OUT LockLocation &chosenPlacement) {
+  const PositionBook *book = activePositionBook.load();
+  if (book == nullptr || book->header->numEntries == 0) {
+    return false;
+  }
+  if (book->header->weightStamp != getWeightStamp(weightSet)) {
+    return false;
+  }
+  uint64_t keyHash, keyCheck;
+  getPositionBookKey(requestType, inputStr, keyHash, keyCheck);
+  const PositionBookEntry *entriesEnd = book->entries + book->header->numEntries;
+  const PositionBookEntry *entry = std::lower_bound(book->entries, entriesEnd, keyHash, [](PositionBookEntry const &e, uint64_t hash) {
+    return e.keyHash < hash;
+  });
+  for (; entry != entriesEnd && entry->keyHash == keyHash; entry++) {
+    if (entry->keyCheck == keyCheck && (size_t) entry->resultOffset + entry->resultLength <= book->resultsSize) {
+      result.assign(book->results + entry->resultOffset, entry->resultLength);
+      chosenPlacement = entry->hasChosenPlacement
+                        ? LockLocation{entry->chosenX, entry->chosenY, entry->chosenRotation}
+                        : NULL_LOCK_LOCATION;
+      return true;
+    }
+  }
+  return false;
+}
+
+void addToPositionBook(PositionBookBuilder &builder, RequestType requestType, char const *inputStr, std::string const &result, LockLocation chosenPlacement) {
+  PositionBookEntry entry = {};
+  getPositionBookKey(requestType, inputStr, entry.keyHash, entry.keyCheck);
+  entry.resultOffset = (uint32_t) builder.results.length();
+  entry.resultLength = (uint32_t) result.length();
+  if (chosenPlacement.x != NONE) {
+    entry.chosenX = (int8_t) chosenPlacement.x;
+    entry.chosenY = (int8_t) chosenPlacement.y;
+    entry.chosenRotation = (int8_t) chosenPlacement.rotationIndex;
+    entry.hasChosenPlacement = 1;
+  }
+  builder.results += result;
+  builder.entries.push_back(entry);
+}
+
+/**
+ * Writes a built book to disk, stamped with the weights it was built with. Duplicate keys keep their first result.
+ * @returns false if the file couldn't be written
+ */
+bool writePositionBook(PositionBookBuilder &builder, const EvalWeightSet *weightSet, char const *path) {
+  std::stable_sort(builder.entries.begin(), builder.entries.end(), [](PositionBookEntry const &a, PositionBookEntry const &b) {
+    return a.keyHash < b.keyHash || (a.keyHash == b.keyHash && a.keyCheck < b.keyCheck);
+  });
+  builder.entries.erase(std::unique(builder.entries.begin(), builder.entries.end(), [](PositionBookEntry const &a, PositionBookEntry const &b) {
+    return a.keyHash == b.keyHash && a.keyCheck == b.keyCheck;
+  }), builder.entries.end());
+
+  PositionBookHeader header = {};
+  memcpy(header.magic, POSITION_BOOK_MAGIC, sizeof(POSITION_BOOK_MAGIC));
+  header.formatVersion = POSITION_BOOK_FORMAT_VERSION;
+  header.numEntries = (uint32_t) builder.entries.size();
+  header.weightStamp = getWeightStamp(weightSet);
+
+  FILE *bookFile = fopen(path, "wb");
+  if (bookFile == NULL) {
+    printf("Unable to open position book %s for writing\n", path);
+    return false;
+  }
+  fwrite(&header, sizeof(PositionBookHeader), 1, bookFile);
+  fwrite(builder.entries.data(), sizeof(PositionBookEntry), builder.entries.size(), bookFile);
+  fwrite(builder.results.data(), 1, builder.results.length(), bookFile);
+  bool didSucceed = ferror(bookFile) == 0;
+  fclose(bookFile);
+  return didSucceed;
+}
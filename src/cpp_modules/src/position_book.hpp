@@ -0,0 +1,75 @@
+#ifndef POSITION_BOOK
+#define POSITION_BOOK
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "types.hpp"
+
+/**
+ * A persistent book of precomputed results for positions that recur across games (early-game boards, boards after a tetris, etc.),
+ * which is consulted before searching. Books are built offline from simulated games (see position_book_builder.cpp) and memory-mapped
+ * at load time, so loading is instant and the pages are shared between processes. The Node server and its precompute workers load
+ * the book at $POSITION_BOOK, and the engine server takes --position-book.
+ *
+ * Entries are keyed by the request type and the full request input (board, level, lines, pieces, timeline and search settings),
+ * so a hit always returns exactly what the search would have, along with where the search placed the current piece. Each book is stamped with the eval weights it was built with, and is
+ * ignored by requests that use different weights.
+ *
+ * File layout (little-endian):
+ *   PositionBookHeader
+ *   PositionBookEntry[numEntries], sorted by keyHash
+ *   the result strings, back to back
+ */
+
+const char POSITION_BOOK_MAGIC[8] = {'S', 'R', 'B', 'O', 'O', 'K', 0, 0};
+const uint32_t POSITION_BOOK_FORMAT_VERSION = 2;
+
+struct PositionBookHeader {
+  char magic[8];
+  uint32_t formatVersion;
+  uint32_t numEntries;
+  uint64_t weightStamp; // See getWeightStamp()
+};
+
+struct PositionBookEntry {
+  uint64_t keyHash;
+  uint64_t keyCheck; // An independent hash of the key, so that a keyHash collision isn't mistaken for a hit
+  uint32_t resultOffset; // Relative to the start of the result strings
+  uint32_t resultLength;
+  int8_t chosenX; // Where the search placed the current piece, if hasChosenPlacement is set (see mainProcess)
+  int8_t chosenY;
+  int8_t chosenRotation;
+  uint8_t hasChosenPlacement;
+  uint32_t padding;
+};
+
+struct PositionBook {
+  const char *data;
+  size_t size;
+  const PositionBookHeader *header;
+  const PositionBookEntry *entries;
+  const char *results;
+  size_t resultsSize;
+  std::vector<char> ownedData; // Only used on platforms without mmap
+};
+
+/** A book that's being built up in memory, before being written to disk. */
+struct PositionBookBuilder {
+  std::vector<PositionBookEntry> entries;
+  std::string results;
+};
+
+uint64_t getWeightStamp(const EvalWeightSet *weightSet);
+
+void getPositionBookKey(RequestType requestType, char const *inputStr, OUT uint64_t &keyHash, OUT uint64_t &keyCheck);
+
+bool loadPositionBook(char const *path);
+
+bool lookupPositionBook(RequestType requestType, char const *inputStr, const EvalWeightSet *weightSet, OUT std::string &result, OUT LockLocation &chosenPlacement);
+
+void addToPositionBook(PositionBookBuilder &builder, RequestType requestType, char const *inputStr, std::string const &result, LockLocation chosenPlacement);
+
+bool writePositionBook(PositionBookBuilder &builder, const EvalWeightSet *weightSet, char const *path);
+
+#endif
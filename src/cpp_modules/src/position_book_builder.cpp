@@ -0,0 +1,97 @@
+#include "position_book_builder.hpp"
+#include "position_book.hpp"
+#include "game_simulation.hpp"
+#include "parallel.hpp"
+#include "tracing.hpp"
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+/** Formats a position as the request input that a live game would send for it (see mainProcess). */
+std::string formatPositionInput(SimulatedPosition const &position, char const *inputFrameTimeline, EngineConfig const &engineConfig) {
+  std::string input;
+  for (int i = 0; i < 20; i++) {
+    for (int j = 0; j < 10; j++) {
+      input += (position.board[i] >> (9 - j)) & 1 ? '1' : '0';
+    }
+  }
+  char argsBuf[100];
+  snprintf(argsBuf, 100, "|%d|%d|%d|%d|%s|%d|%d|%d|", position.level, position.lines, position.curPieceIndex, position.nextPieceIndex,
+           inputFrameTimeline, engineConfig.playoutCount, engineConfig.playoutLength, engineConfig.pruningBreadth);
+  return input + argsBuf;
+}
+
+/** Counts how many times each request input is reached, remembering the order they were first seen so that the book is reproducible. */
+struct InputCounter {
+  std::unordered_map<std::string, int> occurrences;
+  std::vector<std::string> inputsInOrder;
+
+  void add(std::string const &input) {
+    if (occurrences[input]++ == 0) {
+      inputsInOrder.push_back(input);
+    }
+  }
+
+  std::vector<std::string> getRecurring(int minOccurrences) {
+    std::vector<std::string> recurringInputs;
+    for (std::string const &input : inputsInOrder) {
+      if (occurrences[input] >= minOccurrences) {
+        recurringInputs.push_back(input);
+      }
+    }
+    return recurringInputs;
+  }
+};
+
+int buildPositionBook(char const *outputPath,
+                      EngineConfig const &engineConfig,
+                      char const *inputFrameTimeline,
+                      int startingLevel,
+                      int maxLines,
+                      int numGames,
+                      int minOccurrences,
+                      unsigned long long baseSeed,
+                      int numThreads) {
+  // Play the games, recording every position along the way
+  std::vector<std::vector<SimulatedPosition>> positionsByGame(numGames);
+  parallelFor(numGames, numThreads, [&](int i) {
+    TraceSpan span("simulateGame", i);
+    simulateGame(inputFrameTimeline, startingLevel, maxLines, /* shouldAdjust= */ false, /* reactionTime= */ 21, engineConfig, getGameSeed(baseSeed, i), &positionsByGame[i]);
+  });
+
+  // Keep the positions that recur. The all-next-pieces lookup doesn't depend on the next piece, and the live precompute
+  // always sends it as 0, so those positions are counted separately.
+  InputCounter singlePieceCounter;
+  InputCounter allNextPiecesCounter;
+  for (std::vector<SimulatedPosition> const &positions : positionsByGame) {
+    for (SimulatedPosition const &position : positions) {
+      singlePieceCounter.add(formatPositionInput(position, inputFrameTimeline, engineConfig));
+      SimulatedPosition anyNextPiece = position;
+      anyNextPiece.nextPieceIndex = 0;
+      allNextPiecesCounter.add(formatPositionInput(anyNextPiece, inputFrameTimeline, engineConfig));
+    }
+  }
+  std::vector<std::string> singlePieceInputs = singlePieceCounter.getRecurring(minOccurrences);
+  std::vector<std::string> allNextPiecesInputs = allNextPiecesCounter.getRecurring(minOccurrences);
+  printf("%d distinct positions, %d reached at least %d times\n", (int) singlePieceCounter.inputsInOrder.size(), (int) singlePieceInputs.size(), minOccurrences);
+
+  // Compute the entries with the engine itself, so that a hit returns exactly what the search would
+  PositionBookBuilder builder;
+  std::pair<RequestType, std::vector<std::string> *> bookRequests[] = {
+    {GET_MOVE, &singlePieceInputs},
+    {GET_LOCK_VALUE_LOOKUP, &singlePieceInputs},
+    {GET_LOCK_VALUE_LOOKUP_ALL_NEXT_PIECES, &allNextPiecesInputs},
+  };
+  for (auto const &bookRequest : bookRequests) {
+    std::vector<std::string> const &inputs = *bookRequest.second;
+    std::vector<LockLocation> chosenPlacements;
+    std::vector<std::string> results = mainProcessBatch(inputs, {bookRequest.first}, engineConfig.weightSet, &chosenPlacements);
+    for (size_t i = 0; i < inputs.size(); i++) {
+      addToPositionBook(builder, bookRequest.first, inputs[i].c_str(), results[i], chosenPlacements[i]);
+    }
+  }
+  if (!writePositionBook(builder, engineConfig.weightSet, outputPath)) {
+    return -1;
+  }
+  return (int) builder.entries.size();
+}
@@ -0,0 +1,26 @@
+#ifndef POSITION_BOOK_BUILDER
+#define POSITION_BOOK_BUILDER
+
+#include <string>
+#include "types.hpp"
+
+/**
+ * Builds a position book from the positions that recur across simulated games. Each recurring position gets a GET_MOVE,
+ * GET_LOCK_VALUE_LOOKUP and GET_LOCK_VALUE_LOOKUP_ALL_NEXT_PIECES entry, computed with the engine config's search settings and
+ * weights. Live requests only hit the book if they use the same settings (CPP_LIVEGAME_* in params.ts).
+ * @param minOccurrences - positions reached fewer times than this across all the games are left out
+ * @returns the number of entries in the book, or -1 if it couldn't be written
+ */
+int buildPositionBook(char const *outputPath,
+                      EngineConfig const &engineConfig,
+                      char const *inputFrameTimeline,
+                      int startingLevel,
+                      int maxLines,
+                      int numGames,
+                      int minOccurrences,
+                      unsigned long long baseSeed,
+                      int numThreads);
+
+std::string formatPositionInput(SimulatedPosition const &position, char const *inputFrameTimeline, EngineConfig const &engineConfig);
+
+#endif
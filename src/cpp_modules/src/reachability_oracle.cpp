@@ -0,0 +1,178 @@
+#include "reachability_oracle.hpp"
+#include "config.hpp"
+#include "move_search.hpp"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+std::mutex reachabilityOracleMutex;
+// Keyed by the timeline's period and input mask, which are all that the oracle depends on
+std::map<std::pair<int, unsigned long long>, std::unique_ptr<ReachabilityOracle>> reachabilityOracleCache;
+
+/** The offset of the lowest non-empty row of the piece in a rotation. */
+int getBottomRowOffset(const Piece *piece, int rotationIndex) {
+  int bottomRow = 0;
+  for (int r = 0; r < 4; r++) {
+    if (piece->rowsByRotation[rotationIndex][r] != 0) {
+      bottomRow = r;
+    }
+  }
+  return bottomRow;
+}
+
+/**
+ * Simulates an exploration on an empty board, in the same way as exploreHorizontally, recording each input frame.
+ * The trace ends where exploreHorizontally would on an empty board (at the goal, or on hitting a wall or the floor).
+ */
+void buildReachabilityTrace(const Piece *piece,
+                            int goalRotationIndex,
+                            int shiftIncrement,
+                            int maxOrMinX,
+                            const InputFrameSchedule *inputSchedule,
+                            int gravity,
+                            bool gravityDoubled,
+                            OUT std::vector<ReachabilityStep> &steps) {
+  unsigned int emptyBoard[20] = {};
+  SimState simState = {INITIAL_X, piece->initialY, /* rotationIndex= */ 0, /* frameIndex= */ 0, /* arrIndex= */ 0, piece};
+  if (inputSchedule->inputsPerPeriod == 0) {
+    return;
+  }
+  while (simState.x != maxOrMinX || simState.rotationIndex != goalRotationIndex) {
+    ReachabilityStep step = {};
+    int rotationBefore = simState.rotationIndex;
+    int framesUntilInput = inputSchedule->framesUntilInput[simState.arrIndex % inputSchedule->period];
+    if (!applyGravityBetweenFrames(emptyBoard, simState.frameIndex, simState.frameIndex + framesUntilInput, gravity, gravityDoubled, simState)) {
+      return;
+    }
+    simState.frameIndex += framesUntilInput;
+    simState.arrIndex += framesUntilInput;
+    step.y = simState.y;
+
+    if (simState.x != maxOrMinX) {
+      if (collision(emptyBoard, piece, simState.x + shiftIncrement, simState.y, simState.rotationIndex)) {
+        return;
+      }
+      simState.x += shiftIncrement;
+    }
+    if (simState.rotationIndex != goalRotationIndex) {
+      int rotationAfter = rotateTowardsGoal(simState.rotationIndex, goalRotationIndex);
+      if (collision(emptyBoard, piece, simState.x, simState.y, rotationAfter)) {
+        return;
+      }
+      simState.rotationIndex = rotationAfter;
+    }
+    step.didLock = !applyGravityBetweenFrames(emptyBoard, simState.frameIndex, simState.frameIndex + 1, gravity, gravityDoubled, simState);
+    simState.frameIndex++;
+    simState.arrIndex++;
+
+    step.x = simState.x;
+    step.rotationIndex = simState.rotationIndex;
+    step.yAfter = simState.y;
+    step.frameIndex = simState.frameIndex;
+    step.arrIndex = simState.arrIndex;
+    step.isPlacement = simState.rotationIndex == goalRotationIndex;
+    step.lowestRow = std::max(step.y + getBottomRowOffset(piece, rotationBefore), step.yAfter + getBottomRowOffset(piece, step.rotationIndex));
+    steps.push_back(step);
+    if (step.didLock) {
+      return;
+    }
+  }
+}
+
+ReachabilityOracle *buildReachabilityOracle(const InputFrameSchedule *inputSchedule) {
+  ReachabilityOracle *oracle = new ReachabilityOracle();
+  for (int gravityIndex = 0; gravityIndex < 4; gravityIndex++) {
+    int gravity = gravityIndex == 0 ? 1 : gravityIndex;
+    bool gravityDoubled = gravityIndex == 0;
+    for (int pieceIndex = 0; pieceIndex < 7; pieceIndex++) {
+      const Piece *piece = &PIECE_LIST[pieceIndex];
+      for (int goalRot = 0; goalRot < 4; goalRot++) {
+        for (int variant = 0; variant < NUM_EXPLORATION_VARIANTS; variant++) {
+          oracle->traceStart[gravityIndex][pieceIndex][goalRot][variant] = (int) oracle->steps.size();
+          if (piece->rowsByRotation[goalRot][0] != NONE) {
+            int shiftIncrement = variant == EXPLORE_LEFT ? -1 : variant == EXPLORE_RIGHT ? 1 : variant - EXPLORE_NEAR_SPAWN(0);
+            int maxOrMinX = variant == EXPLORE_LEFT ? -99 : variant == EXPLORE_RIGHT ? 99 : INITIAL_X + shiftIncrement;
+            buildReachabilityTrace(piece, goalRot, shiftIncrement, maxOrMinX, inputSchedule, gravity, gravityDoubled, oracle->steps);
+          }
+          oracle->traceLength[gravityIndex][pieceIndex][goalRot][variant] = (int) oracle->steps.size() - oracle->traceStart[gravityIndex][pieceIndex][goalRot][variant];
+        }
+      }
+    }
+  }
+  return oracle;
+}
+
+const ReachabilityOracle *getReachabilityOracle(const InputFrameSchedule *inputSchedule) {
+  std::lock_guard<std::mutex> lock(reachabilityOracleMutex);
+  std::pair<int, unsigned long long> key(inputSchedule->period, inputSchedule->inputMask);
+  auto cachedOracle = reachabilityOracleCache.find(key);
+  if (cachedOracle != reachabilityOracleCache.end()) {
+    return cachedOracle->second.get();
+  }
+  if (reachabilityOracleCache.size() >= REACHABILITY_ORACLE_CACHE_SIZE) {
+    return NULL; // An unusual timeline, which isn't worth keeping an oracle for. The move search explores it the slow way.
+  }
+  ReachabilityOracle *oracle = buildReachabilityOracle(inputSchedule);
+  reachabilityOracleCache[key].reset(oracle);
+  return oracle;
+}
+
+void replayReachabilityTrace(unsigned int board[20],
+                             int topRow,
+                             const ReachabilityOracle *oracle,
+                             int gravityIndex,
+                             const Piece *piece,
+                             int goalRotationIndex,
+                             int variant,
+                             OUT std::vector<SimState> &legalPlacements) {
+  const ReachabilityStep *step = &oracle->steps[oracle->traceStart[gravityIndex][piece->index][goalRotationIndex][variant]];
+  const ReachabilityStep *traceEnd = step + oracle->traceLength[gravityIndex][piece->index][goalRotationIndex][variant];
+  SimState simState = {INITIAL_X, piece->initialY, /* rotationIndex= */ 0, /* frameIndex= */ 0, /* arrIndex= */ 0, piece};
+
+  for (; step < traceEnd; step++) {
+    bool didLock = step->didLock;
+    if (step->lowestRow < topRow) {
+      // Nothing on the board is this high up, so the step plays out exactly like it did on the empty board
+      simState.x = step->x;
+      simState.y = step->yAfter;
+      simState.rotationIndex = step->rotationIndex;
+    } else {
+      // Otherwise, check each move the piece makes against the board
+      while (simState.y < step->y) {
+        if (collision(board, piece, simState.x, simState.y + 1, simState.rotationIndex)) {
+          return;
+        }
+        simState.y++;
+      }
+      if (simState.x != step->x) {
+        if (collision(board, piece, step->x, simState.y, simState.rotationIndex)) {
+          return;
+        }
+        simState.x = step->x;
+      }
+      if (simState.rotationIndex != step->rotationIndex) {
+        if (collision(board, piece, simState.x, simState.y, step->rotationIndex)) {
+          return;
+        }
+        simState.rotationIndex = step->rotationIndex;
+      }
+      while (simState.y < step->yAfter) {
+        if (collision(board, piece, simState.x, simState.y + 1, simState.rotationIndex)) {
+          didLock = true;
+          break;
+        }
+        simState.y++;
+      }
+    }
+    simState.frameIndex = step->frameIndex;
+    simState.arrIndex = step->arrIndex;
+    if (step->isPlacement) {
+      legalPlacements.push_back(simState);
+    }
+    if (didLock) {
+      return;
+    }
+  }
+}
@@ -0,0 +1,62 @@
+#ifndef REACHABILITY_ORACLE
+#define REACHABILITY_ORACLE
+
+#include "types.hpp"
+#include <vector>
+
+/**
+ * Which of the horizontal explorations of the move search a trace belongs to. The first two shift as far as possible
+ * in each direction, and the rest are the near-spawn explorations with an x offset of -1, 0 or 1.
+ */
+#define NUM_EXPLORATION_VARIANTS 5
+#define EXPLORE_LEFT 0
+#define EXPLORE_RIGHT 1
+#define EXPLORE_NEAR_SPAWN(xOffset) (3 + (xOffset))
+
+/** One input frame of an exploration on an empty board, along with the gravity leading up to and during it. */
+struct ReachabilityStep {
+  int y; // After the gravity leading up to the input frame
+  int x; // After the input
+  int rotationIndex; // After the input
+  int yAfter; // After the input frame's own gravity
+  int frameIndex; // After the input frame
+  int arrIndex;
+  int lowestRow; // The lowest board row the piece occupies (or is tested at) during this step
+  bool didLock; // Whether the piece locked on the floor during the input frame, which ends the exploration
+  bool isPlacement; // Whether the piece reached the goal rotation, making this a legal placement
+};
+
+/**
+ * The path of every spawn exploration of the move search, simulated once on an empty board. On a real board, the path is the
+ * same up until the first collision, so the move search can replay it and only check for collisions once the piece gets
+ * near the top of the stack.
+ */
+struct ReachabilityOracle {
+  std::vector<ReachabilityStep> steps;
+  // Where each trace starts in steps, and its length. Indexed by gravity index (0 = double killscreen, otherwise the gravity), piece, goal rotation, and variant.
+  int traceStart[4][7][4][NUM_EXPLORATION_VARIANTS];
+  int traceLength[4][7][4][NUM_EXPLORATION_VARIANTS];
+};
+
+/**
+ * Gets the oracle for a timeline, building it the first time the timeline is seen.
+ * Oracles are cached for the lifetime of the process, so they are shared across plies, requests and threads. Since schedules
+ * hold on to them, they're never evicted: once REACHABILITY_ORACLE_CACHE_SIZE timelines have been seen, new ones get no oracle.
+ * @returns NULL if the cache is full
+ */
+const ReachabilityOracle *getReachabilityOracle(const InputFrameSchedule *inputSchedule);
+
+/**
+ * Replays one exploration on a board, registering the legal placements along the way exactly as exploreHorizontally would.
+ * @param topRow - the highest row with any filled cells (20 if the board is empty)
+ */
+void replayReachabilityTrace(unsigned int board[20],
+                             int topRow,
+                             const ReachabilityOracle *oracle,
+                             int gravityIndex,
+                             const Piece *piece,
+                             int goalRotationIndex,
+                             int variant,
+                             OUT std::vector<SimState> &legalPlacements);
+
+#endif
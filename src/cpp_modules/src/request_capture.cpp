@@ -0,0 +1,203 @@
+#include "request_capture.hpp"
+#include <algorithm>
+#include <mutex>
+#include <stdio.h>
+#include <string.h>
+
+#define CAPTURED_BOARD_CHARS 200
+#define CAPTURED_BOARD_BYTES (CAPTURED_BOARD_CHARS / 8)
+
+std::atomic<bool> isRequestCaptureActive(false);
+std::mutex requestCaptureMutex;
+FILE *requestCaptureFile = NULL;
+bool shouldCaptureResults = false;
+
+int64_t getCaptureTimestampMicros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+/** Whether an input starts with a board that can be packed, i.e. 200 characters that are all '0' or '1'. */
+bool hasPackableBoard(char const *inputStr, size_t inputLength) {
+  if (inputLength < CAPTURED_BOARD_CHARS) {
+    return false;
+  }
+  for (int i = 0; i < CAPTURED_BOARD_CHARS; i++) {
+    if (inputStr[i] != '0' && inputStr[i] != '1') {
+      return false;
+    }
+  }
+  return true;
+}
+
+/** Encodes an input for the log, packing the board to one bit per cell if possible. @returns the flags to record for it */
+uint8_t packCapturedInput(char const *inputStr, OUT std::string &packedInput) {
+  size_t inputLength = strlen(inputStr);
+  if (!hasPackableBoard(inputStr, inputLength)) {
+    packedInput.assign(inputStr, inputLength);
+    return 0;
+  }
+  packedInput.assign(CAPTURED_BOARD_BYTES, '\0');
+  for (int i = 0; i < CAPTURED_BOARD_CHARS; i++) {
+    if (inputStr[i] == '1') {
+      packedInput[i / 8] |= (char) (1 << (i % 8));
+    }
+  }
+  packedInput.append(inputStr + CAPTURED_BOARD_CHARS, inputLength - CAPTURED_BOARD_CHARS);
+  return CAPTURED_BOARD_PACKED;
+}
+
+std::string unpackCapturedInput(std::string const &storedInput, uint8_t flags) {
+  if (!(flags & CAPTURED_BOARD_PACKED) || storedInput.length() < CAPTURED_BOARD_BYTES) {
+    return storedInput;
+  }
+  std::string input(CAPTURED_BOARD_CHARS, '0');
+  for (int i = 0; i < CAPTURED_BOARD_CHARS; i++) {
+    if (storedInput[i / 8] & (1 << (i % 8))) {
+      input[i] = '1';
+    }
+  }
+  return input + storedInput.substr(CAPTURED_BOARD_BYTES);
+}
+
+/**
+ * Starts appending requests to a log file. A new file gets a header, and an existing one has to be a log in the same format.
+ * @param includeResults - whether to store each result in full, which makes replays show what changed rather than just that
+ *                         something did, at the cost of a much larger log. Otherwise only a hash of each result is stored.
+ * @returns false if the file couldn't be opened
+ */
+bool startRequestCapture(std::string const &path, bool includeResults) {
+  FILE *file = fopen(path.c_str(), "a+b");
+  if (file == NULL) {
+    printf("Unable to open capture file %s\n", path.c_str());
+    return false;
+  }
+  RequestCaptureFileHeader header = {REQUEST_CAPTURE_MAGIC, REQUEST_CAPTURE_VERSION};
+  RequestCaptureFileHeader existingHeader;
+  fseek(file, 0, SEEK_END);
+  if (ftell(file) == 0) {
+    fwrite(&header, sizeof(header), 1, file);
+    fflush(file);
+  } else {
+    fseek(file, 0, SEEK_SET);
+    if (fread(&existingHeader, sizeof(existingHeader), 1, file) != 1 || existingHeader.magic != header.magic || existingHeader.version != header.version) {
+      printf("%s isn't a request capture in this build's format\n", path.c_str());
+      fclose(file);
+      return false;
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(requestCaptureMutex);
+  if (requestCaptureFile != NULL) {
+    fclose(requestCaptureFile);
+  }
+  requestCaptureFile = file;
+  shouldCaptureResults = includeResults;
+  isRequestCaptureActive = true;
+  return true;
+}
+
+void stopRequestCapture() {
+  std::lock_guard<std::mutex> lock(requestCaptureMutex);
+  isRequestCaptureActive = false;
+  if (requestCaptureFile != NULL) {
+    fclose(requestCaptureFile);
+    requestCaptureFile = NULL;
+  }
+}
+
+RequestCaptureScope::RequestCaptureScope(bool shouldCapture) {
+  isCapturing = REQUEST_CAPTURE_SUPPORTED && shouldCapture && isRequestCaptureActive.load(std::memory_order_relaxed);
+  timestampMicros = isCapturing ? getCaptureTimestampMicros() : 0;
+  if (isCapturing) {
+    startTime = std::chrono::steady_clock::now();
+  }
+}
+
+/** Appends the request to the log, if capture was active when the scope started. */
+void RequestCaptureScope::finish(RequestType requestType, char const *inputStr, std::string const &result, bool wasCancelled, bool wasBookHit) {
+  if (!isCapturing) {
+    return;
+  }
+  isCapturing = false;
+  long long durationMicros = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+  std::string storedInput;
+  RequestCaptureRecordHeader header = {};
+  header.timestampMicros = timestampMicros;
+  header.resultHash = fnv1aHash(result.data(), result.length(), 0xCBF29CE484222325ULL);
+  header.durationMicros = (uint32_t) std::min(durationMicros, (long long) UINT32_MAX);
+  header.flags = packCapturedInput(inputStr, storedInput) | (wasCancelled ? CAPTURED_CANCELLED : 0) | (wasBookHit ? CAPTURED_BOOK_HIT : 0);
+  header.inputLength = (uint32_t) storedInput.length();
+  header.resultLength = (uint32_t) result.length();
+  header.requestType = (uint8_t) requestType;
+
+  std::lock_guard<std::mutex> lock(requestCaptureMutex);
+  if (requestCaptureFile == NULL) {
+    return; // Capture was stopped during the request
+  }
+  if (shouldCaptureResults) {
+    header.flags |= CAPTURED_RESULT_INCLUDED;
+  }
+  fwrite(&header, sizeof(header), 1, requestCaptureFile);
+  fwrite(storedInput.data(), 1, storedInput.length(), requestCaptureFile);
+  if (shouldCaptureResults) {
+    fwrite(result.data(), 1, result.length(), requestCaptureFile);
+  }
+  fflush(requestCaptureFile);
+}
+
+/**
+ * Reads every record from a log. A record cut short at the end of the file (from a process that crashed mid-write) is ignored.
+ * @returns false if the file couldn't be read, with the reason in error
+ */
+bool readRequestCapture(std::string const &path, OUT std::vector<CapturedRequest> &requests, OUT std::string &error) {
+  FILE *file = fopen(path.c_str(), "rb");
+  if (file == NULL) {
+    error = "Unable to open " + path;
+    return false;
+  }
+  std::string contents;
+  char buf[1 << 16];
+  size_t numRead;
+  while ((numRead = fread(buf, 1, sizeof(buf), file)) > 0) {
+    contents.append(buf, numRead);
+  }
+  fclose(file);
+
+  RequestCaptureFileHeader fileHeader;
+  if (contents.length() < sizeof(fileHeader)) {
+    error = path + " is too short to be a request capture";
+    return false;
+  }
+  memcpy(&fileHeader, contents.data(), sizeof(fileHeader));
+  if (fileHeader.magic != REQUEST_CAPTURE_MAGIC || fileHeader.version != REQUEST_CAPTURE_VERSION) {
+    error = path + " isn't a request capture in this build's format";
+    return false;
+  }
+
+  size_t offset = sizeof(fileHeader);
+  while (offset + sizeof(RequestCaptureRecordHeader) <= contents.length()) {
+    RequestCaptureRecordHeader header;
+    memcpy(&header, contents.data() + offset, sizeof(header));
+    size_t storedResultLength = (header.flags & CAPTURED_RESULT_INCLUDED) ? header.resultLength : 0;
+    size_t recordEnd = offset + sizeof(header) + header.inputLength + storedResultLength;
+    if (recordEnd > contents.length()) {
+      break;
+    }
+    CapturedRequest request;
+    request.requestType = (RequestType) header.requestType;
+    request.timestampMicros = header.timestampMicros;
+    request.durationMicros = header.durationMicros;
+    request.flags = header.flags;
+    request.resultHash = header.resultHash;
+    request.resultLength = header.resultLength;
+    const char *storedInput = contents.data() + offset + sizeof(header);
+    request.input = unpackCapturedInput(std::string(storedInput, header.inputLength), header.flags);
+    request.result.assign(storedInput + header.inputLength, storedResultLength);
+    requests.push_back(request);
+    offset = recordEnd;
+  }
+  if (offset != contents.length()) {
+    printf("Ignoring a truncated record at the end of %s\n", path.c_str());
+  }
+  return true;
+}
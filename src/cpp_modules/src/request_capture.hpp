@@ -0,0 +1,78 @@
+#ifndef REQUEST_CAPTURE
+#define REQUEST_CAPTURE
+
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "config.hpp"
+#include "types.hpp"
+
+/**
+ * Records the requests that mainProcess handles, so that real traffic can be replayed offline (see request_replay_main.cpp).
+ *
+ * While capture is started, each request is appended to a binary log: its type, its input, when it arrived, how long it took, and
+ * either a hash of its result or the whole result. The board part of the input is packed to one bit per cell, so a typical record (without
+ * its result) is under 100 bytes. Records are flushed as they're written, so a log survives the process crashing.
+ */
+
+#define REQUEST_CAPTURE_MAGIC 0x43524253 // "SBRC"
+#define REQUEST_CAPTURE_VERSION 1
+
+enum CapturedRequestFlags {
+  CAPTURED_BOARD_PACKED = 1, // The 200 board characters at the start of the input are stored as 25 bytes
+  CAPTURED_RESULT_INCLUDED = 2, // The result follows the input
+  CAPTURED_CANCELLED = 4, // The search was cut short, so the duration and result aren't meaningful
+  CAPTURED_BOOK_HIT = 8 // The result came from the position book, so the duration is a lookup rather than a search
+};
+
+struct RequestCaptureFileHeader {
+  uint32_t magic;
+  uint32_t version;
+};
+
+/** Each record is this header, followed by the (possibly packed) input and then, if it's included, the result. */
+struct RequestCaptureRecordHeader {
+  int64_t timestampMicros; // When the request arrived, in microseconds since the Unix epoch
+  uint64_t resultHash; // FNV-1a of the result
+  uint32_t durationMicros;
+  uint32_t inputLength; // The number of input bytes stored in the log
+  uint32_t resultLength; // The length of the result, whether or not it's stored
+  uint8_t requestType;
+  uint8_t flags; // CapturedRequestFlags
+  uint8_t reserved[2];
+};
+
+static_assert(sizeof(RequestCaptureRecordHeader) == 32, "The record layout is part of the file format");
+
+/** A record read back from a log, with the input unpacked. */
+struct CapturedRequest {
+  RequestType requestType;
+  int64_t timestampMicros;
+  uint32_t durationMicros;
+  uint8_t flags;
+  uint64_t resultHash;
+  uint32_t resultLength;
+  std::string input;
+  std::string result; // Empty unless CAPTURED_RESULT_INCLUDED is set
+};
+
+/** Times one request from construction until finish() is called. Costs a single atomic load when capture isn't active. */
+struct RequestCaptureScope {
+  bool isCapturing;
+  int64_t timestampMicros;
+  std::chrono::steady_clock::time_point startTime;
+
+  RequestCaptureScope(bool shouldCapture);
+
+  void finish(RequestType requestType, char const *inputStr, std::string const &result, bool wasCancelled, bool wasBookHit);
+};
+
+bool startRequestCapture(std::string const &path, bool includeResults);
+
+void stopRequestCapture();
+
+bool readRequestCapture(std::string const &path, OUT std::vector<CapturedRequest> &requests, OUT std::string &error);
+
+#endif
@@ -0,0 +1,160 @@
+#include <stdlib.h>
+#include <string.h>
+#include "main.cpp"
+
+/**
+ * Replays a request capture (see request_capture.hpp), to check a performance change against real traffic. Each request is run
+ * again, and its time is compared to the captured time, and its result to the captured result (or its hash).
+ * Usage: request_replay <capture file> [--threads <count>] [--position-book <path>] [--show-diffs]
+ *
+ * With more than one thread, requests are replayed concurrently (and each search runs serially, like the engine server's
+ * workers). Requests that were answered from the position book are marked in the log, and in the report; load the same book as the
+ * process that captured the log, so that they're book hits again and their times compare like for like.
+ */
+
+const char *REQUEST_TYPE_NAMES[] = {"GET_LOCK_VALUE_LOOKUP", "GET_TOP_MOVES", "GET_TOP_MOVES_HYBRID", "RATE_MOVE", "GET_MOVE",
+                                    "GET_LOCK_VALUE_LOOKUP_ALL_NEXT_PIECES", "GET_LOCK_VALUE_LOOKUP_PACKED"};
+
+enum ReplayOutcome {
+  REPLAY_MATCHED,
+  REPLAY_DIFFERED,
+  REPLAY_SKIPPED // Cancelled when it was captured, so there's nothing to compare it with
+};
+
+struct ReplayedRequest {
+  ReplayOutcome outcome;
+  double replayedMs;
+  bool wasBookHit;
+  std::string result;
+};
+
+const char *getRequestTypeName(RequestType requestType) {
+  return requestType <= GET_LOCK_VALUE_LOOKUP_PACKED ? REQUEST_TYPE_NAMES[requestType] : "UNKNOWN";
+}
+
+/** Gets the index of the first byte where two results differ (or where the shorter one ends). */
+size_t getFirstDifference(std::string const &a, std::string const &b) {
+  size_t i = 0;
+  while (i < a.length() && i < b.length() && a[i] == b[i]) {
+    i++;
+  }
+  return i;
+}
+
+void replayRequest(CapturedRequest const &request, OUT ReplayedRequest &replayed) {
+  if ((request.flags & CAPTURED_CANCELLED) || request.requestType > GET_LOCK_VALUE_LOOKUP_PACKED) {
+    replayed.outcome = REPLAY_SKIPPED;
+    replayed.replayedMs = 0;
+    return;
+  }
+  std::string bookResult;
+  LockLocation bookPlacement;
+  replayed.wasBookHit = USE_POSITION_BOOK && lookupPositionBook(request.requestType, request.input.c_str(), &DEFAULT_WEIGHT_SET, bookResult, bookPlacement);
+  std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+  replayed.result = mainProcess(request.input.c_str(), request.requestType);
+  replayed.replayedMs = getMillisBetween(startTime, std::chrono::steady_clock::now());
+
+  bool isSame = (request.flags & CAPTURED_RESULT_INCLUDED)
+      ? replayed.result == request.result
+      : replayed.result.length() == request.resultLength && fnv1aHash(replayed.result.data(), replayed.result.length(), 0xCBF29CE484222325ULL) == request.resultHash;
+  replayed.outcome = isSame ? REPLAY_MATCHED : REPLAY_DIFFERED;
+}
+
+void printResultDiff(CapturedRequest const &request, ReplayedRequest const &replayed) {
+  if (!(request.flags & CAPTURED_RESULT_INCLUDED)) {
+    printf("      input:    %s\n      captured: (not stored; %u bytes)\n      replayed: %s\n", request.input.c_str(), request.resultLength, replayed.result.c_str());
+    return;
+  }
+  size_t start = getFirstDifference(request.result, replayed.result);
+  start = start > 40 ? start - 40 : 0;
+  printf("      input:    %s\n      first difference at byte %zu\n      captured: ...%.200s\n      replayed: ...%.200s\n", request.input.c_str(),
+         getFirstDifference(request.result, replayed.result), request.result.c_str() + start, replayed.result.c_str() + std::min(start, replayed.result.length()));
+}
+
+int main(int argc, const char *argv[]) {
+  if (argc < 2) {
+    printf("Usage: request_replay <capture file> [--threads <count>] [--position-book <path>] [--show-diffs]\n");
+    return 1;
+  }
+  int numThreads = 1;
+  bool showDiffs = false;
+  for (int i = 2; i < argc; i++) {
+    if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+      numThreads = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--position-book") == 0 && i + 1 < argc) {
+      loadPositionBook(argv[++i]);
+    } else if (strcmp(argv[i], "--show-diffs") == 0) {
+      showDiffs = true;
+    } else {
+      printf("Unknown argument %s\n", argv[i]);
+      return 1;
+    }
+  }
+
+  std::vector<CapturedRequest> requests;
+  std::string error;
+  if (!readRequestCapture(argv[1], requests, error)) {
+    printf("%s\n", error.c_str());
+    return 1;
+  }
+  printf("Replaying %d requests on %d threads\n", (int) requests.size(), numThreads);
+  fflush(stdout);
+
+  // The searches print debug lines to stdout, so the report waits until they're all done
+  std::vector<ReplayedRequest> replayedRequests(requests.size());
+  std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+  parallelFor((int) requests.size(), numThreads, [&](int i) {
+    replayRequest(requests[i], replayedRequests[i]);
+  });
+  double wallMs = getMillisBetween(startTime, std::chrono::steady_clock::now());
+
+  printf("\n%6s  %-38s %12s %12s %8s  %s\n", "#", "type", "capturedMs", "replayedMs", "delta", "result");
+  std::vector<double> capturedMs, replayedMs;
+  int numDiffs = 0, numSkipped = 0, numCapturedBookHits = 0, numReplayedBookHits = 0, numBookMismatches = 0;
+  for (size_t i = 0; i < requests.size(); i++) {
+    CapturedRequest const &request = requests[i];
+    ReplayedRequest const &replayed = replayedRequests[i];
+    if (replayed.outcome == REPLAY_SKIPPED) {
+      numSkipped++;
+      printf("%6zu  %-38s %12s %12s %8s  skipped (cancelled)\n", i, getRequestTypeName(request.requestType), "-", "-", "-");
+      continue;
+    }
+    double requestCapturedMs = request.durationMicros / 1000.0;
+    capturedMs.push_back(requestCapturedMs);
+    replayedMs.push_back(replayed.replayedMs);
+    bool wasCapturedBookHit = request.flags & CAPTURED_BOOK_HIT;
+    numCapturedBookHits += wasCapturedBookHit;
+    numReplayedBookHits += replayed.wasBookHit;
+    numBookMismatches += wasCapturedBookHit != replayed.wasBookHit;
+    double deltaPercent = requestCapturedMs > 0 ? 100 * (replayed.replayedMs - requestCapturedMs) / requestCapturedMs : 0;
+    printf("%6zu  %-38s %12.2f %12.2f %+7.1f%%  %s%s\n", i, getRequestTypeName(request.requestType), requestCapturedMs, replayed.replayedMs,
+           deltaPercent, replayed.outcome == REPLAY_MATCHED ? "same" : "DIFFERENT",
+           wasCapturedBookHit == replayed.wasBookHit ? (wasCapturedBookHit ? " (book)" : "")
+                                                     : (wasCapturedBookHit ? " (book when captured)" : " (book when replayed)"));
+    if (replayed.outcome == REPLAY_DIFFERED) {
+      numDiffs++;
+      if (showDiffs) {
+        printResultDiff(request, replayed);
+      }
+    }
+  }
+
+  double totalCapturedMs = 0, totalReplayedMs = 0;
+  for (size_t i = 0; i < capturedMs.size(); i++) {
+    totalCapturedMs += capturedMs[i];
+    totalReplayedMs += replayedMs[i];
+  }
+  printf("\nReplayed %d requests (%d skipped) in %.1f ms of wall time\n", (int) capturedMs.size(), numSkipped, wallMs);
+  printf("%-10s %12s %12s %12s %12s\n", "", "totalMs", "p50Ms", "p99Ms", "maxMs");
+  printf("%-10s %12.1f %12.2f %12.2f %12.2f\n", "captured", totalCapturedMs, getPercentile(capturedMs, 50), getPercentile(capturedMs, 99),
+         getPercentile(capturedMs, 100));
+  printf("%-10s %12.1f %12.2f %12.2f %12.2f\n", "replayed", totalReplayedMs, getPercentile(replayedMs, 50), getPercentile(replayedMs, 99),
+         getPercentile(replayedMs, 100));
+  printf("Results: %d same, %d different\n", (int) capturedMs.size() - numDiffs, numDiffs);
+  printf("Position book hits: %d captured, %d replayed\n", numCapturedBookHits, numReplayedBookHits);
+  if (numBookMismatches > 0) {
+    printf("%d requests were book hits in only one of the runs, so their times compare a lookup with a search. Use --position-book with the "
+           "book that the capturing process loaded.\n", numBookMismatches);
+  }
+  return numDiffs > 0 ? 2 : 0;
+}
@@ -0,0 +1,148 @@
+#include "request_scheduler.hpp"
+#include <algorithm>
+#include <stdio.h>
+
+/** The scheduler whose job is running on this thread (NULL if it isn't a scheduler worker), and that job's class. */
+thread_local RequestScheduler *currentScheduler = NULL;
+thread_local RequestClass currentRequestClass = LIVE_REQUEST;
+
+RequestClass getRequestClass(RequestType requestType) {
+  switch (requestType) {
+    case RATE_MOVE:
+    case GET_TOP_MOVES:
+    case GET_TOP_MOVES_HYBRID:
+      return BATCH_REQUEST;
+    default:
+      return LIVE_REQUEST;
+  }
+}
+
+void submitScheduledJob(RequestScheduler &scheduler, RequestClass requestClass, std::function<void()> run) {
+  {
+    std::lock_guard<std::mutex> lock(scheduler.mutex);
+    scheduler.queues[requestClass].push_back({requestClass, std::move(run), std::chrono::steady_clock::now()});
+    if (requestClass == LIVE_REQUEST) {
+      scheduler.numQueuedLiveJobs++;
+    }
+  }
+  scheduler.hasJobs.notify_one();
+}
+
+/**
+ * Takes the highest priority job off the queues. The caller must hold the scheduler's lock.
+ * @returns false if there are no jobs (of the requested classes)
+ */
+bool popScheduledJob(RequestScheduler &scheduler, bool liveOnly, OUT ScheduledJob &job) {
+  int numClasses = liveOnly ? 1 : NUM_REQUEST_CLASSES;
+  for (int requestClass = 0; requestClass < numClasses; requestClass++) {
+    std::deque<ScheduledJob> &queue = scheduler.queues[requestClass];
+    if (!queue.empty()) {
+      job = std::move(queue.front());
+      queue.pop_front();
+      if (requestClass == LIVE_REQUEST) {
+        scheduler.numQueuedLiveJobs--;
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+double getMillisBetween(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end) {
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+/** Runs a job on the calling thread, and records its latency (the time from being submitted to being completed). */
+void runScheduledJob(RequestScheduler &scheduler, ScheduledJob &job) {
+  RequestScheduler *outerScheduler = currentScheduler;
+  RequestClass outerRequestClass = currentRequestClass;
+  currentScheduler = &scheduler;
+  currentRequestClass = job.requestClass;
+  std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+  job.run();
+  std::chrono::steady_clock::time_point endTime = std::chrono::steady_clock::now();
+  currentScheduler = outerScheduler;
+  currentRequestClass = outerRequestClass;
+
+  double latencyMs = getMillisBetween(job.submitTime, endTime);
+  std::lock_guard<std::mutex> lock(scheduler.mutex);
+  RequestClassStats &stats = scheduler.stats[job.requestClass];
+  if (stats.recentLatenciesMs.size() < SCHEDULER_LATENCY_SAMPLES) {
+    stats.recentLatenciesMs.push_back(latencyMs);
+  } else {
+    stats.recentLatenciesMs[stats.numCompleted % SCHEDULER_LATENCY_SAMPLES] = latencyMs;
+  }
+  stats.numCompleted++;
+  stats.totalLatencyMs += latencyMs;
+  stats.totalQueueMs += getMillisBetween(job.submitTime, startTime);
+  stats.maxLatencyMs = std::max(stats.maxLatencyMs, latencyMs);
+}
+
+/** Runs jobs from the scheduler on the calling thread, forever. */
+void runSchedulerWorker(RequestScheduler &scheduler) {
+  while (true) {
+    ScheduledJob job;
+    {
+      std::unique_lock<std::mutex> lock(scheduler.mutex);
+      while (!popScheduledJob(scheduler, /* liveOnly= */ false, job)) {
+        scheduler.hasJobs.wait(lock);
+      }
+    }
+    runScheduledJob(scheduler, job);
+  }
+}
+
+/**
+ * Called by the search at each playout boundary. If the calling thread is running a batch or speculative request for a scheduler,
+ * and live requests are waiting, runs them before returning. Otherwise costs a couple of thread-local reads.
+ */
+void yieldToLiveRequests() {
+  RequestScheduler *scheduler = currentScheduler;
+  if (scheduler == NULL || currentRequestClass == LIVE_REQUEST || scheduler->numQueuedLiveJobs.load(std::memory_order_relaxed) == 0) {
+    return;
+  }
+  while (true) {
+    ScheduledJob job;
+    {
+      std::lock_guard<std::mutex> lock(scheduler->mutex);
+      if (!popScheduledJob(*scheduler, /* liveOnly= */ true, job)) {
+        return;
+      }
+      scheduler->stats[currentRequestClass].numPreemptions++;
+    }
+    runScheduledJob(*scheduler, job);
+  }
+}
+
+/** Gets the value at a given percentile (0-100) of a list of samples. */
+double getPercentile(std::vector<double> samples, double percentile) {
+  if (samples.empty()) {
+    return 0;
+  }
+  size_t index = std::min(samples.size() - 1, (size_t) (percentile / 100 * samples.size()));
+  std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+  return samples[index];
+}
+
+/**
+ * Formats the latency of each request class, e.g.
+ * {"live": {"completed": 120, "preemptions": 0, "meanMs": 40.1, "meanQueueMs": 2.3, "p50Ms": 38.0, "p99Ms": 95.2, "maxMs": 130.4}, "batch": {...}}
+ * The percentiles cover the last SCHEDULER_LATENCY_SAMPLES requests of the class, and the rest cover all of them.
+ */
+std::string getSchedulerStatsJson(RequestScheduler &scheduler) {
+  const char *classNames[NUM_REQUEST_CLASSES] = {"live", "batch", "speculative"};
+  std::lock_guard<std::mutex> lock(scheduler.mutex);
+  std::string json = "{";
+  for (int requestClass = 0; requestClass < NUM_REQUEST_CLASSES; requestClass++) {
+    RequestClassStats const &stats = scheduler.stats[requestClass];
+    double numCompleted = std::max(1LL, stats.numCompleted);
+    char buf[320];
+    snprintf(buf, sizeof(buf),
+             "%s\"%s\": {\"completed\": %lld, \"preemptions\": %lld, \"meanMs\": %.1f, \"meanQueueMs\": %.1f, \"p50Ms\": %.1f, \"p99Ms\": %.1f, \"maxMs\": %.1f}",
+             requestClass == 0 ? "" : ", ", classNames[requestClass], stats.numCompleted, stats.numPreemptions,
+             stats.totalLatencyMs / numCompleted, stats.totalQueueMs / numCompleted, getPercentile(stats.recentLatenciesMs, 50),
+             getPercentile(stats.recentLatenciesMs, 99), stats.maxLatencyMs);
+    json += buf;
+  }
+  return json + "}";
+}
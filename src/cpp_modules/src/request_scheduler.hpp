@@ -0,0 +1,67 @@
+#ifndef REQUEST_SCHEDULER
+#define REQUEST_SCHEDULER
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "types.hpp"
+
+/**
+ * Schedules requests from live games ahead of batch analysis, when both are served by the same pool of worker threads
+ * (e.g. by the engine server).
+ *
+ * Queued requests are picked in order of their class: live, then batch, then speculative. A batch or speculative search that's
+ * already running also gives way: at each playout boundary it checks for queued live requests, and runs them on its own thread
+ * before carrying on. So a live request waits for at most one playout, rather than for a whole search.
+ */
+
+enum RequestClass {
+  LIVE_REQUEST, // Requests for a move in a game that's being played, with a frame deadline
+  BATCH_REQUEST, // Analysis (e.g. rating moves), where only the throughput matters
+  SPECULATIVE_REQUEST, // Searches of positions that may be requested next (see speculation.hpp), only run when nothing else is queued
+  NUM_REQUEST_CLASSES
+};
+
+#define SCHEDULER_LATENCY_SAMPLES 1000 // The number of recent requests of each class that the latency percentiles cover
+
+struct ScheduledJob {
+  RequestClass requestClass;
+  std::function<void()> run;
+  std::chrono::steady_clock::time_point submitTime;
+};
+
+struct RequestClassStats {
+  long long numCompleted;
+  long long numPreemptions; // For batch and speculative requests, the number of live requests that were run during them
+  double totalLatencyMs;
+  double totalQueueMs;
+  double maxLatencyMs;
+  std::vector<double> recentLatenciesMs; // A ring buffer of the last SCHEDULER_LATENCY_SAMPLES latencies
+};
+
+struct RequestScheduler {
+  std::mutex mutex;
+  std::condition_variable hasJobs;
+  std::deque<ScheduledJob> queues[NUM_REQUEST_CLASSES];
+  std::atomic<int> numQueuedLiveJobs; // Read without the lock at every yield point
+  RequestClassStats stats[NUM_REQUEST_CLASSES];
+
+  RequestScheduler() : numQueuedLiveJobs(0), stats() {}
+};
+
+RequestClass getRequestClass(RequestType requestType);
+
+void submitScheduledJob(RequestScheduler &scheduler, RequestClass requestClass, std::function<void()> run);
+
+void runSchedulerWorker(RequestScheduler &scheduler);
+
+void yieldToLiveRequests();
+
+std::string getSchedulerStatsJson(RequestScheduler &scheduler);
+
+#endif
@@ -0,0 +1,174 @@
+#include "shared_ring.hpp"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SHARED_RING_INDEX_MASK (SHARED_RING_NUM_SLOTS - 1)
+
+static_assert((SHARED_RING_NUM_SLOTS & SHARED_RING_INDEX_MASK) == 0, "SHARED_RING_NUM_SLOTS must be a power of 2");
+
+/** Maps the whole of a ring file into memory. @returns NULL on failure */
+SharedRingFile *mapSharedRingFile(int fd) {
+  void *address = mmap(NULL, sizeof(SharedRingFile), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd); // The mapping stays valid without the descriptor
+  return address == MAP_FAILED ? NULL : (SharedRingFile *) address;
+}
+
+void initializeSharedRing(SharedRing &ring) {
+  ring.enqueuePosition.store(0, std::memory_order_relaxed);
+  ring.dequeuePosition.store(0, std::memory_order_relaxed);
+  for (int i = 0; i < SHARED_RING_NUM_SLOTS; i++) {
+    ring.slots[i].sequence.store(i, std::memory_order_relaxed);
+  }
+}
+
+/**
+ * Creates (or recreates) a ring file, with both rings empty. Called by the engine server, before any client opens the file.
+ * @returns NULL on failure
+ */
+SharedRingFile *createSharedRingFile(std::string const &path) {
+  unlink(path.c_str()); // Clients that still have the old file mapped won't see this one, rather than seeing it reset under them
+  int fd = open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd < 0 || ftruncate(fd, sizeof(SharedRingFile)) != 0) {
+    printf("Unable to create %s: %s\n", path.c_str(), strerror(errno));
+    if (fd >= 0) {
+      close(fd);
+    }
+    return NULL;
+  }
+  SharedRingFile *file = mapSharedRingFile(fd);
+  if (file == NULL) {
+    printf("Unable to map %s: %s\n", path.c_str(), strerror(errno));
+    return NULL;
+  }
+  // The file starts out zeroed, which is a valid state for the atomics, so they can be set up in place
+  file->version = SHARED_RING_VERSION;
+  file->numSlots = SHARED_RING_NUM_SLOTS;
+  file->slotBytes = sizeof(SharedRingSlot);
+  initializeSharedRing(file->requests);
+  initializeSharedRing(file->responses);
+  file->magic.store(SHARED_RING_MAGIC, std::memory_order_release);
+  return file;
+}
+
+/**
+ * Opens a ring file created by the engine server.
+ * @returns NULL on failure, with the reason in error
+ */
+SharedRingFile *openSharedRingFile(std::string const &path, OUT std::string &error) {
+  int fd = open(path.c_str(), O_RDWR);
+  if (fd < 0) {
+    error = "Unable to open " + path + ": " + strerror(errno);
+    return NULL;
+  }
+  struct stat fileStat;
+  if (fstat(fd, &fileStat) != 0 || (size_t) fileStat.st_size != sizeof(SharedRingFile)) {
+    close(fd);
+    error = path + " isn't a ring file with this build's layout";
+    return NULL;
+  }
+  SharedRingFile *file = mapSharedRingFile(fd);
+  if (file == NULL) {
+    error = "Unable to map " + path + ": " + strerror(errno);
+    return NULL;
+  }
+  if (file->magic.load(std::memory_order_acquire) != SHARED_RING_MAGIC || file->version != SHARED_RING_VERSION
+      || file->numSlots != SHARED_RING_NUM_SLOTS || file->slotBytes != sizeof(SharedRingSlot)) {
+    munmap(file, sizeof(SharedRingFile));
+    error = path + " isn't a ring file with this build's layout";
+    return NULL;
+  }
+  return file;
+}
+
+/**
+ * Adds a message to a ring, if there's a free slot. Safe to call from any number of threads and processes at once.
+ * @returns false if the ring is full (or the payload doesn't fit in a slot)
+ */
+bool tryPushSharedRing(SharedRing &ring, EngineFrameHeader header, const char *payload, uint32_t payloadLength) {
+  if (payloadLength > SHARED_RING_PAYLOAD_BYTES) {
+    return false;
+  }
+  uint64_t position = ring.enqueuePosition.load(std::memory_order_relaxed);
+  SharedRingSlot *slot;
+  while (true) {
+    slot = &ring.slots[position & SHARED_RING_INDEX_MASK];
+    int64_t lag = (int64_t) (slot->sequence.load(std::memory_order_acquire) - position);
+    if (lag == 0) {
+      // The slot is free, so try to claim it
+      if (ring.enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (lag < 0) {
+      return false; // The slot still holds a message from the previous lap, so the ring is full
+    } else {
+      position = ring.enqueuePosition.load(std::memory_order_relaxed); // Another producer claimed it first
+    }
+  }
+  slot->header = header;
+  slot->payloadLength = payloadLength;
+  memcpy(slot->payload, payload, payloadLength);
+  slot->sequence.store(position + 1, std::memory_order_release); // Hands the slot to the consumers
+  return true;
+}
+
+/**
+ * Removes the oldest message from a ring, if there is one. Safe to call from any number of threads and processes at once.
+ * @returns false if the ring is empty
+ */
+bool tryPopSharedRing(SharedRing &ring, OUT EngineFrameHeader &header, OUT std::string &payload) {
+  uint64_t position = ring.dequeuePosition.load(std::memory_order_relaxed);
+  SharedRingSlot *slot;
+  while (true) {
+    slot = &ring.slots[position & SHARED_RING_INDEX_MASK];
+    int64_t lag = (int64_t) (slot->sequence.load(std::memory_order_acquire) - (position + 1));
+    if (lag == 0) {
+      // The slot holds a message, so try to claim it
+      if (ring.dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (lag < 0) {
+      return false; // The slot hasn't been filled yet, so the ring is empty
+    } else {
+      position = ring.dequeuePosition.load(std::memory_order_relaxed); // Another consumer claimed it first
+    }
+  }
+  header = slot->header;
+  payload.assign(slot->payload, std::min(slot->payloadLength, (uint32_t) SHARED_RING_PAYLOAD_BYTES));
+  slot->sequence.store(position + SHARED_RING_NUM_SLOTS, std::memory_order_release); // Frees the slot for the next lap
+  return true;
+}
+
+/** Sleeps between polls of a ring, for a little longer each time, up to SHARED_RING_MAX_BACKOFF_MICROS. */
+void backOffSharedRing(OUT int &numFailedPolls) {
+  numFailedPolls++;
+  if (numFailedPolls < 64) {
+    std::this_thread::yield();
+  } else {
+    int micros = std::min(SHARED_RING_MAX_BACKOFF_MICROS, 1 << std::min(numFailedPolls - 64, 16));
+    std::this_thread::sleep_for(std::chrono::microseconds(micros));
+  }
+}
+
+/** Adds a message to a ring, waiting for a free slot if it's full. The payload must fit in a slot. */
+void pushSharedRing(SharedRing &ring, EngineFrameHeader header, const char *payload, uint32_t payloadLength) {
+  int numFailedPolls = 0;
+  while (!tryPushSharedRing(ring, header, payload, payloadLength)) {
+    backOffSharedRing(numFailedPolls);
+  }
+}
+
+/** Removes the oldest message from a ring, waiting for one if it's empty. */
+void popSharedRing(SharedRing &ring, OUT EngineFrameHeader &header, OUT std::string &payload) {
+  int numFailedPolls = 0;
+  while (!tryPopSharedRing(ring, header, payload)) {
+    backOffSharedRing(numFailedPolls);
+  }
+}
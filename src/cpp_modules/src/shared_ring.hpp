@@ -0,0 +1,68 @@
+#ifndef SHARED_RING
+#define SHARED_RING
+
+#include <atomic>
+#include <stdint.h>
+#include <string>
+#include "engine_server.hpp"
+#include "types.hpp"
+
+/**
+ * A shared-memory transport between Node and the engine server, for when they're on the same machine. The two processes map
+ * the same file, which holds two rings of fixed-size slots: requests (Node -> engine) and responses (engine -> Node). Each slot
+ * carries the same header and payload as a socket frame (see engine_server.hpp), so sending a request costs a copy into a slot and
+ * a few atomic operations, rather than serializing it and passing it through the kernel.
+ *
+ * Each ring is a bounded lock-free queue (Dmitry Vyukov's design): every slot has a sequence number that says whether it's free
+ * for the next producer or holds a message for the next consumer, so any number of producers and consumers can share a ring
+ * without a lock. Requests come from a single client process (SPSC), and responses from any of the engine's workers (MPSC). Since
+ * clients would take each other's responses, only one client process should use a file at a time. A process that dies while it
+ * has claimed a slot stalls the ring, so the server recreates the file on startup.
+ *
+ * Neither side blocks in the kernel: an empty ring is polled with a short backoff.
+ */
+
+#define SHARED_RING_MAGIC 0x52524253 // "SBRR"
+#define SHARED_RING_VERSION 1
+#define SHARED_RING_NUM_SLOTS 64 // Must be a power of 2
+#define SHARED_RING_PAYLOAD_BYTES (16 << 10) // Results are at most ~10KB (GET_TOP_MOVES_HYBRID), and inputs are ~250 bytes
+#define SHARED_RING_MAX_BACKOFF_MICROS 200 // The longest a consumer sleeps between polls of an empty ring
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "The rings' atomics have to work across processes");
+
+struct SharedRingSlot {
+  std::atomic<uint64_t> sequence;
+  EngineFrameHeader header;
+  uint32_t payloadLength;
+  char payload[SHARED_RING_PAYLOAD_BYTES];
+};
+
+struct SharedRing {
+  alignas(64) std::atomic<uint64_t> enqueuePosition; // Each on its own cache line, since producers and consumers write them
+  alignas(64) std::atomic<uint64_t> dequeuePosition;
+  alignas(64) SharedRingSlot slots[SHARED_RING_NUM_SLOTS];
+};
+
+/** The layout of the file. The header fields let a client check that it was built with the same layout as the server. */
+struct SharedRingFile {
+  std::atomic<uint32_t> magic; // Written last when the file is created, so that clients never see a half-initialized file
+  uint32_t version;
+  uint32_t numSlots;
+  uint32_t slotBytes;
+  SharedRing requests;
+  SharedRing responses;
+};
+
+SharedRingFile *createSharedRingFile(std::string const &path);
+
+SharedRingFile *openSharedRingFile(std::string const &path, OUT std::string &error);
+
+bool tryPushSharedRing(SharedRing &ring, EngineFrameHeader header, const char *payload, uint32_t payloadLength);
+
+void pushSharedRing(SharedRing &ring, EngineFrameHeader header, const char *payload, uint32_t payloadLength);
+
+bool tryPopSharedRing(SharedRing &ring, OUT EngineFrameHeader &header, OUT std::string &payload);
+
+void popSharedRing(SharedRing &ring, OUT EngineFrameHeader &header, OUT std::string &payload);
+
+#endif
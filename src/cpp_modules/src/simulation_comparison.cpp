@@ -0,0 +1,120 @@
+#include "simulation_comparison.hpp"
+#include "game_simulation.hpp"
+#include "parallel.hpp"
+#include "tracing.hpp"
+#include <math.h>
+
+#define COMPARISON_Z_95 1.96f
+
+ComparisonSummary summarizeComparison(std::vector<PairedGameResult> const &pairedResults){
+  ComparisonSummary summary = {};
+  summary.numPairs = (int) pairedResults.size();
+  if (summary.numPairs == 0) {
+    return summary;
+  }
+  double totalA = 0;
+  double totalB = 0;
+  for (PairedGameResult const &pair : pairedResults) {
+    totalA += pair.resultA.score;
+    totalB += pair.resultB.score;
+    if (pair.resultA.score > pair.resultB.score) {
+      summary.winsA++;
+    } else if (pair.resultB.score > pair.resultA.score) {
+      summary.winsB++;
+    } else {
+      summary.ties++;
+    }
+  }
+  double meanDiff = (totalA - totalB) / summary.numPairs;
+  double sumSquaredDiffs = 0;
+  for (PairedGameResult const &pair : pairedResults) {
+    double diff = pair.resultA.score - pair.resultB.score;
+    sumSquaredDiffs += (diff - meanDiff) * (diff - meanDiff);
+  }
+  double variance = summary.numPairs > 1 ? sumSquaredDiffs / (summary.numPairs - 1) : 0;
+  double stdError = sqrt(variance / summary.numPairs);
+
+  summary.meanScoreA = (float) (totalA / summary.numPairs);
+  summary.meanScoreB = (float) (totalB / summary.numPairs);
+  summary.meanDiff = (float) meanDiff;
+  summary.stdDevDiff = (float) sqrt(variance);
+  summary.stdErrorDiff = (float) stdError;
+  summary.confidenceLow = (float) (meanDiff - COMPARISON_Z_95 * stdError);
+  summary.confidenceHigh = (float) (meanDiff + COMPARISON_Z_95 * stdError);
+  summary.zScore = stdError > 0 ? (float) (meanDiff / stdError) : 0;
+  return summary;
+}
+
+/**
+ * Both configs play each seed, so they see the exact same piece sequence (the piece RNG doesn't depend on the moves
+ * played). Most of the variance between games comes from the pieces, so it cancels out of the paired difference, and far
+ * fewer games are needed than when comparing the means of independent runs.
+ *
+ * Significance is checked after every batch of games once minPairs have been played. Since the data is looked at
+ * repeatedly, earlyStopZ should be stricter than the usual 1.96 (e.g. ~2.8 keeps the overall false positive rate near 5% for
+ * up to ~10 looks).
+ */
+ComparisonSummary compareEngineConfigs(EngineConfig const &configA,
+                                       EngineConfig const &configB,
+                                       char const *inputFrameTimeline,
+                                       int startingLevel,
+                                       int maxLines,
+                                       unsigned long long baseSeed,
+                                       int minPairs,
+                                       int maxPairs,
+                                       float earlyStopZ,
+                                       int numThreads,
+                                       OUT std::vector<PairedGameResult> &pairedResults){
+  int batchSize = std::max(minPairs, 2 * (numThreads > 0 ? numThreads : getDefaultThreadCount()));
+  ComparisonSummary summary = {};
+  while ((int) pairedResults.size() < maxPairs) {
+    int firstPair = (int) pairedResults.size();
+    int numPairs = std::min(batchSize, maxPairs - firstPair);
+    pairedResults.resize(firstPair + numPairs);
+
+    // Each game of a pair is its own work item, so that both configs' games can run at the same time
+    parallelFor(numPairs * 2, numThreads, [&](int i) {
+      int pairIndex = firstPair + i / 2;
+      bool isConfigA = i % 2 == 0;
+      TraceSpan span(isConfigA ? "simulateGameA" : "simulateGameB", pairIndex);
+      SimulatedGameResult result = simulateGame(inputFrameTimeline,
+                                                startingLevel,
+                                                maxLines,
+                                                /* shouldAdjust= */ false,
+                                                /* reactionTime= */ 21,
+                                                isConfigA ? configA : configB,
+                                                getGameSeed(baseSeed, pairIndex));
+      if (isConfigA) {
+        pairedResults[pairIndex].resultA = result;
+      } else {
+        pairedResults[pairIndex].resultB = result;
+      }
+    });
+
+    summary = summarizeComparison(pairedResults);
+    if (SIMULATION_LOGGING_ENABLED) {
+      printf("After %d pairs: diff=%.0f (z=%.2f)\n", summary.numPairs, summary.meanDiff, summary.zScore);
+    }
+    if (summary.numPairs >= minPairs && fabs(summary.zScore) >= earlyStopZ && summary.numPairs < maxPairs) {
+      summary.stoppedEarly = true;
+      break;
+    }
+  }
+  return summary;
+}
+
+void printComparisonSummary(ComparisonSummary const &summary){
+  printf("Pairs: %d%s\nMean score A: %.0f\nMean score B: %.0f\nMean diff (A - B): %.0f\n95%% CI: [%.0f, %.0f]\nStd dev of diff: %.0f\nz: %.2f\nWins A/B/ties: %d/%d/%d\n",
+         summary.numPairs,
+         summary.stoppedEarly ? " (stopped early)" : "",
+         summary.meanScoreA,
+         summary.meanScoreB,
+         summary.meanDiff,
+         summary.confidenceLow,
+         summary.confidenceHigh,
+         summary.stdDevDiff,
+         summary.zScore,
+         summary.winsA,
+         summary.winsB,
+         summary.ties);
+}
@@ -0,0 +1,27 @@
+#ifndef SIMULATION_COMPARISON
+#define SIMULATION_COMPARISON
+
+#include "types.hpp"
+#include <vector>
+
+/**
+ * Plays two engine configs against the same seeded piece sequences (common random numbers) and compares their scores.
+ * Games are played in batches, and the comparison stops early once the paired difference is significant.
+ */
+ComparisonSummary compareEngineConfigs(EngineConfig const &configA,
+                                       EngineConfig const &configB,
+                                       char const *inputFrameTimeline,
+                                       int startingLevel,
+                                       int maxLines,
+                                       unsigned long long baseSeed,
+                                       int minPairs,
+                                       int maxPairs,
+                                       float earlyStopZ,
+                                       int numThreads,
+                                       OUT std::vector<PairedGameResult> &pairedResults);
+
+ComparisonSummary summarizeComparison(std::vector<PairedGameResult> const &pairedResults);
+
+void printComparisonSummary(ComparisonSummary const &summary);
+
+#endif
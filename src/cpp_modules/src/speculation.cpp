@@ -0,0 +1,206 @@
+#include "speculation.hpp"
+#include "high_level_search.hpp"
+#include "move_result.hpp"
+#include "piece_rng.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+
+std::string getSpeculativeCacheKey(RequestType requestType, std::string const &input) {
+  return std::to_string(requestType) + "/" + input;
+}
+
+/** Formats the start of an input for the board after a placement, up to and including the current piece. */
+std::string getInputStartAfterPlacement(std::string const &input, int level, int lines, int pieceIndex, LockLocation placement, int newCurPieceIndex) {
+  unsigned int board[20];
+  unsigned int newBoard[20];
+  encodeBoard(input.c_str(), board);
+  LockPlacement lockPlacement = {placement.x, placement.y, placement.rotationIndex, NONE, NO_TUCK_NOTATION, &PIECE_LIST[pieceIndex]};
+  int numLinesCleared = getNewBoardAndLinesCleared(board, lockPlacement, newBoard);
+  return formatBoardAsInput(newBoard) + "|" + std::to_string(getLevelAfterLineClears(level, lines, numLinesCleared))
+      + "|" + std::to_string(lines + numLinesCleared) + "|" + std::to_string(newCurPieceIndex) + "|";
+}
+
+/**
+ * Predicts the requests that follow a live request, if the current piece is placed where the engine chose: one for each possible
+ * new next piece, most likely first. The inputs match what a client would send, with the non-piece args copied from the request.
+ *
+ * A GET_LOCK_VALUE_LOOKUP_ALL_NEXT_PIECES request is a precompute for the current piece before the next piece is known, so its
+ * result has a lookup per next piece. Once the next piece shows up, the current piece goes to (usually) the best placement in that
+ * piece's lookup, and the client precomputes the next piece from there. So each possible next piece predicts one follow-up
+ * precompute, with the next piece as the current piece and the same placeholder next piece.
+ * @returns false if nothing can be predicted (e.g. the next piece wasn't known, or the search didn't choose a placement)
+ */
+bool getSpeculativeRequests(RequestType requestType, std::string const &input, SpeculativeResult const &result, OUT std::vector<SpeculativeRequest> &speculativeRequests) {
+  bool isAllNextPieces = requestType == GET_LOCK_VALUE_LOOKUP_ALL_NEXT_PIECES;
+  if ((requestType != GET_MOVE && requestType != GET_LOCK_VALUE_LOOKUP && requestType != GET_LOCK_VALUE_LOOKUP_PACKED && !isAllNextPieces)
+      || (!isAllNextPieces && result.chosenPlacement.x == NONE) || input.length() < 201) {
+    return false;
+  }
+
+  // The args that change are level|lines|currentPiece|nextPiece, and the rest are copied as-is
+  int args[4];
+  size_t start = 201; // The length of the board string + 1 for the delimiter
+  for (int i = 0; i < 4; i++) {
+    size_t end = input.find('|', start);
+    if (end == std::string::npos) {
+      return false;
+    }
+    args[i] = atoi(input.substr(start, end - start).c_str());
+    start = end + 1;
+  }
+  std::string otherArgs = input.substr(start);
+  int level = args[0];
+  int lines = args[1];
+  int curPieceIndex = args[2];
+  int nextPieceIndex = args[3];
+  if (curPieceIndex < 0 || curPieceIndex >= 7 || nextPieceIndex < 0 || nextPieceIndex >= 7) {
+    return false;
+  }
+
+  if (isAllNextPieces) {
+    std::vector<LockValueTable> lockValueTables(7);
+    if (!parseLockValueLookupAllNextPieces(result.result, lockValueTables.data())) {
+      return false;
+    }
+    for (int pieceIndex = 0; pieceIndex < 7; pieceIndex++) {
+      LockLocation bestPlacement = getBestLockLocation(lockValueTables[pieceIndex]);
+      if (bestPlacement.x == NONE) {
+        continue;
+      }
+      std::string newInputStart = getInputStartAfterPlacement(input, level, lines, curPieceIndex, bestPlacement, pieceIndex);
+      speculativeRequests.push_back({requestType, newInputStart + std::to_string(nextPieceIndex) + "|" + otherArgs, transitionProbability[curPieceIndex][pieceIndex]});
+    }
+  } else {
+    std::string newInputStart = getInputStartAfterPlacement(input, level, lines, curPieceIndex, result.chosenPlacement, nextPieceIndex);
+    for (int pieceIndex = 0; pieceIndex < 7; pieceIndex++) {
+      speculativeRequests.push_back({requestType, newInputStart + std::to_string(pieceIndex) + "|" + otherArgs, transitionProbability[nextPieceIndex][pieceIndex]});
+    }
+  }
+  std::stable_sort(speculativeRequests.begin(), speculativeRequests.end(), [](SpeculativeRequest const &a, SpeculativeRequest const &b) {
+    return a.probability > b.probability;
+  });
+  return !speculativeRequests.empty();
+}
+
+bool lookupSpeculativeResult(SpeculativeCache &cache, RequestType requestType, std::string const &input, OUT SpeculativeResult &result) {
+  std::string key = getSpeculativeCacheKey(requestType, input);
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  auto cached = cache.resultsByKey.find(key);
+  if (cached == cache.resultsByKey.end()) {
+    cache.numMisses++;
+    return false;
+  }
+  cache.numHits++;
+  result = cached->second;
+  return true;
+}
+
+/** Stores a result, evicting the oldest results if it would go over the memory budget. */
+void storeSpeculativeResult(SpeculativeCache &cache, std::string const &key, SpeculativeResult const &result) {
+  size_t entryBytes = 2 * key.size() + result.result.size(); // The key is stored in keysByAge too
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  if (entryBytes > cache.maxBytes || cache.resultsByKey.count(key) > 0) {
+    return;
+  }
+  while (cache.numBytes + entryBytes > cache.maxBytes && !cache.keysByAge.empty()) {
+    auto oldest = cache.resultsByKey.find(cache.keysByAge.front());
+    cache.numBytes -= 2 * oldest->first.size() + oldest->second.result.size();
+    cache.resultsByKey.erase(oldest);
+    cache.keysByAge.pop_front();
+  }
+  cache.resultsByKey[key] = result;
+  cache.keysByAge.push_back(key);
+  cache.numBytes += entryBytes;
+}
+
+/**
+ * Cancels the unfinished speculative searches, since a new live request has arrived. If one of them is already running the search
+ * for that request, it's left to finish and the live request takes it over: onMatchingSearchFinished is called with its result.
+ * @param matchingSearchToken - set to the cancellation token of the search that was taken over, or nullptr if there wasn't one
+ * @returns the new generation, for predicting the requests that follow the new one
+ */
+long long cancelSpeculativeSearches(SpeculativeCache &cache,
+                                    RequestType requestType,
+                                    std::string const &input,
+                                    SpeculativeSearchCallback const &onMatchingSearchFinished,
+                                    OUT std::shared_ptr<CancellationToken> &matchingSearchToken) {
+  std::string key = getSpeculativeCacheKey(requestType, input);
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  long long generation = ++cache.generation;
+  matchingSearchToken = nullptr;
+  for (std::shared_ptr<SpeculativeSearch> const &search : cache.unfinishedSearches) {
+    if (matchingSearchToken == nullptr && search->hasStarted && search->key == key) {
+      search->onFinished = onMatchingSearchFinished;
+      search->liveGeneration = generation;
+      matchingSearchToken = search->cancellationToken;
+      cache.numHits++;
+    } else {
+      cancelSearch(search->cancellationToken.get());
+    }
+  }
+  cache.unfinishedSearches.clear();
+  return generation;
+}
+
+/**
+ * Registers a speculative search, so that it can be cancelled or taken over.
+ * @param generation - the generation of the request it was predicted from
+ * @returns the search, or nullptr if a newer live request has already made the prediction stale
+ */
+std::shared_ptr<SpeculativeSearch> registerSpeculativeSearch(SpeculativeCache &cache, long long generation, RequestType requestType, std::string const &input) {
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  if (generation != cache.generation) {
+    return nullptr;
+  }
+  std::shared_ptr<SpeculativeSearch> search(new SpeculativeSearch());
+  search->key = getSpeculativeCacheKey(requestType, input);
+  search->cancellationToken.reset(new CancellationToken());
+  search->hasStarted = false;
+  search->liveGeneration = 0;
+  cache.unfinishedSearches.push_back(search);
+  return search;
+}
+
+/**
+ * Marks a speculative search as running, once a worker picks it up.
+ * @returns false if it was cancelled while it was queued
+ */
+bool beginSpeculativeSearch(SpeculativeCache &cache, std::shared_ptr<SpeculativeSearch> const &search) {
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  if (isSearchCancelled(search->cancellationToken.get())) {
+    return false;
+  }
+  search->hasStarted = true;
+  return true;
+}
+
+/** Stores a finished search's result, and hands it to the live request that took the search over (if any). */
+void finishSpeculativeSearch(SpeculativeCache &cache, std::shared_ptr<SpeculativeSearch> const &search, SpeculativeResult const &result, bool wasCancelled) {
+  SpeculativeSearchCallback onFinished;
+  long long liveGeneration;
+  {
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    auto unfinished = std::find(cache.unfinishedSearches.begin(), cache.unfinishedSearches.end(), search);
+    if (unfinished != cache.unfinishedSearches.end()) {
+      cache.unfinishedSearches.erase(unfinished);
+    }
+    onFinished = search->onFinished;
+    liveGeneration = search->liveGeneration;
+  }
+  if (!wasCancelled) {
+    storeSpeculativeResult(cache, search->key, result);
+  }
+  if (onFinished != nullptr) {
+    onFinished(result, wasCancelled, liveGeneration);
+  }
+}
+
+std::string getSpeculativeCacheStatsJson(SpeculativeCache &cache) {
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  char buf[160];
+  snprintf(buf, sizeof(buf), "{\"hits\": %lld, \"misses\": %lld, \"entries\": %d, \"bytes\": %lld}",
+           cache.numHits, cache.numMisses, (int) cache.resultsByKey.size(), (long long) cache.numBytes);
+  return buf;
+}
@@ -0,0 +1,85 @@
+#ifndef SPECULATION
+#define SPECULATION
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "cancellation.hpp"
+#include "types.hpp"
+
+/**
+ * Speculative searches of the requests that are likely to come next in a live game.
+ *
+ * Each live request is for the current piece with the next piece known. Once the engine has chosen where the current piece goes,
+ * the next request will usually be for the board after that placement, with the next piece as the current piece, and only the
+ * new next piece is unknown. So after answering a request, the engine server searches each of those 7 positions (most likely
+ * first, by transitionProbability) while it would otherwise be idle, and keeps the results in a SpeculativeCache. If the player
+ * places the piece where the engine said, the next request is answered straight from the cache. Precomputes for all next pieces
+ * (GET_LOCK_VALUE_LOOKUP_ALL_NEXT_PIECES) are predicted the same way, from the best placement for each next piece.
+ *
+ * Any new live request makes the unfinished speculative searches stale, so they're cancelled when it arrives. The exception is a
+ * search that's already running for that very request: the live request takes it over, and is answered once it finishes.
+ */
+
+struct SpeculativeRequest {
+  RequestType requestType;
+  std::string input;
+  int probability; // Out of 64, from transitionProbability
+};
+
+struct SpeculativeResult {
+  std::string result;
+  LockLocation chosenPlacement; // So that the searches after a cache hit can be predicted too (ALL_NEXT_PIECES predicts from result)
+};
+
+/**
+ * Called when a speculative search that a live request took over finishes.
+ * @param generation - the generation of the live request, for predicting the requests that follow it
+ */
+typedef std::function<void(SpeculativeResult const &result, bool wasCancelled, long long generation)> SpeculativeSearchCallback;
+
+struct SpeculativeSearch {
+  std::string key;
+  std::shared_ptr<CancellationToken> cancellationToken;
+  bool hasStarted; // Only running searches are taken over, since queued ones would wait behind the live and batch requests
+  SpeculativeSearchCallback onFinished; // Set once a live request has taken the search over
+  long long liveGeneration; // The generation of the live request that took it over
+};
+
+struct SpeculativeCache {
+  std::mutex mutex;
+  std::unordered_map<std::string, SpeculativeResult> resultsByKey;
+  std::deque<std::string> keysByAge; // Oldest first. Old results are for positions further in the past, so they're evicted first.
+  size_t numBytes;
+  size_t maxBytes;
+  long long generation; // Bumped by each live request, which makes the predictions from earlier requests stale
+  std::vector<std::shared_ptr<SpeculativeSearch>> unfinishedSearches; // Not including the ones taken over by a live request
+  long long numHits;
+  long long numMisses;
+
+  SpeculativeCache() : numBytes(0), maxBytes(0), generation(0), numHits(0), numMisses(0) {}
+};
+
+bool getSpeculativeRequests(RequestType requestType, std::string const &input, SpeculativeResult const &result, OUT std::vector<SpeculativeRequest> &speculativeRequests);
+
+bool lookupSpeculativeResult(SpeculativeCache &cache, RequestType requestType, std::string const &input, OUT SpeculativeResult &result);
+
+long long cancelSpeculativeSearches(SpeculativeCache &cache,
+                                    RequestType requestType,
+                                    std::string const &input,
+                                    SpeculativeSearchCallback const &onMatchingSearchFinished,
+                                    OUT std::shared_ptr<CancellationToken> &matchingSearchToken);
+
+std::shared_ptr<SpeculativeSearch> registerSpeculativeSearch(SpeculativeCache &cache, long long generation, RequestType requestType, std::string const &input);
+
+bool beginSpeculativeSearch(SpeculativeCache &cache, std::shared_ptr<SpeculativeSearch> const &search);
+
+void finishSpeculativeSearch(SpeculativeCache &cache, std::shared_ptr<SpeculativeSearch> const &search, SpeculativeResult const &result, bool wasCancelled);
+
+std::string getSpeculativeCacheStatsJson(SpeculativeCache &cache);
+
+#endif
@@ -0,0 +1,133 @@
+#ifndef TRACING
+#define TRACING
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include "config.hpp"
+
+/**
+ * Lightweight timeline tracing of the search phases.
+ *
+ * While tracing is started, each TraceSpan records when it was opened and closed, along with the thread it ran on.
+ * The recorded spans are exported in the Chrome trace_event JSON format, which can be loaded into chrome://tracing
+ * or https://ui.perfetto.dev to see where the time in a request goes (and how evenly it's spread across threads).
+ */
+
+/** One completed span, in the form of a trace_event "complete" event. */
+struct TraceEvent {
+  char const *name;
+  long long startMicros;
+  long long durationMicros;
+  int threadId;
+  int arg; // Optional numeric annotation, e.g. the request type. -1 if unused.
+};
+
+std::atomic<bool> isTracingActive(false);
+std::mutex traceEventsMutex;
+std::vector<TraceEvent> traceEvents;
+std::atomic<int> nextTraceThreadId(1);
+const std::chrono::steady_clock::time_point TRACE_EPOCH = std::chrono::steady_clock::now();
+
+long long getTraceTimestampMicros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - TRACE_EPOCH).count();
+}
+
+/** Gets a small, stable ID for the calling thread (the raw std::thread::id values are unreadable in the trace viewer). */
+int getTraceThreadId() {
+  thread_local int threadId = nextTraceThreadId++;
+  return threadId;
+}
+
+/**
+ * Records a span from construction until either end() is called or the object goes out of scope.
+ * Costs a single atomic load when tracing isn't active.
+ */
+struct TraceSpan {
+  char const *name;
+  long long startMicros;
+  int arg;
+  bool isOpen;
+
+  TraceSpan(char const *spanName, int spanArg = -1) {
+    name = spanName;
+    arg = spanArg;
+    isOpen = TRACING_SUPPORTED && isTracingActive.load(std::memory_order_relaxed);
+    startMicros = isOpen ? getTraceTimestampMicros() : 0;
+  }
+
+  void end() {
+    if (!isOpen) {
+      return;
+    }
+    isOpen = false;
+    TraceEvent event = {name, startMicros, getTraceTimestampMicros() - startMicros, getTraceThreadId(), arg};
+    std::lock_guard<std::mutex> lock(traceEventsMutex);
+    traceEvents.push_back(event);
+  }
+
+  ~TraceSpan() {
+    end();
+  }
+};
+
+/** Discards any previously recorded spans and starts recording new ones. */
+void startTracing() {
+  std::lock_guard<std::mutex> lock(traceEventsMutex);
+  traceEvents.clear();
+  isTracingActive = true;
+}
+
+/** Formats the recorded spans in the Chrome trace_event JSON format. */
+std::string formatTraceEvents(const std::vector<TraceEvent> &events) {
+  std::string output = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  for (const TraceEvent &event : events) {
+    char eventBuf[200];
+    int len = snprintf(eventBuf, 200,
+        "{\"name\":\"%s\",\"cat\":\"search\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%lld,\"dur\":%lld",
+        event.name,
+        event.threadId,
+        event.startMicros,
+        event.durationMicros);
+    output.append(eventBuf, std::min(len, 199));
+    if (event.arg != -1) {
+      output += ",\"args\":{\"value\":" + std::to_string(event.arg) + "}";
+    }
+    output += "},";
+  }
+  if (events.size() > 0) {
+    output.pop_back(); // Remove the last comma
+  }
+  output += "]}";
+  return output;
+}
+
+/**
+ * Stops recording, and returns everything recorded since startTracing() as trace_event JSON.
+ * @param outputPath - if non-empty, the JSON is also written to this file.
+ */
+std::string stopTracing(std::string const &outputPath) {
+  std::vector<TraceEvent> recordedEvents;
+  {
+    std::lock_guard<std::mutex> lock(traceEventsMutex);
+    isTracingActive = false;
+    recordedEvents.swap(traceEvents);
+  }
+  std::string traceJson = formatTraceEvents(recordedEvents);
+  if (outputPath.length() > 0) {
+    FILE *traceFile = fopen(outputPath.c_str(), "w");
+    if (traceFile == NULL) {
+      printf("Unable to open trace file %s\n", outputPath.c_str());
+    } else {
+      fwrite(traceJson.data(), 1, traceJson.length(), traceFile);
+      fclose(traceFile);
+    }
+  }
+  return traceJson;
+}
+
+#endif
@@ -20,12 +20,16 @@
 
 #include <vector>
 
+struct CancellationToken;
+
 enum RequestType {
   GET_LOCK_VALUE_LOOKUP, // Gets a map of all the values for all possible places where the current piece could lock.
   GET_TOP_MOVES, // Gets a list of the top moves, using full playouts. Supports with or without next box.
   GET_TOP_MOVES_HYBRID, // Gets a list of the top moves *BOTH* with and without next box.
   RATE_MOVE, // Compares a player move to the best move, and gives the score for both, with and without next box.
-  GET_MOVE // Gets a single best move for a given scenario, using full playouts. Supports with or without next box.
+  GET_MOVE, // Gets a single best move for a given scenario, using full playouts. Supports with or without next box.
+  GET_LOCK_VALUE_LOOKUP_ALL_NEXT_PIECES, // Gets the GET_LOCK_VALUE_LOOKUP map for each of the 7 possible next pieces (the next piece in the request is ignored).
+  GET_LOCK_VALUE_LOOKUP_PACKED // Gets the GET_LOCK_VALUE_LOOKUP map in a packed binary form (see packLockValueTable).
 };
 
 struct Piece {
@@ -97,6 +101,20 @@ struct LockLocation {
 
 const LockLocation NULL_LOCK_LOCATION = {NONE, NONE, NONE};
 
+/** Lock positions span 4 rotations, x in [-2, 7] and y in [-2, 19], so a value for every one of them fits in a small dense table. */
+const int LOCK_TABLE_MIN_X = -2;
+const int LOCK_TABLE_NUM_X = 10;
+const int LOCK_TABLE_MIN_Y = -2;
+const int LOCK_TABLE_NUM_Y = 22;
+const int LOCK_TABLE_SIZE = 4 * LOCK_TABLE_NUM_X * LOCK_TABLE_NUM_Y;
+
+/** The value of each first lock position in a lock value lookup, indexed by getLockTableIndex(). */
+struct LockValueTable {
+  float values[LOCK_TABLE_SIZE];
+  int repeats[LOCK_TABLE_SIZE];
+  bool isPresent[LOCK_TABLE_SIZE];
+};
+
 enum AiMode {
   STANDARD,
   DIG,
@@ -104,6 +122,7 @@ enum AiMode {
   NEAR_KILLSCREEN,
   DIRTY_NEAR_KILLSCREEN,
 };
+const int NUM_AI_MODES = 5;
 
 /**
  * The relative weights of all the eval factors.
@@ -127,13 +146,39 @@ struct FastEvalWeights {
   float unableToBurnCoef;
 };
 
+/** The eval weights for every AI mode, indexed by AiMode. Passed in at runtime so that weights can be tuned without recompiling. */
+struct EvalWeightSet {
+  FastEvalWeights weightsByMode[NUM_AI_MODES];
+};
+
+struct ReachabilityOracle; // Defined in reachability_oracle.hpp
+
+#define MAX_INPUT_TIMELINE_LENGTH 64 // Longer timelines are truncated. It's a bitmask, so this can't exceed 64.
+#define NUM_SCHEDULED_INPUTS 8
+
+/**
+ * An input frame timeline (e.g. "X....", which loops) compiled into lookup tables, so that the move search can step from one
+ * input to the next without re-reading the string on every frame.
+ */
+struct InputFrameSchedule {
+  int period; // The length of the timeline loop
+  int inputsPerPeriod;
+  int singleInputPeriod; // If the timeline is one input frame followed by empty frames (e.g. "X..."), its length. Otherwise 0.
+  unsigned long long inputMask; // Bit N is set if frame N of the loop is an input frame
+  int framesUntilInput[MAX_INPUT_TIMELINE_LENGTH]; // For each frame of the loop, the number of frames until the next input frame (0 if it is one)
+  int inputsBeforeFrame[MAX_INPUT_TIMELINE_LENGTH + 1]; // For each frame of the loop, the number of input frames earlier in the loop
+  int frameOfInput[NUM_SCHEDULED_INPUTS]; // The frame that the Nth input of a piece happens on
+  int rowsFallenBeforeInput[4][NUM_SCHEDULED_INPUTS]; // How far the piece has fallen before its Nth input. Indexed like the piece range context lookup (0 = double killscreen, otherwise the gravity)
+  const ReachabilityOracle *reachabilityOracle; // Shared by every schedule with the same timeline. NULL if disabled.
+};
+
 /**
  * Precomputed meta-information related to tapping speed and piece reachability.
  * Considered "global" because the tapping speed does not change within the lifetime of one query to the C++ module
  * (whereas the eval context can change based on the AiMode).
  */
 struct PieceRangeContext {
-  char const *inputFrameTimeline;
+  const InputFrameSchedule *inputSchedule;
   int yValueOfEachShift[7];
   int max4TapHeight;
   int max5TapHeight;
@@ -141,6 +186,12 @@ struct PieceRangeContext {
   int maxAccessibleRightSurface[10];
 };
 
+/** The range contexts for the 4 possible gravity values, along with the schedule they point into. Shared by every position with the same timeline. */
+struct SharedRangeContexts {
+  InputFrameSchedule inputSchedule;
+  PieceRangeContext pieceRangeContextLookup[4];
+};
+
 /**
  * A collection of meta-information that dictates how boards are evaluated.
  * Notably excludes any context that depends primarily on the tapping speed and level (which would be included in the global context)
@@ -148,6 +199,7 @@ struct PieceRangeContext {
 struct EvalContext {
   AiMode aiMode;
   FastEvalWeights weights;
+  const EvalWeightSet *weightSet; // The set that 'weights' was picked from, used when switching modes mid-playout
   PieceRangeContext pieceRangeContext;
   int countWellHoles;
   float maxDirtyTetrisHeight;
@@ -155,6 +207,14 @@ struct EvalContext {
   float scareHeight;
   int shouldRewardLineClears;
   int wellColumn; // Equals -1 if lining out
+  const CancellationToken *cancellationToken; // If non-NULL, the search stops doing playouts once this is cancelled
+};
+
+/** A placement of the first piece in a 2-ply search, along with the state it leads to. */
+struct FirstPlyResult {
+  LockPlacement placement;
+  GameState resultingState;
+  float reward;
 };
 
 struct Possibility {
@@ -173,6 +233,12 @@ struct PlayoutData {
   unsigned int resultingBoard[20];
 };
 
+/** The score of one completed playout, along with its index into the playout piece sequences so that it can be replayed. */
+struct PlayoutScoreEntry {
+  float score;
+  int playoutIndex;
+};
+
 /** A data model for a move, as it relates to being part of an API response for the list of top moves */
 struct EngineMoveData {
   LockLocation firstPlacement;
@@ -189,4 +255,66 @@ struct EngineMoveData {
   PlayoutData playout7; // Worst case
 };
 
+/** The search settings the engine plays with. Simulations take one of these so that different settings can be compared. */
+struct EngineConfig {
+  int playoutCount;
+  int playoutLength;
+  int pruningBreadth;
+  const EvalWeightSet *weightSet;
+};
+
+/** The outcome of one simulated game. */
+struct SimulatedGameResult {
+  unsigned long long seed; // Determines the piece sequence, so the game can be replayed exactly
+  int score;
+  int lines;
+  int deathLevel; // The level the game ended on (either by topping out or reaching the line cap)
+  int numPieces;
+};
+
+/** A position reached in a simulated game, just before the current piece is placed. */
+struct SimulatedPosition {
+  unsigned int board[20];
+  int level;
+  int lines;
+  int curPieceIndex;
+  int nextPieceIndex;
+};
+
+/** Aggregate statistics over a batch of simulated games. */
+struct SimulationSummary {
+  int numGames;
+  float meanScore;
+  float stdDevScore;
+  float stdErrorScore; // Standard error of the mean score
+  int medianScore;
+  int minScore;
+  int maxScore;
+  float meanLines;
+  float meanDeathLevel;
+};
+
+/** A pair of simulated games played on the same piece sequence by two different engine configs. */
+struct PairedGameResult {
+  SimulatedGameResult resultA;
+  SimulatedGameResult resultB;
+};
+
+/** Statistics on the score difference (A - B) over a set of paired games. */
+struct ComparisonSummary {
+  int numPairs;
+  float meanScoreA;
+  float meanScoreB;
+  float meanDiff;
+  float stdDevDiff;
+  float stdErrorDiff;
+  float confidenceLow; // 95% confidence interval on meanDiff
+  float confidenceHigh;
+  float zScore; // meanDiff / stdErrorDiff
+  int winsA;
+  int winsB;
+  int ties;
+  bool stoppedEarly; // Whether the comparison reached significance before playing the maximum number of games
+};
+
 #endif
@@ -4,6 +4,7 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <random>
+#include <string>
 #include "./config.hpp"
 
 // Shifts a variable X by Y places, either left or right depending on the sign
@@ -135,20 +136,22 @@ void encodeBoard(char const *boardStr, unsigned int outBoard[20]) {
   }
 }
 
-void copyBoard(unsigned int sourceBoard[20], unsigned int destBoard[20]){
-  for (int i = 0; i < 20; i++){
-    destBoard[i] = sourceBoard[i];
+/** Formats a board the way request inputs encode it: 200 '0'/'1' characters, row by row from the top (the inverse of encodeBoard). */
+std::string formatBoardAsInput(const unsigned int board[20]) {
+  std::string boardStr(200, '0');
+  for (int i = 0; i < 20; i++) {
+    for (int j = 0; j < 10; j++) {
+      if (board[i] & (1U << (9 - j))) {
+        boardStr[i * 10 + j] = '1';
+      }
+    }
   }
+  return boardStr;
 }
 
-void getSurfaceArray(unsigned int board[20], int outSurface[10]) {
-  for (int col = 0; col < 10; col++) {
-    int colMask = 1 << (9 - col);
-    int row = 0;
-    while (!(board[row] & colMask) && row < 20) {
-      row++;
-    }
-    outSurface[col] = 20 - row;
+void copyBoard(unsigned int sourceBoard[20], unsigned int destBoard[20]){
+  for (int i = 0; i < 20; i++){
+    destBoard[i] = sourceBoard[i];
   }
 }
 
@@ -186,34 +189,24 @@ bool isGravityDoubled(int level){
   return (DOUBLE_KILLSCREEN_ENABLED && level >= 39) || DEBUG_DOUBLE_KS_ALWAYS_ENABLED;
 }
 
-/**
- * Given a string such as X.... that represents a loop of which frames are allowed for inputs,
- * determines if a given frame index is an input frame
- */
-int shouldPerformInputsThisFrame(int frameIndex, char const *inputFrameTimeline) {
-  int len = (int) strlen(inputFrameTimeline);
-  int index = frameIndex % len;
-  return inputFrameTimeline[index] == 'X';
+/** Determines if a given frame index is an input frame, according to a compiled input frame timeline. */
+int shouldPerformInputsThisFrame(int frameIndex, const InputFrameSchedule *inputSchedule) {
+  return (inputSchedule->inputMask >> (frameIndex % inputSchedule->period)) & 1;
 }
 
-SimState predictStateAtAdjustmentTime(LockPlacement placement, char const *inputFrameTimeline, int gravity, bool gravityDoubled, int reactionTimeFrames){
-  // Figure out how many frames of input will have elapsed
-  // At the same time, calculate the Y value at adjustment time
-  int inputsPerformed = 0;
-  int adjTimeY = placement.piece->initialY;
-  for (int frame = 0; frame < reactionTimeFrames; frame++) {
-    if (shouldPerformInputsThisFrame(frame, inputFrameTimeline)) {
-      inputsPerformed++;
-    }
-    // On double killscreen, increment gravity twice every frame
-    if (gravityDoubled){
-      adjTimeY += 2;
-    }
-    // Returns true every Nth frame, where N = gravity 
-    else if (frame % gravity == gravity - 1) {
-      adjTimeY++;
-    }
-  }
+/** Counts the input frames in the first numFrames frames of a piece. */
+int countInputFramesBefore(int numFrames, const InputFrameSchedule *inputSchedule) {
+  return (numFrames / inputSchedule->period) * inputSchedule->inputsPerPeriod
+         + inputSchedule->inputsBeforeFrame[numFrames % inputSchedule->period];
+}
+
+SimState predictStateAtAdjustmentTime(LockPlacement placement, const InputFrameSchedule *inputSchedule, int gravity, bool gravityDoubled, int reactionTimeFrames){
+  // Figure out how many frames of input will have elapsed, and the Y value at adjustment time
+  int inputsPerformed = countInputFramesBefore(reactionTimeFrames, inputSchedule);
+  int adjTimeY = placement.piece->initialY
+                 + (gravityDoubled
+                    ? 2 * reactionTimeFrames // On double killscreen, gravity increments twice every frame
+                    : reactionTimeFrames / gravity); // Otherwise it increments every Nth frame, where N = gravity
   if (adjTimeY > placement.y) {
     return {};
   }
@@ -273,29 +266,33 @@ void insertIntoList(EngineMoveData newData, OUT std::list<EngineMoveData> &sorte
   }
 }
 
-/** Performs the insertion operation from insertion sort. */
-void insertIntoList(PlayoutData newData, OUT std::vector<PlayoutData> *sortedList){
-  // printf("inserting into list %d %d\n", newData.firstPlacement.x, newData.firstPlacement.rotationIndex);
-  // Insert into the list in its correct sorted place
-  for (auto ptr = sortedList->begin(); true; ptr++) {
-    if (ptr == sortedList->end()) {
-      sortedList->push_back(newData);
-      break;
-    }
-    if (newData.totalScore > ptr->totalScore) {
-      sortedList->insert(ptr, newData);
-      break;
-    }
-  }
-}
-
-/** Random number generator taken from StackOverflow */
+/** Random number generator taken from StackOverflow. The generator is seeded once per thread, rather than on every call. */
 template<typename T>
 T qualityRandom(T range_from, T range_to) {
-  std::random_device rand_dev;
-  std::mt19937 generator(rand_dev());
+  thread_local std::mt19937 generator(std::random_device{}());
   std::uniform_int_distribution<T>    distr(range_from, range_to - 1);
   return distr(generator);
 }
 
+/**
+ * A small, fast, seedable PRNG (splitmix64).
+ * Used wherever results need to be reproducible from a seed, e.g. the piece sequences of simulated games.
+ */
+struct FastRandom {
+  unsigned long long state;
+};
+
+unsigned long long nextRandom(FastRandom &rng) {
+  unsigned long long z = (rng.state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+/** Gets a random int in [rangeFrom, rangeTo), like qualityRandom. */
+int fastRandomInRange(FastRandom &rng, int rangeFrom, int rangeTo) {
+  unsigned long long range = (unsigned long long) (rangeTo - rangeFrom);
+  return rangeFrom + (int) (((nextRandom(rng) >> 32) * range) >> 32);
+}
+
 #endif
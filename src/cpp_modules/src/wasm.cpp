@@ -3,12 +3,26 @@
 
 #undef NONE
 #include <emscripten/bind.h>
+#include <emscripten/val.h>
 
 std::string wasmGetLockValueLookup(std::string inputStr) {
     const char* cInputStr = inputStr.c_str();
     return mainProcess(cInputStr, GET_LOCK_VALUE_LOOKUP);
 }
 
+emscripten::val wasmGetLockValueLookupPacked(std::string inputStr) {
+    const char* cInputStr = inputStr.c_str();
+    std::string result = mainProcess(cInputStr, GET_LOCK_VALUE_LOOKUP_PACKED);
+    // Copy the binary result into a Uint8Array (embind would otherwise decode it as a UTF-8 string)
+    emscripten::val view(emscripten::typed_memory_view(result.size(), (const unsigned char *) result.data()));
+    return emscripten::val::global("Uint8Array").new_(view);
+}
+
+std::string wasmGetLockValueLookupAllNextPieces(std::string inputStr) {
+    const char* cInputStr = inputStr.c_str();
+    return mainProcess(cInputStr, GET_LOCK_VALUE_LOOKUP_ALL_NEXT_PIECES);
+}
+
 std::string wasmGetMove(std::string inputStr) {
     const char* cInputStr = inputStr.c_str();
     return mainProcess(cInputStr, GET_MOVE);
@@ -29,12 +43,72 @@ std::string wasmRateMove(std::string inputStr) {
     return mainProcess(cInputStr, RATE_MOVE);
 }
 
+std::string wasmAnalyzeGame(std::string inputStr) {
+    const char* cInputStr = inputStr.c_str();
+    return analyzeGame(cInputStr);
+}
+
+std::vector<std::string> wasmEvaluateBatch(std::vector<std::string> inputStrs, std::vector<int> requestTypeInts) {
+    std::vector<RequestType> requestTypes;
+    for (int requestType : requestTypeInts) {
+        requestTypes.push_back((RequestType) requestType);
+    }
+    return mainProcessBatch(inputStrs, requestTypes);
+}
+
+void wasmStartTrace() {
+    startTracing();
+}
+
+std::string wasmStopTrace() {
+    // There's no filesystem to write to in the browser, so the trace is only returned
+    return stopTracing("");
+}
+
+bool wasmLoadDataBlob(std::string blob) {
+    // Embind copies the Uint8Array that the blob was fetched into
+    return loadDataBlob(blob.data(), blob.size());
+}
+
+bool wasmIsDataTableLoaded(int tableId) {
+    return isDataTableLoaded((DataTableId) tableId);
+}
+
+bool wasmUsesSimdKernels() {
+    return BOARD_KERNELS_USE_SIMD;
+}
+
+int wasmCheckBoardKernels(int numBoards) {
+    return checkBoardKernels(numBoards, /* seed= */ 0);
+}
+
+int wasmGetThreadCount() {
+#ifdef __EMSCRIPTEN_PTHREADS__
+    return getDefaultThreadCount();
+#else
+    return 1;
+#endif
+}
+
 
 EMSCRIPTEN_BINDINGS(my_module) {
     emscripten::function("getLockValueLookup", &wasmGetLockValueLookup);
+    emscripten::function("getLockValueLookupPacked", &wasmGetLockValueLookupPacked);
+    emscripten::function("getLockValueLookupAllNextPieces", &wasmGetLockValueLookupAllNextPieces);
+    emscripten::register_vector<std::string>("StringList");
+    emscripten::register_vector<int>("IntList");
+    emscripten::function("evaluateBatch", &wasmEvaluateBatch);
+    emscripten::function("analyzeGame", &wasmAnalyzeGame);
     emscripten::function("getMove", &wasmGetMove);
     emscripten::function("getTopMoves", &wasmGetTopMoves);
     emscripten::function("getTopMovesHybrid", &wasmGetTopMovesHybrid);
     emscripten::function("rateMove", &wasmRateMove);
+    emscripten::function("startTrace", &wasmStartTrace);
+    emscripten::function("stopTrace", &wasmStopTrace);
+    emscripten::function("getThreadCount", &wasmGetThreadCount);
+    emscripten::function("loadDataBlob", &wasmLoadDataBlob);
+    emscripten::function("isDataTableLoaded", &wasmIsDataTableLoaded);
+    emscripten::function("usesSimdKernels", &wasmUsesSimdKernels);
+    emscripten::function("checkBoardKernels", &wasmCheckBoardKernels);
 }
 
@@ -0,0 +1,211 @@
+#include "weight_optimizer.hpp"
+#include "game_simulation.hpp"
+#include "parallel.hpp"
+#include "tracing.hpp"
+#include <algorithm>
+#include <math.h>
+#include <vector>
+
+/** The coefficients the optimizer is allowed to change. The death penalty is left fixed, since it sets the scale of the others. */
+float FastEvalWeights::* const TUNABLE_COEFS[] = {
+  &FastEvalWeights::avgHeightCoef,
+  &FastEvalWeights::builtOutLeftCoef,
+  &FastEvalWeights::burnCoef,
+  &FastEvalWeights::coveredWellCoef,
+  &FastEvalWeights::col9Coef,
+  &FastEvalWeights::extremeGapCoef,
+  &FastEvalWeights::holeCoef,
+  &FastEvalWeights::holeWeightCoef,
+  &FastEvalWeights::inaccessibleLeftCoef,
+  &FastEvalWeights::inaccessibleRightCoef,
+  &FastEvalWeights::tetrisCoef,
+  &FastEvalWeights::tetrisReadyCoef,
+  &FastEvalWeights::surfaceCoef,
+  &FastEvalWeights::surfaceLeftCoef,
+  &FastEvalWeights::unableToBurnCoef,
+};
+const int NUM_TUNABLE_COEFS = sizeof(TUNABLE_COEFS) / sizeof(TUNABLE_COEFS[0]);
+
+/** The params.hpp constant holding each mode's weights, indexed by AiMode. */
+char const * const WEIGHT_CONSTANT_NAMES[NUM_AI_MODES] = {
+  "MAIN_WEIGHTS",
+  "DIG_WEIGHTS",
+  "LINEOUT_WEIGHTS",
+  "NEAR_KILLSCREEN_WEIGHTS",
+  "DIRTY_NEAR_KILLSCREEN_WEIGHTS",
+};
+
+/** One member of a generation, along with its fitness (mean score over the generation's seeds). */
+struct WeightCandidate {
+  FastEvalWeights weights;
+  float noise[NUM_TUNABLE_COEFS]; // The standard normal sample this candidate was generated from
+  float fitness;
+};
+
+/** Samples a standard normal via the Box-Muller transform. */
+float gaussianRandom(FastRandom &rng) {
+  double u1 = ((nextRandom(rng) >> 11) + 1) * (1.0 / 9007199254740993.0); // In (0, 1], so the log is finite
+  double u2 = (nextRandom(rng) >> 11) * (1.0 / 9007199254740992.0);
+  return (float) (sqrt(-2 * log(u1)) * cos(2 * M_PI * u2));
+}
+
+/**
+ * Each generation samples populationSize candidates around the current weights, with per-coefficient Gaussian noise
+ * scaled to the coefficient's starting magnitude (so that e.g. deathCoef-sized and unableToBurnCoef-sized weights both
+ * move by a similar relative amount). The current weights are re-scored alongside the candidates on the same seeds, and
+ * the next weights are a rank-weighted average of the best half of the candidates. The step size follows the 1/5th
+ * success rule: it grows while many candidates beat the current weights, and shrinks once few do.
+ *
+ * All (candidate, game) pairs of a generation are spread over the threads at once, which keeps every core busy even
+ * with a small population.
+ */
+EvalWeightSet optimizeWeights(EvalWeightSet const &startingWeights,
+                              EngineConfig const &engineConfig,
+                              char const *inputFrameTimeline,
+                              int startingLevel,
+                              int maxLines,
+                              int numGenerations,
+                              int populationSize,
+                              int gamesPerCandidate,
+                              float initialStepSize,
+                              unsigned long long baseSeed,
+                              int numThreads){
+  EvalWeightSet currentSet = startingWeights;
+  FastEvalWeights &currentWeights = currentSet.weightsByMode[STANDARD];
+  float coefScales[NUM_TUNABLE_COEFS];
+  for (int c = 0; c < NUM_TUNABLE_COEFS; c++) {
+    coefScales[c] = std::max(1.0f, fabsf(currentWeights.*TUNABLE_COEFS[c]));
+  }
+
+  // Log-rank recombination weights for the best half, as in CMA-ES
+  int numParents = std::max(1, populationSize / 2);
+  std::vector<float> recombinationWeights(numParents);
+  float totalRecombinationWeight = 0;
+  for (int i = 0; i < numParents; i++) {
+    recombinationWeights[i] = (float) (log(numParents + 0.5) - log(i + 1));
+    totalRecombinationWeight += recombinationWeights[i];
+  }
+
+  FastRandom noiseRng = {baseSeed ^ 0xA5A5A5A5A5A5A5A5ULL};
+  float stepSize = initialStepSize;
+  // Every candidate needs its own weight set to live somewhere stable while the games run, since the eval context points to it
+  std::vector<EvalWeightSet> generationSets(populationSize + 1, currentSet);
+  std::vector<WeightCandidate> candidates(populationSize);
+  std::vector<SimulatedGameResult> gameResults((populationSize + 1) * gamesPerCandidate);
+
+  for (int generation = 0; generation < numGenerations; generation++) {
+    TraceSpan generationSpan("optimizerGeneration", generation);
+
+    // Sample the candidates. The last weight set is the current weights, as the baseline for this generation's seeds.
+    for (int i = 0; i < populationSize; i++) {
+      WeightCandidate &candidate = candidates[i];
+      candidate.weights = currentWeights;
+      for (int c = 0; c < NUM_TUNABLE_COEFS; c++) {
+        candidate.noise[c] = gaussianRandom(noiseRng);
+        candidate.weights.*TUNABLE_COEFS[c] += stepSize * coefScales[c] * candidate.noise[c];
+      }
+      generationSets[i] = currentSet;
+      generationSets[i].weightsByMode[STANDARD] = candidate.weights;
+    }
+    generationSets[populationSize] = currentSet;
+
+    // Play every candidate's games in parallel, with new seeds each generation so that the weights don't overfit to a few games
+    unsigned long long generationSeed = getGameSeed(baseSeed, generation);
+    parallelFor((populationSize + 1) * gamesPerCandidate, numThreads, [&](int i) {
+      int candidateIndex = i / gamesPerCandidate;
+      int gameIndex = i % gamesPerCandidate;
+      EngineConfig candidateConfig = engineConfig;
+      candidateConfig.weightSet = &generationSets[candidateIndex];
+      TraceSpan span("simulateGame", candidateIndex);
+      gameResults[i] = simulateGame(inputFrameTimeline, startingLevel, maxLines, /* shouldAdjust= */ false, /* reactionTime= */ 21, candidateConfig, getGameSeed(generationSeed, gameIndex));
+    });
+
+    // Score each candidate
+    float currentFitness = 0;
+    for (int candidateIndex = 0; candidateIndex <= populationSize; candidateIndex++) {
+      double totalScore = 0;
+      for (int gameIndex = 0; gameIndex < gamesPerCandidate; gameIndex++) {
+        totalScore += gameResults[candidateIndex * gamesPerCandidate + gameIndex].score;
+      }
+      float fitness = (float) (totalScore / gamesPerCandidate);
+      if (candidateIndex == populationSize) {
+        currentFitness = fitness;
+      } else {
+        candidates[candidateIndex].fitness = fitness;
+      }
+    }
+    std::sort(candidates.begin(), candidates.end(), [](WeightCandidate const &a, WeightCandidate const &b) {
+      return a.fitness > b.fitness;
+    });
+    int numSuccesses = 0;
+    for (WeightCandidate const &candidate : candidates) {
+      if (candidate.fitness > currentFitness) {
+        numSuccesses++;
+      }
+    }
+
+    // Move the current weights towards the best candidates
+    for (int c = 0; c < NUM_TUNABLE_COEFS; c++) {
+      float weightedNoise = 0;
+      for (int i = 0; i < numParents; i++) {
+        weightedNoise += recombinationWeights[i] * candidates[i].noise[c];
+      }
+      currentWeights.*TUNABLE_COEFS[c] += stepSize * coefScales[c] * weightedNoise / totalRecombinationWeight;
+    }
+    float successRate = (float) numSuccesses / populationSize;
+    stepSize *= (float) exp((successRate - 0.2) / 0.8);
+
+    printf("Generation %d: current=%.0f best=%.0f successes=%d/%d stepSize=%.3f\n",
+           generation, currentFitness, candidates[0].fitness, numSuccesses, populationSize, stepSize);
+    if (SIMULATION_LOGGING_ENABLED) {
+      printWeights(WEIGHT_CONSTANT_NAMES[STANDARD], currentWeights);
+    }
+  }
+  return currentSet;
+}
+
+/** Prints the weights as a params.hpp declaration, so that they can be pasted in directly. */
+void printWeights(char const *constantName, FastEvalWeights const &weights){
+  printf("const FastEvalWeights %s = {\n"
+         "  /* avgHeightCoef= */ %g,\n"
+         "  /* builtOutLeftCoef= */ %g,\n"
+         "  /* burnCoef= */ %g,\n"
+         "  /* coveredWellCoef= */ %g,\n"
+         "  /* col9Coef= */ %g,\n"
+         "  /* deathCoef= */ %g,\n"
+         "  /* extremeGapCoef= */ %g,\n"
+         "  /* holeCoef= */ %g,\n"
+         "  /* holeWeightCoef= */ %g,\n"
+         "  /* inaccessibleLeftCoef= */ %g,\n"
+         "  /* inaccessibleRightCoef= */ %g,\n"
+         "  /* tetrisCoef= */ %g,\n"
+         "  /* tetrisReadyCoef= */ %g,\n"
+         "  /* surfaceCoef= */ %g,\n"
+         "  /* surfaceLeftCoef= */ %g,\n"
+         "  /* unableToBurnCoef= */ %g\n"
+         "};\n",
+         constantName,
+         weights.avgHeightCoef,
+         weights.builtOutLeftCoef,
+         weights.burnCoef,
+         weights.coveredWellCoef,
+         weights.col9Coef,
+         weights.deathCoef,
+         weights.extremeGapCoef,
+         weights.holeCoef,
+         weights.holeWeightCoef,
+         weights.inaccessibleLeftCoef,
+         weights.inaccessibleRightCoef,
+         weights.tetrisCoef,
+         weights.tetrisReadyCoef,
+         weights.surfaceCoef,
+         weights.surfaceLeftCoef,
+         weights.unableToBurnCoef);
+}
+
+void printWeightSet(EvalWeightSet const &weightSet){
+  for (int mode = 0; mode < NUM_AI_MODES; mode++) {
+    printWeights(WEIGHT_CONSTANT_NAMES[mode], weightSet.weightsByMode[mode]);
+    printf("\n");
+  }
+}
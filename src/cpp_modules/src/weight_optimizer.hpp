@@ -0,0 +1,29 @@
+#ifndef WEIGHT_OPTIMIZER
+#define WEIGHT_OPTIMIZER
+
+#include "types.hpp"
+
+/**
+ * Tunes the STANDARD mode eval weights with an evolution strategy, scoring each candidate by simulating full games with
+ * the real engine. Every candidate in a generation plays the same seeds, so candidates are ranked on equal footing.
+ * The other modes are not tuned, and are passed through unchanged.
+ * @returns the starting weight set, with the STANDARD weights replaced by the tuned ones
+ */
+EvalWeightSet optimizeWeights(EvalWeightSet const &startingWeights,
+                              EngineConfig const &engineConfig,
+                              char const *inputFrameTimeline,
+                              int startingLevel,
+                              int maxLines,
+                              int numGenerations,
+                              int populationSize,
+                              int gamesPerCandidate,
+                              float initialStepSize,
+                              unsigned long long baseSeed,
+                              int numThreads);
+
+void printWeights(char const *constantName, FastEvalWeights const &weights);
+
+/** Prints every mode's weights as params.hpp declarations. */
+void printWeightSet(EvalWeightSet const &weightSet);
+
+#endif
@@ -0,0 +1,519 @@
+/* rabbitengine.cpp, as a part of the StackRabbit AI project.
+ *
+ * A Lua module that links the engine directly into the emulator, instead of sending each request over HTTP to the Node server
+ * (see rabbithttp.c). Requests are searched on a background thread, and the script polls for their results once a frame, so the
+ * emulator never blocks on a search and a move costs only the search time.
+ *
+ * Command to compile (from this directory):
+ *    g++ -std=c++17 -O3 -pthread -shared -fPIC -o rabbitengine.so rabbitengine.cpp -I/usr/local/include/lua5.1 -llua5.1
+ *
+ * As with rabbithttp, the word "rabbitengine" has to match the name of the .so and the function luaopen_rabbitengine().
+ *
+ * Functions available to Lua:
+ *    engineGetMoveAsync(board, currentPiece, nextPiece, level, lines, inputFrameTimeline, reactionTimeFrames) -> requestId
+ *        Searches for the best placement (the in-process version of get-move-async, for the first piece). The pieces are letters
+ *        (e.g. "T"), and nextPiece can be "none". The piece is expected to be left alone for the first reactionTimeFrames frames
+ *        (default 0) while the search runs, so the placement is picked from the ones still reachable from there, and the input
+ *        sequence starts on that frame. The result is formatted like the Node server's get-move response:
+ *        "rot,xOffset,yOffset|inputSequence|boardAfter|levelAfter|linesAfter".
+ *    enginePrecomputeAsync(board, currentPiece, level, lines, inputFrameTimeline, reactionTimeFrames) -> requestId
+ *        The in-process version of the Node server's precompute, for a piece whose next piece isn't known yet. The result is
+ *        formatted the same way: an initial placement ("Default:<move>") whose inputs start on the piece's first frame, then an
+ *        adjustment for each next piece ("T:<move>"), whose inputs start once the reaction time is up. An adjustment of
+ *        "No legal moves" means the initial placement is already the best one for that next piece.
+ *    engineRequestAsync(requestType, inputStr) -> requestId
+ *        Runs any request, with the same RequestType and input string as the Node module takes.
+ *    enginePollResult(requestId) -> the result, or nil if it isn't ready yet. Each result can only be polled once.
+ *    engineWaitResult(requestId) -> the result, once it's ready (blocking the emulator until then, like the HTTP requests do), or
+ *        nil if the request was cancelled. Each result can only be fetched once.
+ *    engineCancel(requestId) -> cancels a request that's no longer needed, and discards its result
+ */
+
+extern "C" {
+#include <lua.h>
+#include <lauxlib.h>
+#include <lualib.h>
+}
+
+#include <condition_variable>
+#include <deque>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include "../cpp_modules/src/main.cpp"
+
+#define PIECE_LETTERS "IOLJTSZ" // In the order of PIECE_LIST
+
+// The penalties for the inputs of an adjustment, the same as getAdjustmentInputCost() in precompute.ts
+#define SHIFT_AND_ROTATE_INPUT_COST -0.3f
+#define ROTATE_INPUT_COST -0.2f
+#define SHIFT_INPUT_COST -0.1f
+#define NO_ADJUSTMENT_VALUE -1e9f // The value of a next piece that has no placement, which rules out the initial placement
+
+struct LuaEngineJob {
+  int requestId;
+  RequestType requestType;
+  std::string input;
+  std::shared_ptr<CancellationToken> cancellationToken;
+
+  // For moves requested by engineGetMoveAsync() and enginePrecomputeAsync(), which are formatted for the script. Otherwise
+  // curPieceIndex is -1.
+  int curPieceIndex;
+  int level;
+  int lines;
+  std::string inputFrameTimeline;
+  int reactionTimeFrames;
+};
+
+/** The requests waiting for the background thread, and the results that the script hasn't polled yet. */
+struct LuaEngineState {
+  std::mutex mutex;
+  std::condition_variable hasJobs;
+  std::deque<LuaEngineJob> jobs;
+  std::unordered_map<int, std::shared_ptr<CancellationToken>> unfinishedRequests;
+  std::unordered_map<int, std::string> results;
+  std::condition_variable hasResults;
+  int nextRequestId = 1;
+  bool isWorkerStarted = false;
+};
+
+// Never destroyed, since the worker thread is still waiting on it when the emulator exits
+LuaEngineState &luaEngineState = *new LuaEngineState();
+
+int getPieceIndexFromLetter(char const *letter) {
+  char const *found = strchr(PIECE_LETTERS, letter[0]);
+  return letter[0] != '\0' && found != NULL ? (int) (found - PIECE_LETTERS) : -1;
+}
+
+/**
+ * Generates the inputs that shift and rotate a piece into place, one character per frame (the same as generateInputSequence() in
+ * board_helper.ts).
+ * @param rotationIndex - the rotation relative to the piece's current one
+ * @param firstArrIndex - where the piece is in the input frame timeline when the inputs start (see SimState::arrIndex)
+ */
+std::string getInputSequence(int rotationIndex, int xOffset, const InputFrameSchedule *inputSchedule, int firstArrIndex) {
+  int inputsLeft = xOffset < 0 ? -xOffset : 0;
+  int inputsRight = xOffset > 0 ? xOffset : 0;
+  int rotationsLeft = rotationIndex == 3 ? 1 : 0;
+  int rotationsRight = rotationIndex < 3 ? rotationIndex : 0;
+
+  std::string inputSequence;
+  if (inputSchedule->inputsPerPeriod == 0) {
+    return inputSequence;
+  }
+  for (int i = 0; inputsLeft + inputsRight + rotationsLeft + rotationsRight > 0; i++) {
+    if (!shouldPerformInputsThisFrame(firstArrIndex + i, inputSchedule)) {
+      inputSequence += '.';
+    } else if (inputsLeft > 0) {
+      // Do a left shift, possibly with a rotation
+      if (rotationsRight > 0) {
+        inputSequence += 'E';
+        rotationsRight--;
+      } else if (rotationsLeft > 0) {
+        inputSequence += 'F';
+        rotationsLeft--;
+      } else {
+        inputSequence += 'L';
+      }
+      inputsLeft--;
+    } else if (inputsRight > 0) {
+      // Do a right shift, possibly with a rotation
+      if (rotationsRight > 0) {
+        inputSequence += 'I';
+        rotationsRight--;
+      } else if (rotationsLeft > 0) {
+        inputSequence += 'G';
+        rotationsLeft--;
+      } else {
+        inputSequence += 'R';
+      }
+      inputsRight--;
+    } else if (rotationsLeft > 0) {
+      // Do a rotation
+      inputSequence += 'B';
+      rotationsLeft--;
+    } else {
+      inputSequence += 'A';
+      rotationsRight--;
+    }
+  }
+  return inputSequence;
+}
+
+/** Gets the input sequence that moves a piece from a state (e.g. where it is at adjustment time) to a placement. */
+std::string getInputSequenceFrom(SimState const &startState, LockPlacement lockPlacement, const InputFrameSchedule *inputSchedule) {
+  return getInputSequence((lockPlacement.rotationIndex - startState.rotationIndex + 4) % 4, lockPlacement.x - startState.x, inputSchedule, startState.arrIndex);
+}
+
+/**
+ * Formats a placement like the Node server's get-move response, which is what the script parses.
+ * @param startState - where the piece is when the inputs start
+ */
+std::string formatMoveForScript(LuaEngineJob const &job, unsigned int board[20], LockPlacement lockPlacement, SimState const &startState) {
+  if (lockPlacement.x == NONE) {
+    return "No legal moves";
+  }
+  unsigned int newBoard[20];
+  int numLinesCleared = getNewBoardAndLinesCleared(board, lockPlacement, newBoard);
+  const InputFrameSchedule inputSchedule = compileInputFrameSchedule(job.inputFrameTimeline.c_str());
+  std::string inputSequence = getInputSequenceFrom(startState, lockPlacement, &inputSchedule);
+  return string_format("%d,%d,%d|%s|%s|%d|%d", lockPlacement.rotationIndex, lockPlacement.x - INITIAL_X, lockPlacement.y - lockPlacement.piece->initialY,
+                       inputSequence.empty() ? "none" : inputSequence.c_str(), formatBoardAsInput(newBoard).c_str(),
+                       getLevelAfterLineClears(job.level, job.lines, numLinesCleared), job.lines + numLinesCleared);
+}
+
+GameState getGameStateForScript(LuaEngineJob const &job) {
+  GameState gameState = {};
+  encodeBoard(job.input.c_str(), gameState.board);
+  getSurfaceArray(gameState.board, gameState.surfaceArray);
+  gameState.level = job.level;
+  gameState.lines = job.lines;
+  return gameState;
+}
+
+/**
+ * Finds the placements that a piece can still reach from a state, by shifting and rotating and then falling straight down (like
+ * get-move-cpp, tucks are left out, since the input sequences don't cover them).
+ * @param startState - the piece's state, or {} if it has already locked
+ */
+void getReachablePlacements(GameState const &gameState, SimState const &startState, const InputFrameSchedule *inputSchedule, OUT std::vector<LockPlacement> &lockPlacements) {
+  if (startState.piece == NULL) {
+    return;
+  }
+  std::vector<LockPlacement> allPlacements;
+  adjustmentSearch(gameState, startState.piece, inputSchedule, startState.x - INITIAL_X, startState.y - startState.piece->initialY,
+                   startState.rotationIndex, startState.frameIndex, /* arrWasReset= */ startState.arrIndex == 0, allPlacements);
+  for (LockPlacement const &lockPlacement : allPlacements) {
+    if (lockPlacement.tuckInput == NO_TUCK_NOTATION) {
+      lockPlacements.push_back(lockPlacement);
+    }
+  }
+}
+
+/** Predicts where a piece will be when the reaction time is up, if it's moved towards a placement from its first frame. */
+SimState predictStateForScript(LuaEngineJob const &job, LockPlacement lockPlacement, const InputFrameSchedule *inputSchedule) {
+  return predictStateAtAdjustmentTime(lockPlacement, inputSchedule, getGravity(job.level), isGravityDoubled(job.level), job.reactionTimeFrames);
+}
+
+/** The penalty for the inputs of an adjustment, so that it's only made if it's worth it. */
+float getAdjustmentInputCost(std::string const &inputSequence) {
+  float cost = 0;
+  for (char input : inputSequence) {
+    if (input == 'E' || input == 'F' || input == 'I' || input == 'G') {
+      cost += SHIFT_AND_ROTATE_INPUT_COST;
+    } else if (input == 'A' || input == 'B') {
+      cost += ROTATE_INPUT_COST;
+    } else if (input == 'L' || input == 'R') {
+      cost += SHIFT_INPUT_COST;
+    }
+  }
+  return cost;
+}
+
+/**
+ * Searches for a move requested by engineGetMoveAsync(). The lock values come from the regular lookup request, and the placement
+ * is the best of the ones that can still be reached once the reaction time is up, from where the piece has fallen to by then
+ * (the same position that the script's adjustments start from).
+ */
+std::string searchMoveForScript(LuaEngineJob const &job) {
+  std::string packedTable = mainProcess(job.input.c_str(), GET_LOCK_VALUE_LOOKUP_PACKED, &DEFAULT_WEIGHT_SET, /* requestCaches= */ NULL, job.cancellationToken.get());
+  LockValueTable lockValueTable = {};
+  if (packedTable == CANCELLED_RESULT) {
+    return packedTable;
+  }
+  if (!unpackLockValueTable(packedTable, lockValueTable)) {
+    return "No legal moves";
+  }
+
+  // The piece is left alone until the reaction time is up, so it's as if it were headed straight down from spawn
+  const Piece *piece = &PIECE_LIST[job.curPieceIndex];
+  GameState gameState = getGameStateForScript(job);
+  if (collision(gameState.board, piece, INITIAL_X, piece->initialY, /* rotationIndex= */ 0)) {
+    return "No legal moves";
+  }
+  LockPlacement dropPlacement = {INITIAL_X, piece->initialY, /* rotationIndex= */ 0, NONE, NO_TUCK_NOTATION, piece};
+  while (!collision(gameState.board, piece, INITIAL_X, dropPlacement.y + 1, /* rotationIndex= */ 0)) {
+    dropPlacement.y++;
+  }
+  const InputFrameSchedule inputSchedule = compileInputFrameSchedule(job.inputFrameTimeline.c_str());
+  SimState adjustmentState = predictStateForScript(job, dropPlacement, &inputSchedule);
+
+  std::vector<LockPlacement> lockPlacements;
+  getReachablePlacements(gameState, adjustmentState, &inputSchedule, lockPlacements);
+  LockPlacement bestPlacement = NO_PLACEMENT;
+  float bestValue = 0;
+  for (LockPlacement const &lockPlacement : lockPlacements) {
+    int index = getLockTableIndex({lockPlacement.x, lockPlacement.y, lockPlacement.rotationIndex});
+    if (index == -1 || !lockValueTable.isPresent[index]) {
+      continue;
+    }
+    if (bestPlacement.x == NONE || lockValueTable.values[index] > bestValue) {
+      bestPlacement = lockPlacement;
+      bestValue = lockValueTable.values[index];
+    }
+  }
+  return formatMoveForScript(job, gameState.board, bestPlacement, adjustmentState);
+}
+
+/**
+ * Searches for a precompute requested by enginePrecomputeAsync(), the same way as the Node server's finessePrecompute(): the lock
+ * values for each next piece come from one GET_LOCK_VALUE_LOOKUP_ALL_NEXT_PIECES request, and each distinct start of an input
+ * sequence (up to the reaction time) is a candidate for the initial placement. For each candidate, the piece's state at
+ * adjustment time is predicted, and each next piece gets the best adjustment from there, if it beats the initial placement once
+ * the input costs are taken off. The candidate with the best expected value over the next pieces is the initial placement.
+ */
+std::string searchPrecomputeForScript(LuaEngineJob const &job) {
+  std::string allLookups = mainProcess(job.input.c_str(), GET_LOCK_VALUE_LOOKUP_ALL_NEXT_PIECES, &DEFAULT_WEIGHT_SET, /* requestCaches= */ NULL, job.cancellationToken.get());
+  if (allLookups == CANCELLED_RESULT) {
+    return allLookups;
+  }
+  std::vector<LockValueTable> lockValueTables(7);
+  if (!parseLockValueLookupAllNextPieces(allLookups, lockValueTables.data())) {
+    return "No legal moves";
+  }
+
+  const Piece *piece = &PIECE_LIST[job.curPieceIndex];
+  GameState gameState = getGameStateForScript(job);
+  const InputFrameSchedule inputSchedule = compileInputFrameSchedule(job.inputFrameTimeline.c_str());
+  SimState spawnState = {INITIAL_X, piece->initialY, /* rotationIndex= */ 0, /* frameIndex= */ 0, /* arrIndex= */ 0, piece};
+
+  // The candidate initial placements, by the fewest inputs first. With no reaction time, there's only the adjustment from spawn.
+  std::vector<LockPlacement> initialPlacements;
+  if (job.reactionTimeFrames == 0) {
+    initialPlacements.push_back(NO_PLACEMENT);
+  } else {
+    getReachablePlacements(gameState, spawnState, &inputSchedule, initialPlacements);
+    std::stable_sort(initialPlacements.begin(), initialPlacements.end(), [&](LockPlacement const &a, LockPlacement const &b) {
+      return getAdjustmentInputCost(getInputSequenceFrom(spawnState, a, &inputSchedule)) > getAdjustmentInputCost(getInputSequenceFrom(spawnState, b, &inputSchedule));
+    });
+  }
+
+  std::unordered_set<std::string> seenInputPrefixes;
+  float bestTotalValue = 0;
+  std::string bestResult = "No legal moves";
+  for (LockPlacement const &initialPlacement : initialPlacements) {
+    if (isSearchCancelled(job.cancellationToken.get())) {
+      return CANCELLED_RESULT;
+    }
+    SimState adjustmentState = spawnState;
+    int initialIndex = -1;
+    if (initialPlacement.x != NONE) {
+      // Placements that share their inputs up to the reaction time are the same candidate
+      std::string inputPrefix = getInputSequenceFrom(spawnState, initialPlacement, &inputSchedule).substr(0, job.reactionTimeFrames);
+      if (!seenInputPrefixes.insert(inputPrefix).second) {
+        continue;
+      }
+      adjustmentState = predictStateForScript(job, initialPlacement, &inputSchedule);
+      initialIndex = getLockTableIndex({initialPlacement.x, initialPlacement.y, initialPlacement.rotationIndex});
+    }
+    std::vector<LockPlacement> adjustments;
+    getReachablePlacements(gameState, adjustmentState, &inputSchedule, adjustments);
+
+    float totalValue = 0;
+    std::string adjustmentsFormatted;
+    for (int pieceIndex = 0; pieceIndex < 7; pieceIndex++) {
+      LockValueTable const &lockValueTable = lockValueTables[pieceIndex];
+      float maxValue = initialIndex != -1 && lockValueTable.isPresent[initialIndex] ? lockValueTable.values[initialIndex] : NO_ADJUSTMENT_VALUE;
+      LockPlacement bestAdjustment = NO_PLACEMENT;
+      for (LockPlacement const &adjustment : adjustments) {
+        int index = getLockTableIndex({adjustment.x, adjustment.y, adjustment.rotationIndex});
+        if (index == -1 || !lockValueTable.isPresent[index]) {
+          continue;
+        }
+        float value = lockValueTable.values[index] + getAdjustmentInputCost(getInputSequenceFrom(adjustmentState, adjustment, &inputSchedule));
+        if (value >= maxValue) {
+          maxValue = value;
+          bestAdjustment = adjustment;
+        }
+      }
+      totalValue += maxValue * transitionProbability[job.curPieceIndex][pieceIndex];
+      adjustmentsFormatted += string_format("\n%c:", getPieceChar(pieceIndex)) + formatMoveForScript(job, gameState.board, bestAdjustment, adjustmentState);
+    }
+
+    if (bestResult == "No legal moves" || totalValue > bestTotalValue) {
+      bestTotalValue = totalValue;
+      bestResult = "Default:" + (initialPlacement.x == NONE ? std::string("N/A (0 reaction time)") : formatMoveForScript(job, gameState.board, initialPlacement, spawnState))
+                   + adjustmentsFormatted;
+    }
+  }
+  return bestResult;
+}
+
+/** Runs the queued requests one at a time, forever. */
+void runLuaEngineWorker() {
+  while (true) {
+    LuaEngineJob job;
+    {
+      std::unique_lock<std::mutex> lock(luaEngineState.mutex);
+      while (luaEngineState.jobs.empty()) {
+        luaEngineState.hasJobs.wait(lock);
+      }
+      job = std::move(luaEngineState.jobs.front());
+      luaEngineState.jobs.pop_front();
+    }
+
+    std::string result;
+    if (isSearchCancelled(job.cancellationToken.get())) {
+      // Leave the result empty
+    } else if (job.curPieceIndex != -1) {
+      result = job.requestType == GET_LOCK_VALUE_LOOKUP_ALL_NEXT_PIECES ? searchPrecomputeForScript(job) : searchMoveForScript(job);
+    } else {
+      result = mainProcess(job.input.c_str(), job.requestType, &DEFAULT_WEIGHT_SET, /* requestCaches= */ NULL, job.cancellationToken.get());
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(luaEngineState.mutex);
+      // Only keep the result if the script still wants it
+      if (luaEngineState.unfinishedRequests.erase(job.requestId) > 0) {
+        luaEngineState.results[job.requestId] = result;
+      }
+    }
+    luaEngineState.hasResults.notify_all();
+  }
+}
+
+int submitLuaEngineJob(LuaEngineJob job) {
+  {
+    std::lock_guard<std::mutex> lock(luaEngineState.mutex);
+    job.requestId = luaEngineState.nextRequestId++;
+    job.cancellationToken = std::make_shared<CancellationToken>();
+    luaEngineState.unfinishedRequests[job.requestId] = job.cancellationToken;
+    luaEngineState.jobs.push_back(job);
+  }
+  luaEngineState.hasJobs.notify_one();
+  return job.requestId;
+}
+
+static int iGetMoveAsync(lua_State *L) {
+  const char *board = luaL_checkstring(L, 1);
+  const char *curPiece = luaL_checkstring(L, 2);
+  const char *nextPiece = luaL_optstring(L, 3, "none");
+  int level = luaL_checkint(L, 4);
+  int lines = luaL_checkint(L, 5);
+  const char *inputFrameTimeline = luaL_checkstring(L, 6);
+  int reactionTimeFrames = luaL_optint(L, 7, 0);
+  if (strlen(board) != 200) {
+    return luaL_argerror(L, 1, "expected 200 characters");
+  }
+  if (reactionTimeFrames < 0) {
+    return luaL_argerror(L, 7, "expected a non-negative frame count");
+  }
+
+  LuaEngineJob job = {};
+  job.requestType = GET_LOCK_VALUE_LOOKUP_PACKED;
+  job.curPieceIndex = getPieceIndexFromLetter(curPiece);
+  if (job.curPieceIndex == -1) {
+    return luaL_argerror(L, 2, "expected a piece letter");
+  }
+  job.level = level;
+  job.lines = lines;
+  job.inputFrameTimeline = inputFrameTimeline;
+  job.reactionTimeFrames = reactionTimeFrames;
+  // The trailing delimiter is needed by the parsing in processRequest(), and the search settings are left at their defaults
+  job.input = string_format("%s|%d|%d|%d|%d|%s|", board, level, lines, job.curPieceIndex, getPieceIndexFromLetter(nextPiece), inputFrameTimeline);
+  lua_pushinteger(L, submitLuaEngineJob(job));
+  return 1;
+}
+
+static int iPrecomputeAsync(lua_State *L) {
+  const char *board = luaL_checkstring(L, 1);
+  const char *curPiece = luaL_checkstring(L, 2);
+  int level = luaL_checkint(L, 3);
+  int lines = luaL_checkint(L, 4);
+  const char *inputFrameTimeline = luaL_checkstring(L, 5);
+  int reactionTimeFrames = luaL_optint(L, 6, 0);
+  if (strlen(board) != 200) {
+    return luaL_argerror(L, 1, "expected 200 characters");
+  }
+  if (reactionTimeFrames < 0) {
+    return luaL_argerror(L, 6, "expected a non-negative frame count");
+  }
+
+  LuaEngineJob job = {};
+  job.requestType = GET_LOCK_VALUE_LOOKUP_ALL_NEXT_PIECES;
+  job.curPieceIndex = getPieceIndexFromLetter(curPiece);
+  if (job.curPieceIndex == -1) {
+    return luaL_argerror(L, 2, "expected a piece letter");
+  }
+  job.level = level;
+  job.lines = lines;
+  job.inputFrameTimeline = inputFrameTimeline;
+  job.reactionTimeFrames = reactionTimeFrames;
+  // The next piece isn't known, so it's a placeholder (as in getPrecomputeInputString() in utils.ts)
+  job.input = string_format("%s|%d|%d|%d|0|%s|", board, level, lines, job.curPieceIndex, inputFrameTimeline);
+  lua_pushinteger(L, submitLuaEngineJob(job));
+  return 1;
+}
+
+static int iRequestAsync(lua_State *L) {
+  int requestType = luaL_checkint(L, 1);
+  const char *inputStr = luaL_checkstring(L, 2);
+  if (requestType < GET_LOCK_VALUE_LOOKUP || requestType > GET_LOCK_VALUE_LOOKUP_PACKED || strlen(inputStr) < 201) {
+    return luaL_error(L, "invalid request");
+  }
+
+  LuaEngineJob job = {};
+  job.requestType = (RequestType) requestType;
+  job.input = inputStr;
+  job.curPieceIndex = -1;
+  lua_pushinteger(L, submitLuaEngineJob(job));
+  return 1;
+}
+
+static int iPollResult(lua_State *L) {
+  int requestId = luaL_checkint(L, 1);
+  std::lock_guard<std::mutex> lock(luaEngineState.mutex);
+  auto result = luaEngineState.results.find(requestId);
+  if (result == luaEngineState.results.end()) {
+    lua_pushnil(L);
+  } else {
+    lua_pushlstring(L, result->second.data(), result->second.size());
+    luaEngineState.results.erase(result);
+  }
+  return 1;
+}
+
+static int iWaitResult(lua_State *L) {
+  int requestId = luaL_checkint(L, 1);
+  std::unique_lock<std::mutex> lock(luaEngineState.mutex);
+  while (luaEngineState.results.count(requestId) == 0 && luaEngineState.unfinishedRequests.count(requestId) > 0) {
+    luaEngineState.hasResults.wait(lock);
+  }
+  auto result = luaEngineState.results.find(requestId);
+  if (result == luaEngineState.results.end()) {
+    lua_pushnil(L); // Cancelled, or already fetched
+  } else {
+    lua_pushlstring(L, result->second.data(), result->second.size());
+    luaEngineState.results.erase(result);
+  }
+  return 1;
+}
+
+static int iCancel(lua_State *L) {
+  int requestId = luaL_checkint(L, 1);
+  std::lock_guard<std::mutex> lock(luaEngineState.mutex);
+  auto unfinishedRequest = luaEngineState.unfinishedRequests.find(requestId);
+  if (unfinishedRequest != luaEngineState.unfinishedRequests.end()) {
+    cancelSearch(unfinishedRequest->second.get());
+    luaEngineState.unfinishedRequests.erase(unfinishedRequest);
+  }
+  luaEngineState.results.erase(requestId);
+  return 0;
+}
+
+extern "C" int luaopen_rabbitengine(lua_State *L) {
+  {
+    std::lock_guard<std::mutex> lock(luaEngineState.mutex);
+    if (!luaEngineState.isWorkerStarted) {
+      luaEngineState.isWorkerStarted = true;
+      std::thread(runLuaEngineWorker).detach();
+    }
+  }
+  lua_register(L, "engineGetMoveAsync", iGetMoveAsync);
+  lua_register(L, "enginePrecomputeAsync", iPrecomputeAsync);
+  lua_register(L, "engineRequestAsync", iRequestAsync);
+  lua_register(L, "enginePollResult", iPollResult);
+  lua_register(L, "engineWaitResult", iWaitResult);
+  lua_register(L, "engineCancel", iCancel);
+  return 0;
+}
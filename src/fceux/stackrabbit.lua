@@ -2,9 +2,12 @@ IS_MAC = false
 IS_PAL = false
 USE_PUSHDOWN = true
 DEBUG_MODE = false
+USE_NATIVE_ENGINE = false -- Searches in-process with the rabbitengine module (see rabbitengine.cpp), instead of over HTTP
 
 local os = require("os")
-if (IS_MAC) then
+if USE_NATIVE_ENGINE then
+  require("rabbitengine")
+elseif (IS_MAC) then
   require("rabbithttp")
 else
   http = require("socket.http")
@@ -49,6 +52,10 @@ function resetGameScopedVariables()
   gameOver = false
   pcur = 0
   pnext = 0
+  if nativeRequestId ~= nil then
+    engineCancel(nativeRequestId)
+  end
+  nativeRequestId = nil
 end
 resetGameScopedVariables();
 
@@ -171,6 +178,12 @@ function requestAdjustmentAsync()
   end
   print("reqLines2 " .. reqLines)
 
+  if USE_NATIVE_ENGINE then
+    nativeRequestId = engineGetMoveAsync(getEncodedBoard(), orientToPiece[pcur], orientToPiece[pnext], reqLevel, reqLines, INPUT_TIMELINE, REACTION_TIME_FRAMES)
+    waitingOnAsyncRequest = true
+    return
+  end
+
   -- Format URL arguments
   local reqStr = "http://localhost:3000/get-move-async?board=" .. getEncodedBoard() .. "&currentPiece=" .. orientToPiece[pcur]
   reqStr = reqStr .. "&nextPiece=" .. orientToPiece[pnext] .. "&level=" .. reqLevel .. "&lines=" .. reqLines .. "&inputFrameTimeline=" .. INPUT_TIMELINE
@@ -210,6 +223,15 @@ function requestPrecompute()
     return
   end
 
+  if USE_NATIVE_ENGINE then
+    if nativeRequestId ~= nil then
+      engineCancel(nativeRequestId)
+    end
+    nativeRequestId = enginePrecomputeAsync(stateForNextPiece.board, orientToPiece[pnext], stateForNextPiece.level, reqLines, INPUT_TIMELINE, REACTION_TIME_FRAMES)
+    waitingOnAsyncRequest = true
+    return
+  end
+
   local reqStr = "http://localhost:3000/precompute?board=" .. stateForNextPiece.board .. "&currentPiece=" .. orientToPiece[pnext]
   reqStr = reqStr .. "&level=" .. stateForNextPiece.level .. "&lines=" .. reqLines .. "&reactionTime="
   reqStr = reqStr .. REACTION_TIME_FRAMES .. "&inputFrameTimeline=" .. INPUT_TIMELINE
@@ -224,6 +246,13 @@ end
 
 -- Check if the async computation has finished, and if so make the adjustment based on it
 function fetchAsyncResult()
+  if USE_NATIVE_ENGINE then
+    local result = engineWaitResult(nativeRequestId)
+    nativeRequestId = nil
+    waitingOnAsyncRequest = false
+    return result
+  end
+
   local response = makeHttpRequest("http://localhost:3000/async-result")
 
   -- Only use the response if the server indicated that it sent the async result
@@ -0,0 +1,117 @@
+/**
+ * A client for the standalone engine server (see src/cpp_modules/engine_server.md), which runs the C++ engine in its own
+ * process instead of as a native module inside this one. Requests are pipelined over a single connection, and each one
+ * resolves when its response arrives, in whatever order the server finishes them.
+ */
+const net = require("net");
+
+// Mirrors the RequestType enum in src/cpp_modules/src/types.hpp
+export const EngineRequestType = {
+  GET_LOCK_VALUE_LOOKUP: 0,
+  GET_TOP_MOVES: 1,
+  GET_TOP_MOVES_HYBRID: 2,
+  RATE_MOVE: 3,
+  GET_MOVE: 4,
+  GET_LOCK_VALUE_LOOKUP_ALL_NEXT_PIECES: 5,
+  GET_LOCK_VALUE_LOOKUP_PACKED: 6,
+};
+
+const FRAME_LENGTH_BYTES = 4;
+const FRAME_HEADER_BYTES = 8; // uint32 requestId, uint8 type or status, 3 reserved bytes
+const RESPONSE_STATUS_OK = 0;
+
+export class EngineClient {
+  socketPath: string;
+  socket: any;
+  nextRequestId: number;
+  pendingRequests: { [requestId: number]: { resolve: Function; reject: Function } };
+  receivedData: any; // A Buffer holding any partial frame
+
+  constructor(socketPath: string) {
+    this.socketPath = socketPath;
+    this.socket = null;
+    this.nextRequestId = 1;
+    this.pendingRequests = {};
+    this.receivedData = Buffer.alloc(0);
+  }
+
+  /**
+   * Sends a request to the engine server.
+   * @param {number} requestType - one of EngineRequestType
+   * @param {string} inputStr - the encoded input string, as passed to the native module
+   * @returns a promise of the engine's result
+   */
+  request(requestType: number, inputStr: string): Promise<string> {
+    this._connectIfNeeded();
+    const requestId = this.nextRequestId;
+    this.nextRequestId = (this.nextRequestId + 1) >>> 0 || 1;
+
+    const payload = Buffer.from(inputStr, "utf8");
+    const frame = Buffer.alloc(FRAME_LENGTH_BYTES + FRAME_HEADER_BYTES + payload.length);
+    frame.writeUInt32LE(FRAME_HEADER_BYTES + payload.length, 0);
+    frame.writeUInt32LE(requestId, FRAME_LENGTH_BYTES);
+    frame.writeUInt8(requestType, FRAME_LENGTH_BYTES + 4);
+    payload.copy(frame, FRAME_LENGTH_BYTES + FRAME_HEADER_BYTES);
+
+    return new Promise((resolve, reject) => {
+      this.pendingRequests[requestId] = { resolve, reject };
+      this.socket.write(frame);
+    });
+  }
+
+  _connectIfNeeded() {
+    if (this.socket !== null) {
+      return;
+    }
+    this.socket = net.createConnection(this.socketPath);
+    this.socket.on("data", (data) => this._onData(data));
+    this.socket.on("error", (err) => this._onDisconnect(err));
+    this.socket.on("close", () =>
+      this._onDisconnect(new Error("Engine server connection closed"))
+    );
+  }
+
+  _onData(data) {
+    this.receivedData = Buffer.concat([this.receivedData, data]);
+    while (this.receivedData.length >= FRAME_LENGTH_BYTES) {
+      const frameLength = this.receivedData.readUInt32LE(0);
+      if (this.receivedData.length < FRAME_LENGTH_BYTES + frameLength) {
+        return; // Wait for the rest of the frame
+      }
+      const requestId = this.receivedData.readUInt32LE(FRAME_LENGTH_BYTES);
+      const status = this.receivedData.readUInt8(FRAME_LENGTH_BYTES + 4);
+      const payload = this.receivedData.toString(
+        "utf8",
+        FRAME_LENGTH_BYTES + FRAME_HEADER_BYTES,
+        FRAME_LENGTH_BYTES + frameLength
+      );
+      this.receivedData = this.receivedData.slice(FRAME_LENGTH_BYTES + frameLength);
+
+      const pendingRequest = this.pendingRequests[requestId];
+      if (pendingRequest === undefined) {
+        console.error("Engine server sent a response for unknown request", requestId);
+        continue;
+      }
+      delete this.pendingRequests[requestId];
+      if (status === RESPONSE_STATUS_OK) {
+        pendingRequest.resolve(payload);
+      } else {
+        pendingRequest.reject(new Error("Engine server error: " + payload));
+      }
+    }
+  }
+
+  /** Fails every request still in flight. The next request will reconnect. */
+  _onDisconnect(err) {
+    if (this.socket !== null) {
+      this.socket.destroy();
+      this.socket = null;
+    }
+    this.receivedData = Buffer.alloc(0);
+    const pendingRequests = this.pendingRequests;
+    this.pendingRequests = {};
+    for (const requestId of Object.keys(pendingRequests)) {
+      pendingRequests[requestId].reject(err);
+    }
+  }
+}
@@ -0,0 +1,110 @@
+/**
+ * Tests the standalone engine server (see src/cpp_modules/engine_server.md) over its socket and its shared ring. Starts the
+ * server binary from build/engine_server, and the ring goes through the native module, so run it with
+ * `npm run engine_server_test`, which builds both first.
+ */
+import { EngineClient, EngineRequestType } from "./engine_client";
+import { SharedRingEngineClient } from "./shared_ring_client";
+
+const child_process = require("child_process");
+const fs = require("fs");
+
+const SOCKET_PATH = "/tmp/stackrabbit_test.sock";
+const RING_PATH = "/tmp/stackrabbit_test.ring";
+const EMPTY_BOARD = "0".repeat(200);
+const VALID_INPUT = EMPTY_BOARD + "|18|0|0|1|X....|";
+const SLOW_INPUT = EMPTY_BOARD + "|18|0|0|1|X....|5000|4|20|"; // Takes seconds, so it's still running when it's cancelled
+
+function startEngineServer() {
+  if (fs.existsSync(SOCKET_PATH)) {
+    fs.unlinkSync(SOCKET_PATH);
+  }
+  const server = child_process.spawn("build/engine_server", ["--socket", SOCKET_PATH, "--shm", RING_PATH, "--workers", "2", "--stats-interval", "0"], {
+    stdio: ["ignore", "ignore", "inherit"],
+  });
+  server.on("exit", (code, signal) => {
+    if (!server.isStopping) {
+      console.error("Engine server exited early", code, signal);
+      process.exit(1);
+    }
+  });
+  return server;
+}
+
+async function waitForSocket() {
+  for (let i = 0; i < 100 && !fs.existsSync(SOCKET_PATH); i++) {
+    await new Promise((resolve) => setTimeout(resolve, 50));
+  }
+}
+
+/** Every malformed request should be answered with an error, without taking the server down. */
+async function malformedRequestTest(client: EngineClient) {
+  const malformedRequests = [
+    [EngineRequestType.GET_LOCK_VALUE_LOOKUP, EMPTY_BOARD + "|18|0|", "missing the pieces and timeline"],
+    [EngineRequestType.GET_LOCK_VALUE_LOOKUP, EMPTY_BOARD + "|18|0|7|1|X....|", "current piece out of range"],
+    [EngineRequestType.GET_LOCK_VALUE_LOOKUP, EMPTY_BOARD + "|18|0|-1|1|X....|", "no current piece"],
+    [EngineRequestType.GET_MOVE, EMPTY_BOARD + "|18|0|0|7|X....|", "next piece out of range"],
+    [EngineRequestType.GET_MOVE, EMPTY_BOARD + "|eighteen|0|0|1|X....|", "non-integer level"],
+    [EngineRequestType.GET_MOVE, EMPTY_BOARD + "|18|0|T|1|X....|", "non-integer piece"],
+    [EngineRequestType.GET_MOVE, EMPTY_BOARD + "|18|0|0|1||", "empty timeline"],
+    [EngineRequestType.GET_MOVE, EMPTY_BOARD + "X18|0|0|1|X....|", "no delimiter after the board"],
+    [EngineRequestType.RATE_MOVE, VALID_INPUT, "only one board"],
+    [EngineRequestType.GET_TOP_MOVES, "0|18|0|0|1|X....|", "too short"],
+    [99, VALID_INPUT, "unknown type"],
+  ];
+  for (const [requestType, input, description] of malformedRequests) {
+    try {
+      await client.request(requestType as number, input as string);
+    } catch (err) {
+      if (err.message.startsWith("Engine server error")) {
+        continue;
+      }
+      throw new Error(`Malformed request (${description}) failed with: ${err.message}`);
+    }
+    throw new Error(`Malformed request (${description}) was answered`);
+  }
+
+  // The server should still be up
+  const result = await client.request(EngineRequestType.GET_MOVE, VALID_INPUT);
+  if (!result.startsWith("[")) {
+    throw new Error("Unexpected result after the malformed requests: " + result);
+  }
+  console.log(`Malformed requests: ${malformedRequests.length} rejected, server still answering`);
+}
+
+/** A request cancelled through the ring (as PreComputeManager does for stale precomputes) should stop with a "Cancelled" error. */
+async function sharedRingCancelTest() {
+  const client = new SharedRingEngineClient(RING_PATH);
+  const startTime = Date.now();
+  const slowRequest = client.request(EngineRequestType.GET_LOCK_VALUE_LOOKUP, SLOW_INPUT);
+  client.cancelAll();
+  try {
+    await slowRequest;
+  } catch (err) {
+    if (err.message !== "Engine server error: Cancelled") {
+      throw new Error("Cancelled request failed with: " + err.message);
+    }
+    console.log(`Shared ring cancel: request cancelled after ${Date.now() - startTime}ms`);
+    return;
+  }
+  throw new Error("Cancelled request was answered");
+}
+
+async function runTests() {
+  const server = startEngineServer();
+  try {
+    await waitForSocket();
+    const client = new EngineClient(SOCKET_PATH);
+    await malformedRequestTest(client);
+    await sharedRingCancelTest();
+    console.log("All tests passed");
+  } finally {
+    server.isStopping = true;
+    server.kill();
+  }
+}
+
+runTests().catch((err) => {
+  console.error(err);
+  process.exit(1);
+});
@@ -25,6 +25,7 @@ export const DEBUG_DOUBLE_KS_ALWAYS_ENABLED = false;
 export const CPP_LIVEGAME_PLAYOUT_COUNT = 49;
 export const CPP_LIVEGAME_PLAYOUT_LENGTH = 2;
 export const CPP_LIVEGAME_PRUNING_BREADTH = 10;
+export const PRECOMPUTE_ALL_NEXT_PIECES_NATIVELY = true; // One native call computes all 7 lookups, instead of one worker per piece
 
 // Rarely changed
 export const IS_PAL = false;
@@ -1,9 +1,16 @@
+import { EngineRequestType } from "./engine_client";
 import { getBestMove, getSearchStateAfter, getSortedMoveList } from "./main";
 import { getPossibleMoves } from "./move_search";
-import { IS_DROUGHT_MODE, SHOULD_PUSHDOWN } from "./params";
+import {
+  IS_DROUGHT_MODE,
+  PRECOMPUTE_ALL_NEXT_PIECES_NATIVELY,
+  SHOULD_PUSHDOWN,
+} from "./params";
 import { getPieceProbability } from "./piece_rng";
+import { SharedRingEngineClient } from "./shared_ring_client";
 import {
   formatPossibility,
+  getPrecomputeInputString,
   GetGravity,
   IsGravityDoubled,
   POSSIBLE_NEXT_PIECES,
@@ -12,7 +19,10 @@ import {
 
 const child_process = require("child_process");
 
-const NUM_THREADS = 7;
+const CANCELLED_ERROR = "Engine server error: Cancelled"; // See CANCELLED_RESULT in cancellation.hpp
+
+// When all the next pieces are computed in one native call, it parallelizes internally, so one worker is enough
+const NUM_THREADS = PRECOMPUTE_ALL_NEXT_PIECES_NATIVELY ? 1 : 7;
 const THREAD_ASSIGNMENT = {
   O: 0,
   I: 6,
@@ -28,7 +38,11 @@ const THREAD_ASSIGNMENT = {
  * the initial placement based on the ability to reach those adjustments.
  * */
 export class PreComputeManager {
+  engineClient: SharedRingEngineClient; // If set, the searches go to the engine server instead of worker processes
   workers: any[];
+  workersCanCancel: boolean[];
+  numSearchesInFlight: number[]; // For each worker
+  precomputeId: number;
   pendingResults: number;
   workersStillLoading: number;
   onResultCallback: Function;
@@ -41,7 +55,13 @@ export class PreComputeManager {
   lastSeenPiece: PieceId;
 
   constructor() {
+    this.engineClient = process.env.ENGINE_SHM
+      ? new SharedRingEngineClient(process.env.ENGINE_SHM)
+      : null;
     this.workers = [];
+    this.workersCanCancel = [];
+    this.numSearchesInFlight = [];
+    this.precomputeId = 0;
     this.pendingResults = 0;
     this.workersStillLoading = 0;
     // Callbacks to notify parent
@@ -64,13 +84,24 @@ export class PreComputeManager {
 
   initialize(callback) {
     this.onReadyCallback = callback;
+    if (this.engineClient !== null) {
+      // The engine server is already running, so there's nothing to load
+      for (let i = 0; i < NUM_THREADS; i++) {
+        this.numSearchesInFlight.push(0);
+      }
+      console.log("Sending precomputes to the engine server at", process.env.ENGINE_SHM);
+      callback();
+      return;
+    }
     this.workersStillLoading = NUM_THREADS;
 
     // Create the worker threads
     for (let i = 0; i < NUM_THREADS; i++) {
       const newWorker = child_process.fork("built/src/server/worker_thread.js");
-      newWorker.addListener("message", this._onMessage);
+      newWorker.addListener("message", (message) => this._onMessage(message, i));
       this.workers.push(newWorker);
+      this.workersCanCancel.push(false);
+      this.numSearchesInFlight.push(0);
     }
   }
 
@@ -84,6 +115,8 @@ export class PreComputeManager {
     onResultCallback: Function
   ) {
     console.time("FINESSE PRECOMPUTE");
+    this._cancelStaleSearches();
+    this.precomputeId++;
     this.onResultCallback = onResultCallback;
     this.results = {};
     this.pendingResults = POSSIBLE_NEXT_PIECES.length;
@@ -117,18 +150,32 @@ export class PreComputeManager {
 
     // Ping all the workers to start evaluating the next piece values
     console.time("WORKER PHASE");
-    for (let i = 0; i < POSSIBLE_NEXT_PIECES.length; i++) {
-      const nextPieceId = POSSIBLE_NEXT_PIECES[i];
-
+    if (PRECOMPUTE_ALL_NEXT_PIECES_NATIVELY) {
+      // One call computes the lookups for every next piece, sharing the search of the current piece
       const argsData: WorkerDataArgs = {
-        piece: nextPieceId,
-        newSearchState: { ...searchState, nextPieceId },
+        piece: null,
+        newSearchState: searchState,
         initialAiParams,
         paramMods,
         inputFrameTimeline,
+        precomputeId: this.precomputeId,
       };
-
-      this.workers[THREAD_ASSIGNMENT[nextPieceId]].send(argsData);
+      this._sendToWorker(0, argsData);
+    } else {
+      for (let i = 0; i < POSSIBLE_NEXT_PIECES.length; i++) {
+        const nextPieceId = POSSIBLE_NEXT_PIECES[i];
+
+        const argsData: WorkerDataArgs = {
+          piece: nextPieceId,
+          newSearchState: { ...searchState, nextPieceId },
+          initialAiParams,
+          paramMods,
+          inputFrameTimeline,
+          precomputeId: this.precomputeId,
+        };
+
+        this._sendToWorker(THREAD_ASSIGNMENT[nextPieceId], argsData);
+      }
     }
 
     // Calculate all the possible phantom placements (on main thread since it's not doing anything)
@@ -190,10 +237,69 @@ export class PreComputeManager {
     this.phantomPlacements = phantomPlacements;
   }
 
-  _onMessage(message: WorkerResponse) {
+  _sendToWorker(workerIndex: number, argsData: WorkerDataArgs) {
+    this.numSearchesInFlight[workerIndex]++;
+    if (this.engineClient !== null) {
+      this._sendToEngine(workerIndex, argsData);
+      return;
+    }
+    this.workers[workerIndex].send(argsData);
+  }
+
+  /** Runs a worker's search on the engine server instead, and handles its result as if the worker had sent it. */
+  _sendToEngine(workerIndex: number, argsData: WorkerDataArgs) {
+    const requestType =
+      argsData.piece === null
+        ? EngineRequestType.GET_LOCK_VALUE_LOOKUP_ALL_NEXT_PIECES
+        : EngineRequestType.GET_LOCK_VALUE_LOOKUP;
+    this.engineClient
+      .request(requestType, getPrecomputeInputString(argsData))
+      .then(
+        (resultStr) => {
+          const result = JSON.parse(resultStr);
+          this._onMessage(
+            argsData.piece === null
+              ? { type: "allResults", results: result, precomputeId: argsData.precomputeId }
+              : { type: "result", piece: argsData.piece, result, precomputeId: argsData.precomputeId },
+            workerIndex
+          );
+        },
+        (err) => {
+          if (err.message !== CANCELLED_ERROR) {
+            console.error("Precompute search failed on the engine server:", err.message);
+          }
+          this._onMessage({ type: "cancelled", precomputeId: argsData.precomputeId }, workerIndex);
+        }
+      );
+  }
+
+  /**
+   * Cuts short the searches still running for the previous precompute, whose results would be ignored anyway, so that the
+   * workers are free for the new one.
+   */
+  _cancelStaleSearches() {
+    if (this.engineClient !== null) {
+      this.engineClient.cancelAll();
+      return;
+    }
+    for (let i = 0; i < this.workers.length; i++) {
+      if (this.workersCanCancel[i] && this.numSearchesInFlight[i] > 0) {
+        this.workers[i].kill("SIGUSR2");
+      }
+    }
+  }
+
+  _onMessage(message: WorkerResponse, workerIndex: number) {
+    if (message.type !== "ready") {
+      this.numSearchesInFlight[workerIndex]--;
+      if (message.precomputeId !== this.precomputeId) {
+        return; // A cancelled search, or one that finished after being superseded
+      }
+    }
     switch (message.type) {
       case "ready":
         // Update the ready worker count, and notify the parent if all threads are ready
+        this.workersCanCancel[workerIndex] = message.canCancel;
         this.workersStillLoading--;
         if (this.workersStillLoading === 0) {
           console.log("Done loading worker threads");
@@ -214,6 +320,19 @@ export class PreComputeManager {
         }
         break;
 
+      case "cancelled":
+        // Only searches for a superseded precompute are cancelled, so this shouldn't happen
+        console.error("Precompute search was cancelled unexpectedly");
+        break;
+
+      case "allResults":
+        // All the next pieces were computed in a single call
+        this.results = message.results;
+        this.pendingResults = 0;
+        console.timeEnd("WORKER PHASE");
+        this._compileResponseFinesse();
+        break;
+
       default:
         throw new Error(
           "Unrecognized message type received from worker: " + message.type
@@ -16,10 +16,32 @@ import {
   getSearchStateFromUrlArguments,
   getCppEncodedInputString,
 } from "./request_parser";
+import { EngineClient, EngineRequestType } from "./engine_client";
+import { SharedRingEngineClient } from "./shared_ring_client";
 const cModule = require("../../../build/Release/cRabbit");
 const mainApp = require("./main");
 const params = require("./params");
 
+// If set, the C++ requests go to a standalone engine server instead of the in-process module, through its shared ring file
+// or on its socket
+const engineClient = process.env.ENGINE_SHM
+  ? new SharedRingEngineClient(process.env.ENGINE_SHM)
+  : process.env.ENGINE_SOCKET
+  ? new EngineClient(process.env.ENGINE_SOCKET)
+  : null;
+
+// If set, the requests searched by the in-process module are logged to this file, for replaying offline (see
+// src/cpp_modules/request_capture.md). With an engine server, start it with --capture instead.
+if (process.env.ENGINE_CAPTURE && !cModule.startRequestCapture(process.env.ENGINE_CAPTURE)) {
+  console.error("Unable to capture requests to", process.env.ENGINE_CAPTURE);
+}
+
+// If set, the in-process module consults this position book before searching (see position_book.hpp). The precompute
+// workers load it too, and since the book is memory-mapped, they all share its pages.
+if (process.env.POSITION_BOOK && !cModule.loadPositionBook(process.env.POSITION_BOOK)) {
+  console.error("Unable to load the position book at", process.env.POSITION_BOOK);
+}
+
 function sleep(ms) {
   return new Promise((resolve) => {
     setTimeout(resolve, ms);
@@ -92,10 +114,13 @@ export class RequestHandler {
         return [this.handleEngineLookupTopMoves(searchState, urlArgs), 200];
 
       case "engine-movelist-cpp":
-        return [this.handleCppLookupTopMoves(searchState, urlArgs), 200];
+        return [await this.handleCppLookupTopMoves(searchState, urlArgs), 200];
 
       case "engine-movelist-cpp-hybrid":
-        return [this.handleCppLookupTopMovesHybrid(searchState, urlArgs), 200];
+        return [
+          await this.handleCppLookupTopMovesHybrid(searchState, urlArgs),
+          200,
+        ];
 
       case "get-move":
         return [
@@ -123,7 +148,7 @@ export class RequestHandler {
         return [this.handleRequestRateMove(searchState, urlArgs), 200];
 
       case "rate-move-cpp":
-        return [this.handleCppRateMove(searchState, urlArgs), 200];
+        return [await this.handleCppRateMove(searchState, urlArgs), 200];
 
       case "precompute":
         if (!this.preComputeManager) {
@@ -247,6 +272,9 @@ export class RequestHandler {
 
   handleCppLookupTopMoves(searchState: SearchState, urlArgs: UrlArguments) {
     const encodedInputString = getCppEncodedInputString(searchState, urlArgs);
+    if (engineClient) {
+      return engineClient.request(EngineRequestType.GET_TOP_MOVES, encodedInputString);
+    }
     return cModule.getTopMoves(encodedInputString);
   }
 
@@ -258,11 +286,17 @@ export class RequestHandler {
     if (!urlArgs.nextPiece) {
       return "Error: engine-movelist-cpp-hybrid request requires the next piece as a URL argument.";
     }
+    if (engineClient) {
+      return engineClient.request(EngineRequestType.GET_TOP_MOVES_HYBRID, encodedInputString);
+    }
     return cModule.getTopMovesHybrid(encodedInputString);
   }
 
   handleCppRateMove(searchState: SearchState, urlArgs: UrlArguments) {
     const encodedInputString = getCppEncodedInputString(searchState, urlArgs);
+    if (engineClient) {
+      return engineClient.request(EngineRequestType.RATE_MOVE, encodedInputString);
+    }
     return cModule.rateMove(encodedInputString);
   }
 
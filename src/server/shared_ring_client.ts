@@ -0,0 +1,101 @@
+/**
+ * A client for the standalone engine server over shared memory (see src/cpp_modules/src/shared_ring.hpp), for when the server
+ * runs on the same machine with --shm. Requests are copied straight into the ring by the native module, rather than being
+ * serialized onto a socket, and the responses are polled for while any requests are in flight.
+ * It has the same interface as EngineClient.
+ */
+const cModule = require("../../../build/Release/cRabbit");
+
+const RESPONSE_STATUS_OK = 0; // See EngineResponseStatus in engine_server.hpp
+const CANCEL_REQUEST_TYPE = 254; // See ENGINE_CANCEL_REQUEST in engine_server.hpp
+
+// Responses are polled on every turn of the event loop at first, and then on a timer once none have arrived for a while, so
+// that a long search doesn't keep the process spinning
+const NUM_IMMEDIATE_POLLS = 1000;
+const POLL_INTERVAL_MS = 1;
+
+export class SharedRingEngineClient {
+  ringPath: string;
+  isOpen: boolean;
+  isPolling: boolean;
+  numEmptyPolls: number;
+  nextRequestId: number;
+  pendingRequests: { [requestId: number]: { resolve: Function; reject: Function } };
+
+  constructor(ringPath: string) {
+    this.ringPath = ringPath;
+    this.isOpen = false;
+    this.isPolling = false;
+    this.numEmptyPolls = 0;
+    this.nextRequestId = 1;
+    this.pendingRequests = {};
+    this._poll = this._poll.bind(this);
+  }
+
+  /**
+   * Sends a request to the engine server.
+   * @param {number} requestType - one of EngineRequestType
+   * @param {string} inputStr - the encoded input string, as passed to the native module
+   * @returns a promise of the engine's result
+   */
+  request(requestType: number, inputStr: string): Promise<string> {
+    if (!this.isOpen) {
+      // Throws if the server hasn't created the file, or the module was built without shared ring support (i.e. on Windows)
+      cModule.openSharedRing(this.ringPath);
+      this.isOpen = true;
+    }
+    const requestId = this.nextRequestId;
+    this.nextRequestId = (this.nextRequestId + 1) >>> 0 || 1;
+
+    if (!cModule.submitToSharedRing(requestId, requestType, inputStr)) {
+      return Promise.reject(new Error("Engine request ring is full"));
+    }
+    return new Promise((resolve, reject) => {
+      this.pendingRequests[requestId] = { resolve, reject };
+      this._startPolling();
+    });
+  }
+
+  /** Cancels every request still in flight. Each one is rejected with a "Cancelled" error once the server stops it. */
+  cancelAll() {
+    for (const requestId of Object.keys(this.pendingRequests)) {
+      cModule.submitToSharedRing(Number(requestId), CANCEL_REQUEST_TYPE, "");
+    }
+  }
+
+  _startPolling() {
+    this.numEmptyPolls = 0;
+    if (!this.isPolling) {
+      this.isPolling = true;
+      setImmediate(this._poll);
+    }
+  }
+
+  _poll() {
+    const responses = cModule.pollSharedRing();
+    for (const [requestId, status, payload] of responses) {
+      const pendingRequest = this.pendingRequests[requestId];
+      if (pendingRequest === undefined) {
+        console.error("Engine server sent a response for unknown request", requestId);
+        continue;
+      }
+      delete this.pendingRequests[requestId];
+      if (status === RESPONSE_STATUS_OK) {
+        pendingRequest.resolve(payload);
+      } else {
+        pendingRequest.reject(new Error("Engine server error: " + payload));
+      }
+    }
+
+    if (Object.keys(this.pendingRequests).length === 0) {
+      this.isPolling = false;
+      return;
+    }
+    this.numEmptyPolls = responses.length > 0 ? 0 : this.numEmptyPolls + 1;
+    if (this.numEmptyPolls < NUM_IMMEDIATE_POLLS) {
+      setImmediate(this._poll);
+    } else {
+      setTimeout(this._poll, POLL_INTERVAL_MS);
+    }
+  }
+}
@@ -239,15 +239,19 @@ interface ParamMods {
 /* ------------ Messages for Worker Threads ------------ */
 
 interface WorkerDataArgs {
-  piece: PieceId;
+  piece: PieceId | null; // null = compute the lookups for all possible next pieces
   newSearchState: SearchState;
   initialAiParams: InitialAiParams;
   paramMods: ParamMods;
   inputFrameTimeline: string;
+  precomputeId: number; // Echoed in the response, so that results for a superseded precompute can be ignored
 }
 
 interface WorkerResponse {
   type: string;
   piece?: PieceId;
   result?: PossibilityChain;
+  results?: { [piece: string]: Object };
+  precomputeId?: number;
+  canCancel?: boolean; // Sent with "ready": whether the worker's searches can be cancelled with SIGUSR2
 }
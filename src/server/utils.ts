@@ -1,5 +1,8 @@
 import {
   CAN_TUCK,
+  CPP_LIVEGAME_PLAYOUT_COUNT,
+  CPP_LIVEGAME_PLAYOUT_LENGTH,
+  CPP_LIVEGAME_PRUNING_BREADTH,
   DEBUG_DOUBLE_KS_ALWAYS_ENABLED,
   DOUBLE_KILLSCREEN_ENABLED,
   IS_PAL,
@@ -144,6 +147,19 @@ export function formatPossibility(
   );
 }
 
+/**
+ * Encodes a precompute search as the C++ input string, for the lookup of one next piece, or of every next piece if none is given.
+ */
+export function getPrecomputeInputString(args: WorkerDataArgs) {
+  const boardStr = args.newSearchState.board.map((x) => x.join("")).join("");
+  const pieceLookup = ["I", "O", "L", "J", "T", "S", "Z"];
+  const curPieceIndex = pieceLookup.indexOf(args.newSearchState.currentPieceId);
+  const nextPieceIndex =
+    args.piece === null ? 0 : pieceLookup.indexOf(args.newSearchState.nextPieceId);
+  const inputFrameTimeline = args.inputFrameTimeline;
+  return `${boardStr}|${args.newSearchState.level}|${args.newSearchState.lines}|${curPieceIndex}|${nextPieceIndex}|${inputFrameTimeline}|${CPP_LIVEGAME_PLAYOUT_COUNT}|${CPP_LIVEGAME_PLAYOUT_LENGTH}|${CPP_LIVEGAME_PRUNING_BREADTH}|`;
+}
+
 const FRAME_WITH_INPUT = "X";
 const FRAME_WAITING = ".";
 
@@ -1,40 +1,58 @@
 console.time("loading");
 import * as process from "process";
-import {
-  CPP_LIVEGAME_PLAYOUT_COUNT,
-  CPP_LIVEGAME_PLAYOUT_LENGTH,
-  CPP_LIVEGAME_PRUNING_BREADTH,
-} from "./params";
+import { getPrecomputeInputString } from "./utils";
 const cModule = require("../../../build/Release/cRabbit");
 
+const CANCELLED_RESULT = "Cancelled"; // See cancellation.hpp
+
 console.timeEnd("loading");
-process.send({ type: "ready" }); // Let the main process know that it's loaded the ranks file
+// The worker inherits the main process's environment, so it uses the same position book (see request_handler.ts)
+if (process.env.POSITION_BOOK && !cModule.loadPositionBook(process.env.POSITION_BOOK)) {
+  console.error("Unable to load the position book at", process.env.POSITION_BOOK);
+}
+// Lets the main process cut short a search that has become stale (see PreComputeManager._cancelStaleSearches)
+const canCancel = cModule.enableCancelSignal();
+process.send({ type: "ready", canCancel }); // Let the main process know that it's loaded the ranks file
 
 /**
- * Compute adjustment for the given piece
+ * Compute adjustment for the given piece, or for every possible next piece if none is given
+ * @returns the lookup, or null if the search was cancelled
  */
 function performComputationFinesseCpp(args: WorkerDataArgs): Object {
-  console.time(args.piece);
+  const timerLabel = args.piece || "all next pieces";
+  console.time(timerLabel);
 
-  const boardStr = args.newSearchState.board.map((x) => x.join("")).join("");
-  const pieceLookup = ["I", "O", "L", "J", "T", "S", "Z"];
-  const curPieceIndex = pieceLookup.indexOf(args.newSearchState.currentPieceId);
-  const nextPieceIndex = pieceLookup.indexOf(args.newSearchState.nextPieceId);
-  const inputFrameTimeline = args.inputFrameTimeline;
-  const encodedInputString = `${boardStr}|${args.newSearchState.level}|${args.newSearchState.lines}|${curPieceIndex}|${nextPieceIndex}|${inputFrameTimeline}|${CPP_LIVEGAME_PLAYOUT_COUNT}|${CPP_LIVEGAME_PLAYOUT_LENGTH}|${CPP_LIVEGAME_PRUNING_BREADTH}|`;
+  const encodedInputString = getPrecomputeInputString(args);
   // console.log(args.newSearchState.nextPieceId, encodedInputString);
-  const lockPositionValueLookup = JSON.parse(
-    cModule.getLockValueLookup(encodedInputString)
-  );
-  console.timeEnd(args.piece);
-  return lockPositionValueLookup;
+  const resultStr =
+    args.piece === null
+      ? cModule.getLockValueLookupAllNextPieces(encodedInputString)
+      : cModule.getLockValueLookup(encodedInputString);
+  console.timeEnd(timerLabel);
+  if (resultStr === CANCELLED_RESULT) {
+    return null;
+  }
+  return JSON.parse(resultStr);
 }
 
 process.on("message", (args: WorkerDataArgs) => {
   const result = performComputationFinesseCpp(args);
+  if (result === null) {
+    process.send({ type: "cancelled", precomputeId: args.precomputeId });
+    return;
+  }
+  if (args.piece === null) {
+    process.send({
+      type: "allResults",
+      results: result,
+      precomputeId: args.precomputeId,
+    });
+    return;
+  }
   process.send({
     type: "result",
     piece: args.piece,
     result: result,
+    precomputeId: args.precomputeId,
   });
 });
@@ -0,0 +1,94 @@
+// Runs the same requests on the plain wasm build and on the SIMD and multithreaded builds under Node, checks that the results
+// are identical, and prints how long each build took.
+// Usage: node node-check.js (with the builds from emscriptem.md in this folder)
+
+const fs = require('fs');
+const path = require('path');
+const zlib = require('zlib');
+
+const REFERENCE_BUILD = 'wasmRabbit.js';
+const OTHER_BUILDS = ['wasmRabbit-simd.js', 'wasmRabbit-threads.js', 'wasmRabbit-lite.js']; // Skipped if they haven't been built
+const DATA_BLOBS = ['piece_sequences.bin.gz', 'surface_ranks.bin.gz']; // For the lite build
+const SURFACE_RANKS_TABLE = 0;
+const NUM_REPEATS = 3;
+const NUM_KERNEL_CHECK_BOARDS = 100000;
+
+// The same position as sample-main.js, as a raw request string (see getStackRabbitArgString in wasmRabbit-worker.js)
+const BOARD =
+	'00000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000010000000011000000001100000000110000001011110111101111111110111111111011111111101111111110';
+const INPUT_STR = [BOARD, 18, 50, 0, 0, 'X....', 49, 2, ''].join('|');
+const METHODS = ['getLockValueLookup', 'getMove', 'getTopMoves', 'getTopMovesHybrid'];
+
+// The builds are modularized (see emscriptem.md), so each one exports a factory that resolves once its runtime is ready
+function loadBuild(fileName) {
+	const createWasmRabbit = require(path.join(__dirname, fileName));
+	return createWasmRabbit();
+}
+
+async function runBuild(fileName) {
+	let wasmModule;
+	try {
+		wasmModule = await loadBuild(fileName);
+	} catch (err) {
+		console.log(`${fileName}: unable to load (${err.message || err})`);
+		return null;
+	}
+	if (!wasmModule.isDataTableLoaded(SURFACE_RANKS_TABLE)) {
+		// A lite build, which needs the data tables loaded to match the other builds
+		for (const blobName of DATA_BLOBS) {
+			const blob = zlib.gunzipSync(fs.readFileSync(path.join(__dirname, blobName)));
+			if (!wasmModule.loadDataBlob(new Uint8Array(blob))) {
+				console.log(`${fileName}: unable to load ${blobName}`);
+				return null;
+			}
+		}
+	}
+	const results = {};
+	console.log(`${fileName}: ${wasmModule.getThreadCount()} thread(s), ${wasmModule.usesSimdKernels() ? 'SIMD' : 'scalar'} kernels`);
+	const numKernelMismatches = wasmModule.checkBoardKernels(NUM_KERNEL_CHECK_BOARDS);
+	console.log(`  board kernels: ${numKernelMismatches} mismatches on ${NUM_KERNEL_CHECK_BOARDS} boards`);
+	if (numKernelMismatches > 0) {
+		return null;
+	}
+	for (const method of METHODS) {
+		const start = Date.now();
+		for (let i = 0; i < NUM_REPEATS; i++) {
+			results[method] = wasmModule[method](INPUT_STR);
+		}
+		console.log(`  ${method}: ${((Date.now() - start) / NUM_REPEATS).toFixed(1)} ms`);
+	}
+	return results;
+}
+
+async function main() {
+	const referenceResults = await runBuild(REFERENCE_BUILD);
+	if (referenceResults === null) {
+		process.exit(1);
+	}
+	let didSucceed = true;
+	for (const fileName of OTHER_BUILDS) {
+		if (!fs.existsSync(path.join(__dirname, fileName))) {
+			console.log(`${fileName}: not built, skipping`);
+			continue;
+		}
+		const results = await runBuild(fileName);
+		if (results === null) {
+			didSucceed = false;
+			continue;
+		}
+		const mismatches = METHODS.filter(method => results[method] !== referenceResults[method]);
+		if (mismatches.length > 0) {
+			console.log(`  results differ from ${REFERENCE_BUILD} for: ${mismatches.join(', ')}`);
+			didSucceed = false;
+		} else {
+			console.log(`  results are identical to ${REFERENCE_BUILD}`);
+		}
+	}
+	if (!didSucceed) {
+		process.exit(1);
+	}
+	// The pthread pool would otherwise keep Node running
+	process.exit(0);
+}
+
+main();
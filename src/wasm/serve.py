@@ -0,0 +1,14 @@
+# Serves this folder with the headers that make the page cross-origin isolated, which browsers require for SharedArrayBuffer
+# (and so for the multithreaded wasm build).
+from http.server import SimpleHTTPRequestHandler, ThreadingHTTPServer
+
+
+class IsolatedRequestHandler(SimpleHTTPRequestHandler):
+    def end_headers(self):
+        self.send_header('Cross-Origin-Opener-Policy', 'same-origin')
+        self.send_header('Cross-Origin-Embedder-Policy', 'require-corp')
+        super().end_headers()
+
+
+if __name__ == '__main__':
+    ThreadingHTTPServer(('', 8000), IsolatedRequestHandler).serve_forever()
@@ -1,11 +1,12 @@
-var Module = {
-	initialized: false,
-	onRuntimeInitialized: () => {
-		console.log('onRuntimeInitialized');
-		Module.initialized = true;
-		workerInit();
-	},
-};
+// The multithreaded build needs SharedArrayBuffer, which is only available when the page is cross-origin isolated
+const WASM_SCRIPT = self.crossOriginIsolated ? './wasmRabbit-threads.js' : './wasmRabbit.js';
+
+// Lite builds (without the embedded data tables) fetch them after startup, smallest first
+const DATA_BLOBS = ['./piece_sequences.bin.gz', './surface_ranks.bin.gz'];
+const SURFACE_RANKS_TABLE = 0;
+
+// The engine, once createWasmRabbit() has instantiated it
+var Module = null;
 
 const SR_PIECES_INDEXES = {
 	I: 0,
@@ -92,10 +93,36 @@ self.onmessage = () => {
 	console.log('Worker not initialized');
 };
 
+// The engine works with fallbacks in the meantime. Each blob is decompressed as it streams in, and handed to the engine
+// between requests.
+async function loadDataBlobs() {
+	for (const url of DATA_BLOBS) {
+		try {
+			const response = await fetch(url);
+			const stream = response.body.pipeThrough(new DecompressionStream('gzip'));
+			const blob = new Uint8Array(await new Response(stream).arrayBuffer());
+			console.log('loadDataBlob', url, Module.loadDataBlob(blob));
+		} catch (err) {
+			console.error('Unable to load', url, err);
+		}
+	}
+}
+
 function workerInit() {
 	console.log('workerInit');
 	postMessage({ type: 'init' });
 	self.onmessage = handle_message;
 }
 
-importScripts('./wasmRabbit.js');
+importScripts(WASM_SCRIPT);
+createWasmRabbit({
+	// Where the pthread workers load the module from (otherwise they'd load this script)
+	mainScriptUrlOrBlob: WASM_SCRIPT,
+}).then(instance => {
+	Module = instance;
+	console.log('onRuntimeInitialized', WASM_SCRIPT, Module.getThreadCount(), 'threads');
+	workerInit();
+	if (!Module.isDataTableLoaded(SURFACE_RANKS_TABLE)) {
+		loadDataBlobs();
+	}
+});